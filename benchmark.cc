@@ -0,0 +1,142 @@
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+//---------------------------------------------------------------------------
+
+#include "benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//---------------------------------------------------------------------------
+
+static std::atomic<size_t> heapAllocationCount = 0;
+
+#if defined(__GLIBC__)
+
+// glibc exports its allocator under these names, so the public entry points
+// can be replaced with counting versions.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) {
+  heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(p, size);
+}
+}
+
+#endif
+
+size_t Benchmark::GetHeapAllocationCount() {
+  return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+
+std::vector<const Benchmark *> &Benchmark::GetBenchmarks() {
+  static std::vector<const Benchmark *> benchmarks;
+  return benchmarks;
+}
+
+Benchmark::Benchmark(void (*function)(), const char *name,
+                     const char *filename, int lineNumber)
+    : function(function), name(name), filename(filename),
+      lineNumber(lineNumber) {
+  GetBenchmarks().push_back(this);
+}
+
+std::vector<Benchmark::Series> &Benchmark::GetSeries() {
+  static std::vector<Series> series;
+  return series;
+}
+
+void Benchmark::AddSample(const char *name, uint64_t value) {
+  std::vector<Series> &series = GetSeries();
+  for (Series &s : series) {
+    if (strcmp(s.name, name) == 0) {
+      s.samples.push_back(value);
+      return;
+    }
+  }
+  series.push_back(Series{.name = name, .samples = {value}});
+}
+
+void Benchmark::Series::Print() const {
+  std::vector<uint64_t> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+
+  const size_t count = sorted.size();
+  uint64_t total = 0;
+  for (uint64_t value : sorted) {
+    total += value;
+  }
+
+  printf("    %-40s n=%-8zu mean=%-8.1f p50=%-8llu p90=%-8llu p99=%-8llu "
+         "max=%llu\n",
+         name, count, (double)total / count,
+         (unsigned long long)sorted[count / 2],
+         (unsigned long long)sorted[count * 9 / 10],
+         (unsigned long long)sorted[count * 99 / 100],
+         (unsigned long long)sorted[count - 1]);
+}
+
+uint64_t Benchmark::GetNanoseconds() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
+}
+
+void Benchmark::main(const char *filter) {
+  for (const Benchmark *benchmark : GetBenchmarks()) {
+    if (filter && strstr(benchmark->name, filter) == nullptr) {
+      continue;
+    }
+
+    // Warm up caches before timing.
+    (*benchmark->function)();
+    GetSeries().clear();
+
+    size_t iterations = 0;
+    const uint64_t start = GetNanoseconds();
+    uint64_t elapsed;
+    do {
+      (*benchmark->function)();
+      ++iterations;
+      elapsed = GetNanoseconds() - start;
+    } while (elapsed < MINIMUM_DURATION_NS);
+
+    printf("[BENCHMARK] %s: %.3fus/iteration (%zu iterations)\n",
+           benchmark->name, elapsed / 1000.0 / iterations, iterations);
+    for (const Series &series : GetSeries()) {
+      series.Print();
+    }
+    GetSeries().clear();
+  }
+}
+
+// Benchmark builds replace the unit test runner.
+int main(int argc, const char **argv) {
+  Benchmark::main(argc > 1 ? argv[1] : nullptr);
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+
+#endif
+
+//---------------------------------------------------------------------------
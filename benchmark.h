@@ -0,0 +1,91 @@
+//---------------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef RUN_BENCHMARKS
+#include <vector>
+#endif
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+class Benchmark {
+public:
+  Benchmark(void (*function)(), const char *name, const char *filename,
+            int lineNumber);
+
+  // Runs every registered benchmark, or those whose names contain filter.
+  static void main(const char *filter = nullptr);
+
+  // Wall clock time. Clock is simulated when RUN_TESTS is defined, so
+  // benchmarks use their own time source.
+  static uint64_t GetNanoseconds();
+
+  // Records a value in a named series for the running benchmark. Each series
+  // is reported with percentiles once the benchmark completes.
+  static void AddSample(const char *series, uint64_t value);
+
+  // The number of malloc, calloc and realloc calls so far, from any thread.
+  // Always 0 where they cannot be intercepted.
+  static size_t GetHeapAllocationCount();
+
+private:
+  struct Series {
+    const char *name;
+    std::vector<uint64_t> samples;
+
+    void Print() const;
+  };
+
+  void (*function)();
+  const char *name;
+  const char *filename;
+  int lineNumber;
+
+  // Each benchmark is repeated until at least this much time has elapsed.
+  static const uint64_t MINIMUM_DURATION_NS = 500'000'000;
+
+  static std::vector<const Benchmark *> &GetBenchmarks();
+  static std::vector<Series> &GetSeries();
+};
+#endif
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+#define BENCHMARK_BEGIN__(text, file, line)                                    \
+  namespace Benchmark##line {                                                  \
+    static const char *bMDescription = text;                                   \
+    static const char *bMFile = file;                                          \
+    static int bMLine = line;                                                  \
+    static void Benchmark() {
+
+#define BENCHMARK_END                                                          \
+  }                                                                            \
+  static ::Benchmark benchmark(&Benchmark, bMDescription, bMFile, bMLine);     \
+  }
+
+#else
+
+#define BENCHMARK_BEGIN__(text, file, line)                                    \
+  namespace Benchmark##line {                                                  \
+    [[maybe_unused]] static void Benchmark() {
+
+#define BENCHMARK_END                                                          \
+  }                                                                            \
+  }
+
+#endif
+
+//---------------------------------------------------------------------------
+
+#define BENCHMARK_BEGIN_(description, file, line)                              \
+  BENCHMARK_BEGIN__(description, file, line)
+
+#define BENCHMARK_BEGIN(description)                                           \
+  BENCHMARK_BEGIN_(description, __FILE__, __LINE__)
+
+//---------------------------------------------------------------------------
@@ -158,20 +158,19 @@ StenoCompactMapDictionary::Lookup(const StenoDictionaryLookup &lookup) const {
   }
 }
 
-const StenoDictionary *StenoCompactMapDictionary::GetDictionaryForOutline(
+inline bool StenoCompactMapDictionary::ContainsOutline(
     const StenoDictionaryLookup &lookup) const {
-
   const StenoMapDictionaryStrokesDefinition &strokesDefinition =
       strokes[lookup.length];
 
   if (strokesDefinition.hashMapSize == 0) {
-    return nullptr;
+    return false;
   }
 
   size_t entryIndex = lookup.hash & (strokesDefinition.hashMapSize - 1);
   const size_t offset = strokesDefinition.GetCompactOffset(entryIndex);
   if (offset == (size_t)-1) {
-    return nullptr;
+    return false;
   }
 
   const size_t entrySize = 3 + 3 * lookup.length;
@@ -183,7 +182,7 @@ const StenoDictionary *StenoCompactMapDictionary::GetDictionaryForOutline(
             strokesDefinition.data[dataIndex];
 
     if (entry.Equals(lookup.strokes, lookup.length)) {
-      return this;
+      return true;
     }
 
     dataIndex += entrySize;
@@ -193,7 +192,24 @@ const StenoDictionary *StenoCompactMapDictionary::GetDictionaryForOutline(
     }
 
     if (!strokesDefinition.HasCompactEntry(entryIndex)) {
-      return nullptr;
+      return false;
+    }
+  }
+}
+
+const StenoDictionary *StenoCompactMapDictionary::GetDictionaryForOutline(
+    const StenoDictionaryLookup &lookup) const {
+  return ContainsOutline(lookup) ? this : nullptr;
+}
+
+// Probes every query directly, without a virtual call per outline.
+void StenoCompactMapDictionary::GetDictionariesForOutlines(
+    StenoDictionaryOutlineQuery *const *queries, size_t count) const {
+  for (size_t i = 0; i < count; ++i) {
+    StenoDictionaryOutlineQuery &query = *queries[i];
+    if (query.lookup.length <= maximumOutlineLength &&
+        ContainsOutline(query.lookup)) {
+      query.provider = this;
     }
   }
 }
@@ -274,6 +290,8 @@ StenoCompactMapDictionary::CreateStrokeCache(
 //---------------------------------------------------------------------------
 
 #include "../unit_test.h"
+#include "dictionary_list.h"
+#include "emily_symbols_dictionary.h"
 #include "test_dictionary.h"
 #include <assert.h>
 
@@ -308,4 +326,57 @@ TEST_BEGIN("MapDictionary: Double stroke lookup test") {
 }
 TEST_END
 
+TEST_BEGIN("MapDictionary: Batch outline provider test") {
+  StenoDictionary *const dictionaries[] = {
+      &StenoEmilySymbolsDictionary::instance,
+      &mainDictionary,
+  };
+  StenoDictionaryList dictionaryList(dictionaries, 2);
+
+  // spellchecker: disable
+  const StenoStroke strokes[] = {
+      StenoStroke("TEFT"),
+      StenoStroke("-D"),
+      StenoStroke("SKWHEUFPL"),
+      StenoStroke("KAT"),
+  };
+  // spellchecker: enable
+
+  StenoDictionaryOutlineQuery queries[] = {
+      StenoDictionaryOutlineQuery(strokes, 1),
+      StenoDictionaryOutlineQuery(strokes, 2),
+      StenoDictionaryOutlineQuery(strokes + 2, 1),
+      StenoDictionaryOutlineQuery(strokes + 3, 1),
+  };
+  StenoDictionaryOutlineQuery *queryPointers[] = {
+      &queries[0],
+      &queries[1],
+      &queries[2],
+      &queries[3],
+  };
+  dictionaryList.GetDictionariesForOutlines(queryPointers, 4);
+
+  assert(queries[0].provider == &mainDictionary);
+  assert(queries[1].provider == &mainDictionary);
+  assert(queries[2].provider == &StenoEmilySymbolsDictionary::instance);
+  assert(queries[3].provider == nullptr);
+
+  // Batches larger than the maximum batch size are processed in chunks.
+  const size_t LARGE_BATCH_SIZE =
+      2 * StenoDictionaryOutlineQuery::MAXIMUM_BATCH_SIZE + 1;
+  StenoDictionaryOutlineQuery largeQueries[LARGE_BATCH_SIZE];
+  StenoDictionaryOutlineQuery *largeQueryPointers[LARGE_BATCH_SIZE];
+  for (size_t i = 0; i < LARGE_BATCH_SIZE; ++i) {
+    largeQueries[i] = StenoDictionaryOutlineQuery(strokes + 2 + i % 2, 1);
+    largeQueryPointers[i] = &largeQueries[i];
+  }
+  dictionaryList.GetDictionariesForOutlines(largeQueryPointers,
+                                            LARGE_BATCH_SIZE);
+  for (size_t i = 0; i < LARGE_BATCH_SIZE; ++i) {
+    assert(largeQueries[i].provider ==
+           (i % 2 == 0 ? &StenoEmilySymbolsDictionary::instance : nullptr));
+  }
+}
+TEST_END
+
 //---------------------------------------------------------------------------
@@ -21,6 +21,10 @@ public:
   virtual const StenoDictionary *
   GetDictionaryForOutline(const StenoDictionaryLookup &lookup) const;
 
+  virtual void
+  GetDictionariesForOutlines(StenoDictionaryOutlineQuery *const *queries,
+                             size_t count) const;
+
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
 
   virtual const char *GetName() const;
@@ -37,6 +41,8 @@ private:
   static const StenoMapDictionaryStrokesDefinition *
   CreateStrokeCache(const StenoDictionaryDefinition &definition);
 
+  bool ContainsOutline(const StenoDictionaryLookup &lookup) const;
+
   void ReverseLookup(StenoReverseDictionaryLookup &result,
                      const void *data) const;
 };
@@ -10,6 +10,7 @@
 //---------------------------------------------------------------------------
 
 const char StenoDictionary::SPACES[SPACES_COUNT + 1] = "                ";
+uint32_t StenoDictionary::contentGeneration = 0;
 
 //---------------------------------------------------------------------------
 
@@ -54,6 +55,14 @@ void StenoDictionaryLookupResult::Destroy() {
 
 StenoDictionaryLookupResult StenoDictionaryLookupResult::Clone() const {
   if (text & 1) {
+    return CreateStrokeString(StrokeArena::Dup(GetText()));
+  } else {
+    return *this;
+  }
+}
+
+StenoDictionaryLookupResult StenoDictionaryLookupResult::CloneToHeap() const {
+  if ((text & 1) || IsArenaString()) {
     return CreateDynamicString(Str::Dup(GetText()));
   } else {
     return *this;
@@ -72,6 +81,14 @@ StenoDictionaryLookupResult StenoDictionaryLookupResult::Clone() const {
     return *this;
   }
 
+  return CreateStrokeString(StrokeArena::Dup(GetText()));
+}
+
+StenoDictionaryLookupResult StenoDictionaryLookupResult::CloneToHeap() const {
+  if (text == nullptr || (destroyMethod == &Nop && !IsArenaString())) {
+    return *this;
+  }
+
   return CreateDynamicString(Str::Dup(GetText()));
 }
 
@@ -144,6 +161,35 @@ void StenoReverseDictionaryLookup::AddMapDataLookup(
 
 //---------------------------------------------------------------------------
 
+static inline int AsciiToLower(int c) {
+  return ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+bool StenoTranslationSearch::Matches(const char *text) const {
+  if (fragmentLength == 0) {
+    return true;
+  }
+
+  const int first = AsciiToLower((uint8_t)fragment[0]);
+  for (const char *p = text; *p; ++p) {
+    if (AsciiToLower((uint8_t)*p) != first) {
+      continue;
+    }
+
+    size_t i = 1;
+    while (i < fragmentLength &&
+           AsciiToLower((uint8_t)p[i]) == AsciiToLower((uint8_t)fragment[i])) {
+      ++i;
+    }
+    if (i == fragmentLength) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//---------------------------------------------------------------------------
+
 const StenoDictionary *StenoDictionary::GetDictionaryForOutline(
     const StenoDictionaryLookup &lookup) const {
   StenoDictionaryLookupResult lookupResult = Lookup(lookup);
@@ -152,6 +198,14 @@ const StenoDictionary *StenoDictionary::GetDictionaryForOutline(
   return result ? this : nullptr;
 }
 
+void StenoDictionary::GetDictionariesForOutlines(
+    StenoDictionaryOutlineQuery *const *queries, size_t count) const {
+  for (size_t i = 0; i < count; ++i) {
+    StenoDictionaryOutlineQuery &query = *queries[i];
+    query.provider = GetDictionaryForOutline(query.lookup);
+  }
+}
+
 void StenoDictionary::ReverseLookup(
     StenoReverseDictionaryLookup &result) const {}
 
@@ -4,6 +4,7 @@
 #include "../malloc_allocate.h"
 #include "../str.h"
 #include "../stroke.h"
+#include "../stroke_arena.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -37,8 +38,22 @@ public:
   const char *GetText() const { return (char *)(text >> 1); }
   void Destroy();
 
+  bool IsArenaString() const { return StrokeArena::Contains(GetText()); }
+
+  // Clones of dynamic strings are made in the active StrokeArena, so are
+  // only valid until the end of the next stroke.
   StenoDictionaryLookupResult Clone() const;
 
+  // Returns a result that can be kept across strokes.
+  StenoDictionaryLookupResult CloneToHeap() const;
+
+  // p is from StrokeArena::DupN or StrokeArena::Join, which return heap
+  // strings when the arena is unavailable.
+  static StenoDictionaryLookupResult CreateStrokeString(const char *p) {
+    return StrokeArena::Contains(p) ? CreateArenaString(p)
+                                    : CreateDynamicString(p);
+  }
+
   static StenoDictionaryLookupResult CreateInvalid() {
     return StenoDictionaryLookupResult(0);
   }
@@ -59,6 +74,12 @@ public:
     return StenoDictionaryLookupResult((intptr_t(p) << 1) + 1);
   }
 
+  // Arena strings are released with the StrokeArena, so share the static
+  // representation.
+  static StenoDictionaryLookupResult CreateArenaString(const char *p) {
+    return CreateStaticString(p);
+  }
+
   bool operator==(const StenoDictionaryLookupResult &other) const {
     return text == other.text;
   }
@@ -82,8 +103,22 @@ public:
     }
   }
 
+  bool IsArenaString() const { return StrokeArena::Contains(GetText()); }
+
+  // Clones of dynamic strings are made in the active StrokeArena, so are
+  // only valid until the end of the next stroke.
   StenoDictionaryLookupResult Clone() const;
 
+  // Returns a result that can be kept across strokes.
+  StenoDictionaryLookupResult CloneToHeap() const;
+
+  // p is from StrokeArena::DupN or StrokeArena::Join, which return heap
+  // strings when the arena is unavailable.
+  static StenoDictionaryLookupResult CreateStrokeString(const char *p) {
+    return StrokeArena::Contains(p) ? CreateArenaString(p)
+                                    : CreateDynamicString(p);
+  }
+
   static StenoDictionaryLookupResult CreateInvalid() {
     StenoDictionaryLookupResult result;
     result.text = nullptr;
@@ -112,6 +147,12 @@ public:
     return result;
   }
 
+  // Arena strings are released with the StrokeArena, so share the static
+  // representation.
+  static StenoDictionaryLookupResult CreateArenaString(const char *p) {
+    return CreateStaticString(p);
+  }
+
   bool operator==(const StenoDictionaryLookupResult &other) const {
     return text == other.text;
   }
@@ -121,6 +162,7 @@ public:
 //---------------------------------------------------------------------------
 
 struct StenoDictionaryLookup {
+  StenoDictionaryLookup() = default;
   StenoDictionaryLookup(const StenoStroke *strokes, size_t length)
       : strokes(strokes), length(length),
         hash(StenoStroke::Hash(strokes, length)) {}
@@ -132,6 +174,25 @@ struct StenoDictionaryLookup {
 
 //---------------------------------------------------------------------------
 
+// Used to determine the providing dictionary for many outlines at once.
+// The hash is calculated once, and each dictionary is only probed with
+// queries that have not yet been resolved by a higher priority dictionary.
+//
+// Callers hold queries on the stack, so they are batched in chunks of at most
+// MAXIMUM_BATCH_SIZE.
+struct StenoDictionaryOutlineQuery {
+  static const size_t MAXIMUM_BATCH_SIZE = 16;
+
+  StenoDictionaryOutlineQuery() = default;
+  StenoDictionaryOutlineQuery(const StenoStroke *strokes, size_t length)
+      : lookup(strokes, length), provider(nullptr) {}
+
+  StenoDictionaryLookup lookup;
+  const StenoDictionary *provider;
+};
+
+//---------------------------------------------------------------------------
+
 struct StenoReverseDictionaryResult {
   size_t length;
   StenoStroke *strokes;
@@ -191,6 +252,37 @@ public:
 
 //---------------------------------------------------------------------------
 
+// Collects translations that contain a text fragment. Matches are passed to
+// the callback as they are found, until maximumResultCount is reached.
+struct StenoTranslationSearch {
+  StenoTranslationSearch(const char *fragment, size_t maximumResultCount,
+                         void (*callback)(void *context, const char *text),
+                         void *context)
+      : fragment(fragment), fragmentLength(strlen(fragment)),
+        maximumResultCount(maximumResultCount), callback(callback),
+        context(context) {}
+
+  bool IsFull() const { return resultCount >= maximumResultCount; }
+  void AddResult(const char *text) {
+    ++resultCount;
+    (*callback)(context, text);
+  }
+
+  // ASCII case insensitive substring test.
+  bool Matches(const char *text) const;
+
+  const char *fragment;
+  size_t fragmentLength;
+  size_t resultCount = 0;
+  size_t maximumResultCount;
+
+private:
+  void (*callback)(void *context, const char *text);
+  void *context;
+};
+
+//---------------------------------------------------------------------------
+
 class StenoDictionary {
 public:
   virtual StenoDictionaryLookupResult
@@ -212,8 +304,16 @@ public:
     return GetDictionaryForOutline(strokes, length) != nullptr;
   }
 
+  // Batched GetDictionaryForOutline. Sets provider for each query that is
+  // defined by this dictionary. All queries passed in are unresolved.
+  virtual void
+  GetDictionariesForOutlines(StenoDictionaryOutlineQuery *const *queries,
+                             size_t count) const;
+
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
 
+  virtual void SearchTranslations(StenoTranslationSearch &search) const {}
+
   size_t GetMaximumOutlineLength() const { return maximumOutlineLength; }
   virtual void UpdateMaximumOutlineLength() {
     if (parent) {
@@ -237,6 +337,10 @@ public:
   virtual bool DisableDictionary(const char *name) { return false; }
   virtual bool ToggleDictionary(const char *name) { return false; }
 
+  // Changes whenever dictionary contents or enabled states change, so that
+  // lookup results can be cached.
+  static uint32_t GetContentGeneration() { return contentGeneration; }
+
 protected:
   StenoDictionary(size_t maximumOutlineLength)
       : maximumOutlineLength(maximumOutlineLength), parent(nullptr) {}
@@ -246,7 +350,11 @@ protected:
 
   static const char *Spaces(int count) { return SPACES + SPACES_COUNT - count; }
 
+  static void InvalidateContent() { ++contentGeneration; }
+
 private:
+  static uint32_t contentGeneration;
+
   static const size_t SPACES_COUNT = 16;
   static const char SPACES[];
 };
@@ -122,7 +122,11 @@ struct StenoDictionaryCollection {
   uint32_t magic;
   uint16_t dictionaryCount;
   bool hasReverseLookup;
-  bool _padding7;
+
+  // When set, a StenoReversePrefixTable pointer immediately follows the
+  // dictionaries list. Older collections always have this as false.
+  bool hasReversePrefixTable;
+
   const uint8_t *textBlock;
   size_t textBlockLength;
   const StenoDictionaryDefinition *const dictionaries[];
@@ -61,6 +61,48 @@ const StenoDictionary *StenoDictionaryList::GetDictionaryForOutline(
   return nullptr;
 }
 
+void StenoDictionaryList::GetDictionariesForOutlines(
+    StenoDictionaryOutlineQuery *const *queries, size_t count) const {
+  const size_t MAXIMUM_BATCH_SIZE =
+      StenoDictionaryOutlineQuery::MAXIMUM_BATCH_SIZE;
+  while (count > MAXIMUM_BATCH_SIZE) {
+    GetDictionariesForOutlines(queries, MAXIMUM_BATCH_SIZE);
+    queries += MAXIMUM_BATCH_SIZE;
+    count -= MAXIMUM_BATCH_SIZE;
+  }
+
+  StenoDictionaryOutlineQuery *pending[MAXIMUM_BATCH_SIZE];
+  StenoDictionaryOutlineQuery *candidates[MAXIMUM_BATCH_SIZE];
+  memcpy(pending, queries, count * sizeof(*queries));
+  size_t pendingCount = count;
+
+  for (const StenoDictionaryListEntry &entry : dictionaries) {
+    size_t candidateCount = 0;
+    for (size_t i = 0; i < pendingCount; ++i) {
+      if (pending[i]->lookup.length <= entry.combinedMaximumOutlineLength) {
+        candidates[candidateCount++] = pending[i];
+      }
+    }
+    if (candidateCount == 0) {
+      continue;
+    }
+
+    entry->GetDictionariesForOutlines(candidates, candidateCount);
+
+    // Drop everything that now has a provider.
+    size_t newPendingCount = 0;
+    for (size_t i = 0; i < pendingCount; ++i) {
+      if (pending[i]->provider == nullptr) {
+        pending[newPendingCount++] = pending[i];
+      }
+    }
+    pendingCount = newPendingCount;
+    if (pendingCount == 0) {
+      return;
+    }
+  }
+}
+
 void StenoDictionaryList::ReverseLookup(
     StenoReverseDictionaryLookup &result) const {
   for (const StenoDictionaryListEntry &entry : dictionaries) {
@@ -71,6 +113,19 @@ void StenoDictionaryList::ReverseLookup(
   }
 }
 
+void StenoDictionaryList::SearchTranslations(
+    StenoTranslationSearch &search) const {
+  for (const StenoDictionaryListEntry &entry : dictionaries) {
+    if (search.IsFull()) {
+      return;
+    }
+    if (!entry.IsEnabled()) {
+      continue;
+    }
+    entry->SearchTranslations(search);
+  }
+}
+
 void StenoDictionaryList::SetParentRecursively(StenoDictionary *parent) {
   StenoDictionary::SetParentRecursively(parent);
   for (StenoDictionaryListEntry &entry : dictionaries) {
@@ -149,6 +204,7 @@ bool StenoDictionaryList::EnableDictionary(const char *name) {
   for (StenoDictionaryListEntry &entry : dictionaries) {
     if (Str::Eq(name, entry->GetName())) {
       entry.Enable();
+      InvalidateContent();
       SendDictionaryStatus(name, true);
       UpdateMaximumOutlineLength();
       return true;
@@ -161,6 +217,7 @@ bool StenoDictionaryList::DisableDictionary(const char *name) {
   for (StenoDictionaryListEntry &entry : dictionaries) {
     if (Str::Eq(name, entry->GetName())) {
       entry.Disable();
+      InvalidateContent();
       SendDictionaryStatus(name, false);
       UpdateMaximumOutlineLength();
       return true;
@@ -173,6 +230,7 @@ bool StenoDictionaryList::ToggleDictionary(const char *name) {
   for (StenoDictionaryListEntry &entry : dictionaries) {
     if (Str::Eq(name, entry->GetName())) {
       entry.ToggleEnable();
+      InvalidateContent();
       SendDictionaryStatus(name, entry.IsEnabled());
       UpdateMaximumOutlineLength();
       return true;
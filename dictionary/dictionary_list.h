@@ -55,7 +55,12 @@ public:
   virtual const StenoDictionary *
   GetDictionaryForOutline(const StenoDictionaryLookup &lookup) const;
 
+  virtual void
+  GetDictionariesForOutlines(StenoDictionaryOutlineQuery *const *queries,
+                             size_t count) const;
+
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
+  virtual void SearchTranslations(StenoTranslationSearch &search) const;
 
   virtual void SetParentRecursively(StenoDictionary *parent);
 
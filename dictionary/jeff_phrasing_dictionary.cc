@@ -9,6 +9,7 @@
 #include "jeff_phrasing_dictionary_data.h"
 #include "jeff_phrasing_dictionary_generated.h"
 #include <assert.h>
+#include <string.h>
 
 //---------------------------------------------------------------------------
 
@@ -33,12 +34,152 @@ struct StenoJeffPhrasingDictionary::ReverseLookupContext {
 
   bool hasPresentTenseResult = false;
   StenoReverseDictionaryLookup &result;
-  List<StenoStroke> testedStrokes;
 
-  bool HasTestedStroke(const StenoStroke &stroke) const {
-    return testedStrokes.Contains(stroke);
+  // Fixed size open-addressed sets.
+  //
+  // A slot is only read once its bit in the matching used mask is set, so
+  // the slots themselves are left uninitialized. If a set fills up, new
+  // values are reported as unseen, which only costs repeated work --
+  // AddResult already ignores duplicates.
+  static const size_t TESTED_STROKE_SET_SIZE = 64;
+  static const size_t VISITED_STATE_SET_SIZE = 128;
+
+  struct VisitedState {
+    StenoStroke stroke;
+    uint32_t hash;
+    uint16_t offset;
+    uint8_t componentMask;
+    uint8_t modeMask;
+  };
+
+  // The recursion only reaches the start of the text and the word
+  // boundaries, and a phrase has at most 7 words.
+  static const size_t WORD_CACHE_SIZE = 16;
+
+  struct Word {
+    const char *p;
+    const char *pEnd;
+    uint32_t hash;
+    const JeffPhrasingReverseHashMapEntry *entry;
+  };
+
+  struct WordCacheEntry {
+    const char *p;
+    Word word;
+    Word nextWord;
+  };
+
+  uint64_t testedStrokesUsed = 0;
+  uint64_t visitedStatesUsed[VISITED_STATE_SET_SIZE / 64] = {};
+  StenoStroke testedStrokes[TESTED_STROKE_SET_SIZE];
+  VisitedState visitedStates[VISITED_STATE_SET_SIZE];
+  size_t wordCacheCount = 0;
+  WordCacheEntry wordCache[WORD_CACHE_SIZE];
+
+  // Returns true if the stroke was already present.
+  bool AddTestedStroke(StenoStroke stroke) {
+    size_t index = (stroke.GetKeyState() * 0x9e3779b9) >> 16;
+    for (size_t i = 0; i < TESTED_STROKE_SET_SIZE; ++i) {
+      const size_t slotIndex = (index + i) & (TESTED_STROKE_SET_SIZE - 1);
+      const uint64_t slotBit = uint64_t(1) << slotIndex;
+      if ((testedStrokesUsed & slotBit) == 0) {
+        testedStrokesUsed |= slotBit;
+        testedStrokes[slotIndex] = stroke;
+        return false;
+      }
+      if (testedStrokes[slotIndex] == stroke) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns true if the search state has already been explored.
+  bool AddVisitedState(const char *p, StenoStroke stroke, uint32_t hash,
+                       uint8_t componentMask, uint8_t modeMask) {
+    const size_t offset = p - result.lookup;
+    if (offset > 0xffff) {
+      return false;
+    }
+
+    const uint32_t key = (hash ^ stroke.GetKeyState() ^ (uint32_t)offset << 24 ^
+                          componentMask << 4 ^ modeMask) *
+                         0x9e3779b9;
+    size_t index = key >> 16;
+    for (size_t i = 0; i < VISITED_STATE_SET_SIZE; ++i) {
+      const size_t slotIndex = (index + i) & (VISITED_STATE_SET_SIZE - 1);
+      uint64_t &used = visitedStatesUsed[slotIndex / 64];
+      const uint64_t slotBit = uint64_t(1) << (slotIndex % 64);
+      VisitedState &slot = visitedStates[slotIndex];
+      if ((used & slotBit) == 0) {
+        used |= slotBit;
+        slot = VisitedState{
+            .stroke = stroke,
+            .hash = hash,
+            .offset = uint16_t(offset),
+            .componentMask = componentMask,
+            .modeMask = modeMask,
+        };
+        return false;
+      }
+      if (slot.offset == offset && slot.stroke == stroke &&
+          slot.hash == hash && slot.componentMask == componentMask &&
+          slot.modeMask == modeMask) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns the (possibly two word) components starting at p.
+  const WordCacheEntry &GetWords(const char *p,
+                                 const JeffPhrasingDictionaryData &data) {
+    for (size_t i = 0; i < wordCacheCount; ++i) {
+      if (wordCache[i].p == p) {
+        return wordCache[i];
+      }
+    }
+
+    // Positions are bounded by the word count, so this cannot overflow.
+    assert(wordCacheCount < WORD_CACHE_SIZE);
+    WordCacheEntry &cacheEntry = wordCache[wordCacheCount++];
+    cacheEntry.p = p;
+
+    while (*p == ' ' && *p != '\0') {
+      ++p;
+    }
+
+    const char *pEnd = p;
+    while (*pEnd != '\0' && *pEnd != ' ') {
+      ++pEnd;
+    }
+
+    cacheEntry.word.p = p;
+    cacheEntry.word.pEnd = pEnd;
+    cacheEntry.word.hash = Crc32(p, pEnd - p);
+    cacheEntry.word.entry = data.LookupReverseWord(cacheEntry.word.hash);
+    cacheEntry.nextWord.entry = nullptr;
+
+    if (cacheEntry.word.entry && cacheEntry.word.entry->checkNext &&
+        *pEnd != '\0') {
+      const char *pEnd2 = pEnd;
+      while (*pEnd2 == ' ' && *pEnd2 != '\0') {
+        ++pEnd2;
+      }
+
+      while (*pEnd2 != '\0' && *pEnd2 != ' ') {
+        ++pEnd2;
+      }
+
+      cacheEntry.nextWord.p = p;
+      cacheEntry.nextWord.pEnd = pEnd2;
+      cacheEntry.nextWord.hash = Crc32(p, pEnd2 - p);
+      cacheEntry.nextWord.entry =
+          data.LookupReverseWord(cacheEntry.nextWord.hash);
+    }
+
+    return cacheEntry;
   }
-  void AddTestedStroke(const StenoStroke &stroke) { testedStrokes.Add(stroke); }
 
   void AddResult(const StenoStroke &stroke, const StenoDictionary *provider) {
     result.AddResult(&stroke, 1, provider);
@@ -363,16 +504,16 @@ void StenoJeffPhrasingDictionary::ReverseLookup(
 void StenoJeffPhrasingDictionary::RecurseCheckReverseLookup(
     ReverseLookupContext &context, const char *p, StenoStroke stroke,
     uint32_t hash, uint8_t componentMask, uint8_t modeMask) const {
-  while (*p == ' ' && *p != '\0') {
-    ++p;
-  }
+  const ReverseLookupContext::WordCacheEntry &words =
+      context.GetWords(p, phrasingData);
+  p = words.word.p;
 
-  const char *pEnd = p;
-  while (*pEnd != '\0' && *pEnd != ' ') {
-    ++pEnd;
+  // Different component orders frequently converge on the same state.
+  if (context.AddVisitedState(p, stroke, hash, componentMask, modeMask)) {
+    return;
   }
 
-  if (p == pEnd) {
+  if (p == words.word.pEnd) {
     if ((componentMask & ComponentMask::STARTER) == 0) {
       // There must be a starter for simple forms.
       if ((modeMask & ~ModeMask::SIMPLE) == 0) {
@@ -424,10 +565,9 @@ void StenoJeffPhrasingDictionary::RecurseCheckReverseLookup(
       // Try lookup.
       if (entry->modeMask & modeMask) {
         StenoStroke lookupStroke = stroke | entry->stroke;
-        if (context.HasTestedStroke(lookupStroke)) {
+        if (context.AddTestedStroke(lookupStroke)) {
           continue;
         }
-        context.AddTestedStroke(lookupStroke);
         StenoDictionaryLookupResult lookup = Lookup(&lookupStroke, 1);
         if (lookup.IsValid()) {
           const char *lookupText = lookup.GetText();
@@ -446,34 +586,19 @@ void StenoJeffPhrasingDictionary::RecurseCheckReverseLookup(
     }
   }
 
-  uint32_t wordHash = Crc32(p, pEnd - p);
-  const JeffPhrasingReverseHashMapEntry *entry =
-      phrasingData.LookupReverseWord(wordHash);
-  if (!entry) {
+  const ReverseLookupContext::Word &word = words.word;
+  if (!word.entry) {
     return;
   }
 
-  if (entry->checkNext && *pEnd != '\0') {
-    const char *pEnd2 = pEnd;
-    while (*pEnd2 == ' ' && *pEnd2 != '\0') {
-      ++pEnd2;
-    }
-
-    while (*pEnd2 != '\0' && *pEnd2 != ' ') {
-      ++pEnd2;
-    }
-
-    uint32_t wordHash2 = Crc32(p, pEnd2 - p);
-    const JeffPhrasingReverseHashMapEntry *entry2 =
-        phrasingData.LookupReverseWord(wordHash2);
-    if (entry2) {
-      ProcessEntries(entry2, wordHash2, context, pEnd2, stroke, hash,
-                     componentMask, modeMask);
-    }
+  const ReverseLookupContext::Word &nextWord = words.nextWord;
+  if (nextWord.entry) {
+    ProcessEntries(nextWord.entry, nextWord.hash, context, nextWord.pEnd,
+                   stroke, hash, componentMask, modeMask);
   }
 
-  ProcessEntries(entry, wordHash, context, pEnd, stroke, hash, componentMask,
-                 modeMask);
+  ProcessEntries(word.entry, word.hash, context, word.pEnd, stroke, hash,
+                 componentMask, modeMask);
 }
 
 void StenoJeffPhrasingDictionary::ProcessEntries(
@@ -1667,3 +1792,38 @@ TEST_BEGIN("JeffPhrasing: Reverse lookups") {
 TEST_END
 
 //---------------------------------------------------------------------------
+
+#include "../benchmark.h"
+
+BENCHMARK_BEGIN("JeffPhrasing: Reverse lookup of common phrases") {
+  static const char *const PHRASES[] = {
+      "I",
+      "I can",
+      "can I",
+      "I have been going",
+      "I am going to",
+      "I was going to have",
+      "if I did it",
+      "if you go",
+      "I didn't like",
+      "I need to",
+      "to go to",
+      "there are",
+      "you were",
+      "to read",
+      "but I considered",
+      "and she has been working on the",
+      "he would have wanted to",
+      "they should not have been thinking",
+      "what do you want to",
+      "I don't know",
+  };
+
+  for (const char *phrase : PHRASES) {
+    StenoReverseDictionaryLookup lookup(2, phrase);
+    StenoJeffPhrasingDictionary::instance.ReverseLookup(lookup);
+  }
+}
+BENCHMARK_END
+
+//---------------------------------------------------------------------------
@@ -1,12 +1,126 @@
 //---------------------------------------------------------------------------
 
 #include "reverse_auto_suffix_dictionary.h"
+#include "../list.h"
 #include "../orthography.h"
 #include "../pattern.h"
 #include "../str.h"
 
 //---------------------------------------------------------------------------
 
+// A reversed trie of the literal tails of all reverse auto-suffix patterns.
+//
+// A single right-to-left scan of the lookup text determines which rules can
+// possibly match, so that only those rules run their pattern and dictionary
+// probes. Rules without a literal tail are always candidates.
+//
+// Rule masks are 32 bits wide. Orthographies with more reverse auto-suffix
+// rules still work, but the rules past the first 32 are evaluated for every
+// lookup without filtering.
+class StenoReverseAutoSuffixDictionary::SuffixMatcher
+    : public JavelinMallocAllocate {
+public:
+  SuffixMatcher(const StenoOrthography &orthography);
+
+  typedef uint32_t RuleMask;
+
+  // Bit n is set if rule n needs to be evaluated.
+  RuleMask GetCandidateRules(const char *text, size_t length) const;
+
+  // Rules at or above this index are always evaluated.
+  static const size_t MAXIMUM_RULE_COUNT = 8 * sizeof(RuleMask);
+
+  static RuleMask GetRuleBit(size_t index) { return RuleMask(1) << index; }
+
+private:
+  struct Node {
+    uint8_t c;
+    uint16_t child;
+    uint16_t sibling;
+    RuleMask ruleMask;
+  };
+
+  RuleMask alwaysRuleMask = 0;
+  List<Node> nodes;
+
+  void AddTail(const char *tail, size_t length, RuleMask ruleMask);
+  size_t FindChild(size_t nodeIndex, uint8_t c) const;
+};
+
+StenoReverseAutoSuffixDictionary::SuffixMatcher::SuffixMatcher(
+    const StenoOrthography &orthography) {
+  // Root node.
+  nodes.Add(Node{.c = 0, .child = 0, .sibling = 0, .ruleMask = 0});
+
+  size_t ruleCount = orthography.reverseAutoSuffixCount;
+  if (ruleCount > MAXIMUM_RULE_COUNT) {
+    ruleCount = MAXIMUM_RULE_COUNT;
+  }
+
+  for (size_t i = 0; i < ruleCount; ++i) {
+    size_t length;
+    const char *tail = Pattern::FindLiteralTail(
+        orthography.reverseAutoSuffixes[i].testPattern, length);
+    if (tail) {
+      AddTail(tail, length, GetRuleBit(i));
+    } else {
+      alwaysRuleMask |= GetRuleBit(i);
+    }
+  }
+}
+
+size_t
+StenoReverseAutoSuffixDictionary::SuffixMatcher::FindChild(size_t nodeIndex,
+                                                           uint8_t c) const {
+  size_t index = nodes[nodeIndex].child;
+  while (index != 0) {
+    const Node &node = nodes[index];
+    if (node.c == c) {
+      return index;
+    }
+    index = node.sibling;
+  }
+  return 0;
+}
+
+void StenoReverseAutoSuffixDictionary::SuffixMatcher::AddTail(
+    const char *tail, size_t length, RuleMask ruleMask) {
+  size_t nodeIndex = 0;
+  for (const char *p = tail + length; p > tail;) {
+    uint8_t c = *--p;
+    size_t childIndex = FindChild(nodeIndex, c);
+    if (childIndex == 0) {
+      childIndex = nodes.GetCount();
+      nodes.Add(Node{
+          .c = c,
+          .child = 0,
+          .sibling = nodes[nodeIndex].child,
+          .ruleMask = 0,
+      });
+      nodes[nodeIndex].child = childIndex;
+    }
+    nodeIndex = childIndex;
+  }
+  nodes[nodeIndex].ruleMask |= ruleMask;
+}
+
+StenoReverseAutoSuffixDictionary::SuffixMatcher::RuleMask
+StenoReverseAutoSuffixDictionary::SuffixMatcher::GetCandidateRules(
+    const char *text, size_t length) const {
+  RuleMask result = alwaysRuleMask;
+  size_t nodeIndex = 0;
+  for (const char *p = text + length; p > text;) {
+    nodeIndex = FindChild(nodeIndex, *--p);
+    if (nodeIndex == 0) {
+      break;
+    }
+    result |= nodes[nodeIndex].ruleMask;
+  }
+  return result;
+}
+
+//---------------------------------------------------------------------------
+
 const Pattern *StenoReverseAutoSuffixDictionary::CreateReversePatterns(
     const StenoOrthography &orthography) {
   Pattern *patterns =
@@ -23,13 +137,21 @@ const Pattern *StenoReverseAutoSuffixDictionary::CreateReversePatterns(
 StenoReverseAutoSuffixDictionary::StenoReverseAutoSuffixDictionary(
     StenoDictionary *dictionary, const StenoCompiledOrthography &orthography)
     : StenoWrappedDictionary(dictionary), orthography(orthography),
-      reversePatterns(CreateReversePatterns(orthography.data)) {}
+      reversePatterns(CreateReversePatterns(orthography.data)),
+      suffixMatcher(new SuffixMatcher(orthography.data)) {}
 
 void StenoReverseAutoSuffixDictionary::ReverseLookup(
     StenoReverseDictionaryLookup &result) const {
   dictionary->ReverseLookup(result);
 
-  for (size_t i = 0; i < orthography.data.reverseAutoSuffixCount; ++i) {
+  const size_t ruleCount = orthography.data.reverseAutoSuffixCount;
+  const SuffixMatcher::RuleMask candidateRules =
+      suffixMatcher->GetCandidateRules(result.lookup, result.lookupLength);
+  for (size_t i = 0; i < ruleCount; ++i) {
+    if (i < SuffixMatcher::MAXIMUM_RULE_COUNT &&
+        (candidateRules & SuffixMatcher::GetRuleBit(i)) == 0) {
+      continue;
+    }
     ProcessReverseAutoSuffix(result, orthography.data.reverseAutoSuffixes[i],
                              reversePatterns[i]);
   }
@@ -69,11 +191,16 @@ void StenoReverseAutoSuffixDictionary::ProcessReverseAutoSuffix(
 
   char *suffix = Str::DupN(reverseAutoSuffix.autoSuffix->text + 3,
                            strlen(reverseAutoSuffix.autoSuffix->text) - 4);
-  char *withSuffix = orthography.AddSuffix(withoutSuffix, suffix);
+  char withSuffixBuffer[64];
+  char *withSuffix = orthography.AddSuffix(withoutSuffix, suffix,
+                                           withSuffixBuffer,
+                                           sizeof(withSuffixBuffer));
   free(suffix);
 
   bool isSuffixEqual = Str::Eq(withSuffix, result.lookup);
-  free(withSuffix);
+  if (withSuffix != withSuffixBuffer) {
+    free(withSuffix);
+  }
   if (!isSuffixEqual) {
     free(withoutSuffix);
     return;
@@ -22,8 +22,11 @@ public:
   virtual const char *GetName() const;
 
 private:
+  class SuffixMatcher;
+
   const StenoCompiledOrthography &orthography;
   const Pattern *reversePatterns;
+  const SuffixMatcher *suffixMatcher;
 
   void ProcessReverseAutoSuffix(
       StenoReverseDictionaryLookup &result,
@@ -4,6 +4,7 @@
 #include "reverse_map_dictionary.h"
 #include "../str.h"
 #include "map_data_lookup.h"
+#include "text_block_index.h"
 
 //---------------------------------------------------------------------------
 
@@ -93,16 +94,54 @@ void StenoReverseMapDictionary::AddMapDictionaryData(
   }
 }
 
+void StenoReverseMapDictionary::SearchTranslations(
+    StenoTranslationSearch &search) const {
+#if USE_TEXT_BLOCK_INDEX
+  if (textBlockIndex == nullptr) {
+    textBlockIndex = new StenoTextBlockIndex(textBlock, textBlockLength);
+  }
+  textBlockIndex->Search(search);
+#else
+  StenoTextBlockIndex::Scan(textBlock, textBlockLength, search);
+#endif
+  dictionary->SearchTranslations(search);
+}
+
 // This ensures that the results are not conflicting with higher priority
 // dictionaries.
 void StenoReverseMapDictionary::FilterResult(
     StenoReverseDictionaryLookup &result) const {
+  const size_t resultCount = result.resultCount;
+  if (resultCount == 0) {
+    return;
+  }
+
+  // Resolve providers a batch at a time, each in a single pass over the
+  // dictionary list.
+  const size_t MAXIMUM_BATCH_SIZE =
+      StenoDictionaryOutlineQuery::MAXIMUM_BATCH_SIZE;
+  StenoDictionaryOutlineQuery queries[MAXIMUM_BATCH_SIZE];
+  StenoDictionaryOutlineQuery *queryPointers[MAXIMUM_BATCH_SIZE];
+
   size_t newCount = 0;
-  for (size_t i = 0; i < result.resultCount; ++i) {
-    const StenoReverseDictionaryResult &r = result.results[i];
-    if (dictionary->GetDictionaryForOutline(r.strokes, r.length) ==
-        r.lookupProvider) {
-      result.results[newCount++] = r;
+  for (size_t start = 0; start < resultCount; start += MAXIMUM_BATCH_SIZE) {
+    size_t batchSize = resultCount - start;
+    if (batchSize > MAXIMUM_BATCH_SIZE) {
+      batchSize = MAXIMUM_BATCH_SIZE;
+    }
+
+    for (size_t i = 0; i < batchSize; ++i) {
+      const StenoReverseDictionaryResult &r = result.results[start + i];
+      queries[i] = StenoDictionaryOutlineQuery(r.strokes, r.length);
+      queryPointers[i] = &queries[i];
+    }
+    dictionary->GetDictionariesForOutlines(queryPointers, batchSize);
+
+    for (size_t i = 0; i < batchSize; ++i) {
+      const StenoReverseDictionaryResult &r = result.results[start + i];
+      if (queries[i].provider == r.lookupProvider) {
+        result.results[newCount++] = r;
+      }
     }
   }
   result.resultCount = newCount;
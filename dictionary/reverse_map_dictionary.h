@@ -5,6 +5,10 @@
 
 //---------------------------------------------------------------------------
 
+class StenoTextBlockIndex;
+
+//---------------------------------------------------------------------------
+
 class StenoReverseMapDictionary final : public StenoWrappedDictionary {
 public:
   StenoReverseMapDictionary(StenoDictionary *dictionary,
@@ -12,6 +16,7 @@ public:
                             const uint8_t *textBlock, size_t textBlockLength);
 
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
+  virtual void SearchTranslations(StenoTranslationSearch &search) const;
 
   virtual const char *GetName() const;
 
@@ -24,6 +29,9 @@ private:
   const uint8_t *index[INDEX_SIZE + 1];
   size_t indexSize = 0;
 
+  // Built on first search.
+  mutable StenoTextBlockIndex *textBlockIndex = nullptr;
+
   void AddMapDictionaryData(StenoReverseDictionaryLookup &result) const;
   void FilterResult(StenoReverseDictionaryLookup &result) const;
 
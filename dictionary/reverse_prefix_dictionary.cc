@@ -1,6 +1,8 @@
 //---------------------------------------------------------------------------
 
 #include "reverse_prefix_dictionary.h"
+#include "../clock.h"
+#include "../console.h"
 #include "../list.h"
 #include "dictionary.h"
 #include "map_data_lookup.h"
@@ -8,11 +10,6 @@
 
 //---------------------------------------------------------------------------
 
-struct StenoReversePrefixDictionary::Prefix {
-  const uint8_t *text;
-  MapDataLookup mapDataLookup;
-};
-
 class StenoReversePrefixDictionary::TextBlockHandler {
 public:
   virtual void AddPrefix(const uint8_t *prefix) = 0;
@@ -116,17 +113,39 @@ StenoReversePrefixDictionary::ReverseLookupContext::FindPrefixLookup() const {
 StenoReversePrefixDictionary::StenoReversePrefixDictionary(
     StenoDictionary *dictionary, const uint8_t *baseAddress,
     const uint8_t *textBlock, size_t textBlockLength)
+    : StenoReversePrefixDictionary(dictionary, baseAddress, textBlock,
+                                   textBlockLength, nullptr) {}
+
+StenoReversePrefixDictionary::StenoReversePrefixDictionary(
+    StenoDictionary *dictionary, const uint8_t *baseAddress,
+    const uint8_t *textBlock, size_t textBlockLength,
+    const StenoReversePrefixTable *prefixTable)
     : StenoWrappedDictionary(dictionary), baseAddress(baseAddress) {
+  if (prefixTable) {
+    isPrebuilt = true;
+    prefixCount = prefixTable->prefixCount;
+    prefixes = prefixTable->prefixes;
+  } else {
+    BuildPrefixes(textBlock, textBlockLength);
+  }
+}
+
+void StenoReversePrefixDictionary::BuildPrefixes(const uint8_t *textBlock,
+                                                 size_t textBlockLength) {
+  uint32_t startTime = Clock::GetMicroseconds();
 
   CountTextBlockHandler counter;
   ProcessTextBlock(textBlock, textBlockLength, counter);
 
   prefixCount = counter.counter;
-  Prefix *prefixes = (Prefix *)malloc(prefixCount * sizeof(Prefix));
+  prefixHeapSize = prefixCount * sizeof(Prefix);
+  Prefix *prefixes = (Prefix *)malloc(prefixHeapSize);
   this->prefixes = prefixes;
 
   PopulateTextBlockHandler populate(prefixes);
   ProcessTextBlock(textBlock, textBlockLength, populate);
+
+  prefixBuildTimeUs = Clock::GetMicroseconds() - startTime;
 }
 
 void StenoReversePrefixDictionary::ProcessTextBlock(const uint8_t *textBlock,
@@ -314,4 +333,86 @@ const char *StenoReversePrefixDictionary::GetName() const {
   return "#internal#reverse_prefix_dictionary";
 }
 
+void StenoReversePrefixDictionary::PrintInfo(int depth) const {
+  if (isPrebuilt) {
+    Console::Printf("%sReverse prefixes: %zu (prebuilt)\n", Spaces(depth),
+                    prefixCount);
+  } else {
+    Console::Printf("%sReverse prefixes: %zu (%zu bytes, built in %uus)\n",
+                    Spaces(depth), prefixCount, prefixHeapSize,
+                    prefixBuildTimeUs);
+  }
+  StenoWrappedDictionary::PrintInfo(depth);
+}
+
+//---------------------------------------------------------------------------
+
+#include "../unit_test.h"
+#include "compact_map_dictionary.h"
+#include "dictionary_list.h"
+#include "reverse_map_dictionary.h"
+#include "reverse_text_block_builder.h"
+#include "test_dictionary.h"
+
+static void VerifyPrefixLookup(StenoDictionary &mainDictionary,
+                               const StenoReverseTextBlockBuilder &builder,
+                               const StenoReversePrefixTable *prefixTable,
+                               const char *expectedInfo) {
+  StenoDictionary *dictionaries[] = {&mainDictionary};
+  StenoDictionaryList dictionaryList(dictionaries, 1);
+  StenoReverseMapDictionary reverseMapDictionary(
+      &dictionaryList, builder.GetBaseAddress(), builder.GetTextBlock(),
+      builder.GetTextBlockLength());
+  StenoReversePrefixDictionary prefixDictionary(
+      &reverseMapDictionary, builder.GetBaseAddress(), builder.GetTextBlock(),
+      builder.GetTextBlockLength(), prefixTable);
+
+  Console::history.clear();
+  prefixDictionary.PrintInfo(0);
+  Console::history.push_back(0);
+  assert(Str::HasPrefix(&Console::history.front(), expectedInfo));
+  Console::history.clear();
+
+  // spellchecker: disable
+  const StenoStroke expected[] = {
+      StenoStroke("TEFT"),
+      StenoStroke("-D"),
+      StenoStroke("TEFT"),
+  };
+
+  StenoReverseDictionaryLookup lookup(8, "pretest");
+  prefixDictionary.ReverseLookup(lookup);
+  assert(lookup.resultCount == 1);
+  assert(lookup.results[0].lookupProvider == &prefixDictionary);
+  assert(lookup.HasResult(expected, 3));
+
+  StenoReverseDictionaryLookup missingLookup(8, "pretend");
+  // spellchecker: enable
+  prefixDictionary.ReverseLookup(missingLookup);
+  assert(!missingLookup.HasResults());
+}
+
+TEST_BEGIN("ReversePrefixDictionary: Prebuilt table lookup test") {
+  StenoReverseTextBlockBuilder builder;
+  StenoCompactMapDictionary mainDictionary(
+      builder.AddDictionary(TestDictionary::definition));
+
+  // The test dictionary has no prefix entries, so {pre^} borrows the
+  // TEFT/-D entry.
+  builder.Add("{pre^}", builder.FindData("tested"));
+  builder.Build();
+
+  const StenoReversePrefixTable *prefixTable = builder.GetPrefixTable();
+  assert(prefixTable->prefixCount == 1);
+  assert(Str::Eq((const char *)prefixTable->prefixes[0].text, "{pre^}"));
+
+  VerifyPrefixLookup(mainDictionary, builder, prefixTable,
+                     "Reverse prefixes: 1 (prebuilt)\n");
+
+  // The runtime scan finds the same table.
+  VerifyPrefixLookup(mainDictionary, builder, nullptr,
+                     "Reverse prefixes: 1 (16 bytes");
+}
+TEST_END
+
 //---------------------------------------------------------------------------
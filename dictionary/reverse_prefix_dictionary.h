@@ -1,10 +1,28 @@
 //---------------------------------------------------------------------------
 
 #pragma once
+#include "map_data_lookup.h"
 #include "wrapped_dictionary.h"
 
 //---------------------------------------------------------------------------
 
+struct StenoReversePrefixEntry {
+  const uint8_t *text;
+  MapDataLookup mapDataLookup;
+};
+
+// Sorted list of all `{...^}` entries in the text block.
+//
+// This can be prebuilt by the dictionary compiler and stored in flash,
+// in which case StenoReversePrefixDictionary does not need to scan the text
+// block at startup.
+struct StenoReversePrefixTable {
+  size_t prefixCount;
+  const StenoReversePrefixEntry prefixes[];
+};
+
+//---------------------------------------------------------------------------
+
 class StenoReversePrefixDictionary final : public StenoWrappedDictionary {
 public:
   StenoReversePrefixDictionary(StenoDictionary *dictionary,
@@ -12,10 +30,18 @@ public:
                                const uint8_t *textBlock,
                                size_t textBlockLength);
 
+  // If prefixTable is null, the text block is scanned instead.
+  StenoReversePrefixDictionary(StenoDictionary *dictionary,
+                               const uint8_t *baseAddress,
+                               const uint8_t *textBlock,
+                               size_t textBlockLength,
+                               const StenoReversePrefixTable *prefixTable);
+
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
   virtual const char *GetName() const;
+  virtual void PrintInfo(int depth) const;
 
-  struct Prefix;
+  typedef StenoReversePrefixEntry Prefix;
   class TextBlockHandler;
 
 private:
@@ -26,6 +52,15 @@ private:
   size_t prefixCount;
   const Prefix *prefixes;
 
+  bool isPrebuilt = false;
+
+  // Statistics for the runtime scan. Both are zero when a prebuilt table is
+  // used.
+  size_t prefixHeapSize = 0;
+  uint32_t prefixBuildTimeUs = 0;
+
+  void BuildPrefixes(const uint8_t *textBlock, size_t textBlockLength);
+
   struct ReverseLookupContext;
 
   void AddPrefixReverseLookup(ReverseLookupContext &context,
@@ -0,0 +1,190 @@
+//---------------------------------------------------------------------------
+
+#include "reverse_text_block_builder.h"
+#include "../str.h"
+#include "dictionary_definition.h"
+#include "reverse_prefix_dictionary.h"
+#include <assert.h>
+
+//---------------------------------------------------------------------------
+
+#if RUN_TESTS || RUN_BENCHMARKS
+
+StenoReverseTextBlockBuilder::~StenoReverseTextBlockBuilder() {
+  for (void *allocation : allocations) {
+    free(allocation);
+  }
+  free(textBlock);
+  free(prefixTable);
+}
+
+void StenoReverseTextBlockBuilder::Add(const char *text, const void *data) {
+  entries.Add(Entry{
+      .text = text,
+      .data = (const uint8_t *)data,
+  });
+}
+
+const StenoDictionaryDefinition &StenoReverseTextBlockBuilder::AddDictionary(
+    const StenoDictionaryDefinition &definition) {
+  assert(definition.type == StenoDictionaryType::COMPACT_MAP);
+  const size_t maximumOutlineLength = definition.maximumOutlineLength;
+
+  size_t byteCount = 0;
+  for (size_t length = 1; length <= maximumOutlineLength; ++length) {
+    const StenoMapDictionaryStrokesDefinition &strokes =
+        definition.strokes[length - 1];
+    const size_t dataSize =
+        strokes.GetCompactEntryCount() * 3 * (1 + length);
+    byteCount += (dataSize + 3) & ~3;
+    byteCount +=
+        strokes.hashMapSize / 128 * sizeof(StenoCompactHashMapEntryBlock);
+  }
+
+  StenoDictionaryDefinition *copy =
+      (StenoDictionaryDefinition *)malloc(sizeof(StenoDictionaryDefinition));
+  StenoMapDictionaryStrokesDefinition *strokesCopy =
+      (StenoMapDictionaryStrokesDefinition *)malloc(
+          maximumOutlineLength * sizeof(StenoMapDictionaryStrokesDefinition));
+  uint8_t *p = (uint8_t *)malloc(byteCount);
+  allocations.Add(copy);
+  allocations.Add(strokesCopy);
+  allocations.Add(p);
+
+  *copy = definition;
+  copy->strokes = strokesCopy;
+
+  for (size_t length = 1; length <= maximumOutlineLength; ++length) {
+    const StenoMapDictionaryStrokesDefinition &strokes =
+        definition.strokes[length - 1];
+    const size_t entrySize = 3 * (1 + length);
+    const size_t entryCount = strokes.GetCompactEntryCount();
+    const size_t dataSize = entryCount * entrySize;
+    const size_t offsetsSize =
+        strokes.hashMapSize / 128 * sizeof(StenoCompactHashMapEntryBlock);
+
+    StenoMapDictionaryStrokesDefinition &strokeCopy = strokesCopy[length - 1];
+    strokeCopy.hashMapSize = strokes.hashMapSize;
+    strokeCopy.data = p;
+    memcpy(p, strokes.data, dataSize);
+    p += (dataSize + 3) & ~3;
+    strokeCopy.offsets = p;
+    memcpy(p, strokes.offsets, offsetsSize);
+    p += offsetsSize;
+
+    for (size_t i = 0; i < entryCount; ++i) {
+      const uint8_t *data = strokeCopy.data + i * entrySize;
+      const uint32_t textOffset = data[0] | (data[1] << 8) | (data[2] << 16);
+      Add((const char *)definition.textBlock + textOffset, data);
+    }
+  }
+
+  return *copy;
+}
+
+const void *StenoReverseTextBlockBuilder::FindData(const char *text) const {
+  for (const Entry &entry : entries) {
+    if (Str::Eq(entry.text, text)) {
+      return entry.data;
+    }
+  }
+  return nullptr;
+}
+
+int StenoReverseTextBlockBuilder::CompareEntry(const void *a, const void *b) {
+  const Entry *entryA = (const Entry *)a;
+  const Entry *entryB = (const Entry *)b;
+  const int compare = strcmp(entryA->text, entryB->text);
+  if (compare != 0) {
+    return compare;
+  }
+  return entryA->data < entryB->data ? -1 : entryA->data > entryB->data;
+}
+
+// Matches the `{...^}` entries that StenoReversePrefixDictionary collects.
+bool StenoReverseTextBlockBuilder::IsPrefix(const char *text) {
+  size_t length = 0;
+  size_t braceCount = 0;
+  size_t caretCount = 0;
+  for (; text[length]; ++length) {
+    if (text[length] == '{' || text[length] == '}') {
+      ++braceCount;
+    }
+    if (text[length] == '^') {
+      ++caretCount;
+    }
+  }
+  return braceCount == 2 && caretCount == 1 && length >= 4 &&
+         text[0] == '{' && text[length - 2] == '^' && text[length - 1] == '}';
+}
+
+// Layout: 0xff, then for each distinct text in sorted order, the text, its
+// terminating zero, a 4 byte MapDataLookup per entry, and 0xff.
+void StenoReverseTextBlockBuilder::Build() {
+  assert(textBlock == nullptr);
+  entries.Sort(CompareEntry);
+
+  baseAddress = entries.IsEmpty() ? nullptr : entries[0].data;
+  size_t byteCount = 1;
+  size_t prefixCount = 0;
+  for (size_t i = 0; i < entries.GetCount(); ++i) {
+    const Entry &entry = entries[i];
+    if (entry.data < baseAddress) {
+      baseAddress = entry.data;
+    }
+    if (i == 0 || !Str::Eq(entry.text, entries[i - 1].text)) {
+      byteCount += strlen(entry.text) + 2;
+      if (IsPrefix(entry.text)) {
+        ++prefixCount;
+      }
+    }
+    byteCount += 4;
+  }
+
+  // The extra zero stops scans that run past the end of the block.
+  textBlock = (uint8_t *)malloc(byteCount + 1);
+  textBlockLength = byteCount;
+  prefixTable = (StenoReversePrefixTable *)malloc(
+      sizeof(StenoReversePrefixTable) +
+      prefixCount * sizeof(StenoReversePrefixEntry));
+  prefixTable->prefixCount = prefixCount;
+  StenoReversePrefixEntry *prefix =
+      (StenoReversePrefixEntry *)prefixTable->prefixes;
+
+  uint8_t *p = textBlock;
+  *p++ = 0xff;
+  for (size_t i = 0; i < entries.GetCount(); ++i) {
+    const Entry &entry = entries[i];
+    if (i == 0 || !Str::Eq(entry.text, entries[i - 1].text)) {
+      if (i != 0) {
+        *p++ = 0xff;
+      }
+      const size_t length = strlen(entry.text) + 1;
+      memcpy(p, entry.text, length);
+      if (IsPrefix(entry.text)) {
+        *prefix++ = StenoReversePrefixEntry{
+            .text = p,
+            .mapDataLookup = p + length,
+        };
+      }
+      p += length;
+    }
+
+    // MapDataLookup stores 7 bits per byte so that 0xff cannot appear.
+    const size_t offset = entry.data - baseAddress;
+    assert(offset < (1 << 28));
+    *p++ = offset & 0x7f;
+    *p++ = (offset >> 7) & 0x7f;
+    *p++ = (offset >> 14) & 0x7f;
+    *p++ = (offset >> 21) & 0x7f;
+  }
+  if (entries.IsNotEmpty()) {
+    *p++ = 0xff;
+  }
+  *p = 0;
+  assert(p == textBlock + textBlockLength);
+}
+
+#endif
+
+//---------------------------------------------------------------------------
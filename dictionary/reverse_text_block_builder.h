@@ -0,0 +1,63 @@
+//---------------------------------------------------------------------------
+
+#pragma once
+#include "../list.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+
+#if RUN_TESTS || RUN_BENCHMARKS
+
+struct StenoDictionaryDefinition;
+struct StenoReversePrefixTable;
+
+//---------------------------------------------------------------------------
+
+// Lays out map dictionaries, a reverse lookup text block and a prefix table
+// the same way the dictionary compiler does for a collection, so that the
+// reverse map and reverse prefix layers can be exercised by tests and
+// benchmarks.
+class StenoReverseTextBlockBuilder {
+public:
+  ~StenoReverseTextBlockBuilder();
+
+  // data must point to a map dictionary entry.
+  void Add(const char *text, const void *data);
+
+  // Reverse lookup relies on each stroke length's data being immediately
+  // followed by its offsets, so the compact map definition is copied into
+  // that layout. The returned copy is the one to create the dictionary from.
+  const StenoDictionaryDefinition &
+  AddDictionary(const StenoDictionaryDefinition &definition);
+
+  // Returns the data of the first entry added for text, or nullptr.
+  const void *FindData(const char *text) const;
+
+  void Build();
+
+  const uint8_t *GetBaseAddress() const { return baseAddress; }
+  const uint8_t *GetTextBlock() const { return textBlock; }
+  size_t GetTextBlockLength() const { return textBlockLength; }
+  const StenoReversePrefixTable *GetPrefixTable() const { return prefixTable; }
+
+private:
+  struct Entry {
+    const char *text;
+    const uint8_t *data;
+  };
+
+  List<Entry> entries;
+  List<void *> allocations;
+  const uint8_t *baseAddress = nullptr;
+  uint8_t *textBlock = nullptr;
+  size_t textBlockLength = 0;
+  StenoReversePrefixTable *prefixTable = nullptr;
+
+  static int CompareEntry(const void *a, const void *b);
+  static bool IsPrefix(const char *text);
+};
+
+#endif
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,214 @@
+//---------------------------------------------------------------------------
+
+#include "text_block_index.h"
+#include "dictionary.h"
+#include "map_data_lookup.h"
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+
+static inline int AsciiToLower(int c) {
+  return ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Returns a pointer to the start of the next entry.
+static const uint8_t *SkipEntry(const uint8_t *text) {
+  while (*text != 0) {
+    ++text;
+  }
+  MapDataLookup lookup(text + 1);
+  while (lookup.HasData()) {
+    ++lookup;
+  }
+  return lookup.GetPointer() + 1;
+}
+
+//---------------------------------------------------------------------------
+
+StenoTextBlockIndex::StenoTextBlockIndex(const uint8_t *textBlock,
+                                         size_t textBlockLength)
+    : textBlock(textBlock), textBlockLength(textBlockLength) {
+  bucketStarts = (uint32_t *)calloc(BUCKET_COUNT + 1, sizeof(uint32_t));
+
+  // Used to only count each entry once per bucket.
+  uint32_t *lastOffsets = (uint32_t *)calloc(BUCKET_COUNT, sizeof(uint32_t));
+
+  // Pass 1: Count entries per bucket.
+  ForEachEntry([&](uint32_t offset) {
+    ForEachTrigramBucket(textBlock + offset, [&](size_t bucket) {
+      if (lastOffsets[bucket] != offset) {
+        lastOffsets[bucket] = offset;
+        ++bucketStarts[bucket + 1];
+      }
+    });
+  });
+
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    bucketStarts[i + 1] += bucketStarts[i];
+  }
+  postingCount = bucketStarts[BUCKET_COUNT];
+  postings = (uint32_t *)malloc(postingCount * sizeof(uint32_t));
+
+  // Pass 2: Fill postings in text block order.
+  uint32_t *fillPositions = (uint32_t *)malloc(BUCKET_COUNT * sizeof(uint32_t));
+  memcpy(fillPositions, bucketStarts, BUCKET_COUNT * sizeof(uint32_t));
+  memset(lastOffsets, 0, BUCKET_COUNT * sizeof(uint32_t));
+  ForEachEntry([&](uint32_t offset) {
+    ForEachTrigramBucket(textBlock + offset, [&](size_t bucket) {
+      if (lastOffsets[bucket] != offset) {
+        lastOffsets[bucket] = offset;
+        postings[fillPositions[bucket]++] = offset;
+      }
+    });
+  });
+
+  free(fillPositions);
+  free(lastOffsets);
+}
+
+StenoTextBlockIndex::~StenoTextBlockIndex() {
+  free(postings);
+  free(bucketStarts);
+}
+
+size_t StenoTextBlockIndex::GetMemoryUsage() const {
+  return (BUCKET_COUNT + 1 + postingCount) * sizeof(uint32_t);
+}
+
+// Entry offsets are never 0, as the text block starts with 0xff.
+template <typename F> void StenoTextBlockIndex::ForEachEntry(F &&f) const {
+  const uint8_t *end = textBlock + textBlockLength;
+  for (const uint8_t *p = textBlock + 1; p < end; p = SkipEntry(p)) {
+    f(uint32_t(p - textBlock));
+  }
+}
+
+template <typename F>
+void StenoTextBlockIndex::ForEachTrigramBucket(const uint8_t *text, F &&f) {
+  if (text[0] == 0 || text[1] == 0) {
+    return;
+  }
+  for (const uint8_t *p = text; p[2] != 0; ++p) {
+    f(GetBucket(p[0], p[1], p[2]));
+  }
+}
+
+size_t StenoTextBlockIndex::GetBucket(int a, int b, int c) {
+  const uint32_t trigram =
+      (AsciiToLower(a) << 16) | (AsciiToLower(b) << 8) | AsciiToLower(c);
+  return (trigram * 0x9e3779b9) >> (32 - BUCKET_BITS);
+}
+
+void StenoTextBlockIndex::Search(StenoTranslationSearch &search) const {
+  if (search.fragmentLength < 3) {
+    Scan(textBlock, textBlockLength, search);
+    return;
+  }
+
+  // Candidates are the entries of the smallest bucket of any fragment
+  // trigram. Each is then verified against the full fragment.
+  size_t bestBucket = 0;
+  size_t bestCount = (size_t)-1;
+  ForEachTrigramBucket((const uint8_t *)search.fragment, [&](size_t bucket) {
+    const size_t count = bucketStarts[bucket + 1] - bucketStarts[bucket];
+    if (count < bestCount) {
+      bestBucket = bucket;
+      bestCount = count;
+    }
+  });
+
+  const uint32_t *posting = postings + bucketStarts[bestBucket];
+  const uint32_t *postingEnd = postings + bucketStarts[bestBucket + 1];
+  for (; posting < postingEnd; ++posting) {
+    if (search.IsFull()) {
+      return;
+    }
+    const char *text = (const char *)textBlock + *posting;
+    if (search.Matches(text)) {
+      search.AddResult(text);
+    }
+  }
+}
+
+void StenoTextBlockIndex::Scan(const uint8_t *textBlock, size_t textBlockLength,
+                               StenoTranslationSearch &search) {
+  const uint8_t *end = textBlock + textBlockLength;
+  for (const uint8_t *p = textBlock + 1; p < end; p = SkipEntry(p)) {
+    if (search.IsFull()) {
+      return;
+    }
+    if (search.Matches((const char *)p)) {
+      search.AddResult((const char *)p);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+
+#include "../unit_test.h"
+#include <string>
+#include <vector>
+
+// spellchecker: disable
+static const uint8_t TEST_TEXT_BLOCK[] =
+    "\xff"
+    "Catalog\0\x01\x00\x00\x00\xff"
+    "cat\0\x02\x00\x00\x00\x03\x00\x00\x00\xff"
+    "concatenate\0\x04\x00\x00\x00\xff"
+    "do\0\x05\x00\x00\x00\xff"
+    "dog\0\x06\x00\x00\x00\xff";
+// spellchecker: enable
+
+static void CollectResult(void *context, const char *text) {
+  ((std::vector<std::string> *)context)->push_back(text);
+}
+
+static std::vector<std::string> IndexSearch(const StenoTextBlockIndex &index,
+                                            const char *fragment,
+                                            size_t maximumResultCount = 8) {
+  std::vector<std::string> results;
+  StenoTranslationSearch search(fragment, maximumResultCount, CollectResult,
+                                &results);
+  index.Search(search);
+  return results;
+}
+
+static std::vector<std::string> ScanSearch(const char *fragment) {
+  std::vector<std::string> results;
+  StenoTranslationSearch search(fragment, 8, CollectResult, &results);
+  StenoTextBlockIndex::Scan(TEST_TEXT_BLOCK, sizeof(TEST_TEXT_BLOCK) - 1,
+                            search);
+  return results;
+}
+
+TEST_BEGIN("TextBlockIndex: Trigram search matches scan") {
+  StenoTextBlockIndex index(TEST_TEXT_BLOCK, sizeof(TEST_TEXT_BLOCK) - 1);
+
+  // spellchecker: disable
+  const std::vector<std::string> catResults = IndexSearch(index, "cat");
+  assert(catResults.size() == 3);
+  assert(catResults[0] == "Catalog");
+  assert(catResults[1] == "cat");
+  assert(catResults[2] == "concatenate");
+  assert(catResults == ScanSearch("cat"));
+
+  assert(IndexSearch(index, "CATA") == ScanSearch("CATA"));
+  assert(IndexSearch(index, "CATA").size() == 1);
+  assert(IndexSearch(index, "nate") == ScanSearch("nate"));
+  assert(IndexSearch(index, "xyz").empty());
+
+  // Fragments shorter than a trigram fall back to a scan.
+  assert(IndexSearch(index, "do").size() == 2);
+  // spellchecker: enable
+}
+TEST_END
+
+TEST_BEGIN("TextBlockIndex: Search stops at result limit") {
+  StenoTextBlockIndex index(TEST_TEXT_BLOCK, sizeof(TEST_TEXT_BLOCK) - 1);
+  assert(IndexSearch(index, "cat", 2).size() == 2);
+  assert(IndexSearch(index, "a", 1).size() == 1);
+}
+TEST_END
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+//---------------------------------------------------------------------------
+
+#pragma once
+#include "../malloc_allocate.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+
+struct StenoTranslationSearch;
+
+//---------------------------------------------------------------------------
+
+#if JAVELIN_PLATFORM_PICO_SDK || JAVELIN_PLATFORM_NRF5_SDK
+#define USE_TEXT_BLOCK_INDEX 0
+#else
+#define USE_TEXT_BLOCK_INDEX 1
+#endif
+
+//---------------------------------------------------------------------------
+
+// A trigram index over a collection text block, used to find all entries
+// containing a fragment without scanning every entry.
+//
+// Text block entries are laid out as: 0xff text \0 map data...
+//
+// Trigrams are ASCII case folded and hashed into a fixed number of buckets.
+// Each bucket holds the sorted text block offsets of every entry containing a
+// trigram in that bucket, so results are produced in text block order.
+class StenoTextBlockIndex : public JavelinMallocAllocate {
+public:
+  StenoTextBlockIndex(const uint8_t *textBlock, size_t textBlockLength);
+  ~StenoTextBlockIndex();
+
+  void Search(StenoTranslationSearch &search) const;
+
+  size_t GetMemoryUsage() const;
+
+  // Tests every entry. Used when there is no index, or when the fragment is
+  // shorter than a trigram.
+  static void Scan(const uint8_t *textBlock, size_t textBlockLength,
+                   StenoTranslationSearch &search);
+
+private:
+  static const size_t BUCKET_BITS = 12;
+  static const size_t BUCKET_COUNT = 1 << BUCKET_BITS;
+
+  const uint8_t *textBlock;
+  size_t textBlockLength;
+
+  size_t postingCount = 0;
+  uint32_t *bucketStarts;
+  uint32_t *postings;
+
+  template <typename F> void ForEachEntry(F &&f) const;
+  template <typename F>
+  static void ForEachTrigramBucket(const uint8_t *text, F &&f);
+  static size_t GetBucket(int a, int b, int c);
+};
+
+//---------------------------------------------------------------------------
@@ -293,6 +293,7 @@ void StenoUserDictionary::UpgradeToVersionWithReverseLookup() {
 //---------------------------------------------------------------------------
 
 void StenoUserDictionary::Reset() {
+  InvalidateContent();
   Flash::Erase(layout.hashTable, layout.hashTableSize * sizeof(uint32_t));
   Flash::Erase(layout.reverseHashTable,
                layout.hashTableSize * sizeof(uint32_t));
@@ -339,6 +340,7 @@ bool StenoUserDictionary::Add(const StenoStroke *strokes, size_t length,
   if (!AddToHashTable(strokes, length, data.offset)) {
     return false;
   }
+  InvalidateContent();
 
   AddToReverseHashTable(word, data.offset);
 
@@ -485,6 +487,7 @@ bool StenoUserDictionary::Remove(const StenoStroke *strokes, size_t length) {
   if (deletedEntry == nullptr) {
     return false;
   }
+  InvalidateContent();
 
   RemoveFromReverseHashTable(deletedEntry);
   return true;
@@ -791,6 +794,15 @@ TEST_BEGIN("StenoUserDictionary add and lookup test") {
   assert(Str::Eq(userDictionary.Lookup(KAT, 1).GetText(), "cat"));
   assert(Str::Eq(userDictionary.Lookup(TKOG, 1).GetText(), "dog"));
   assert(Str::Eq(userDictionary.Lookup(KAPBG_RAO, 2).GetText(), "kangaroo"));
+
+  // Only changes to the contents invalidate cached lookups.
+  const uint32_t contentGeneration = StenoDictionary::GetContentGeneration();
+  userDictionary.Add(KAT, 1, "cat");
+  userDictionary.Remove(KAPBG_RAO, 1);
+  assert(StenoDictionary::GetContentGeneration() == contentGeneration);
+
+  userDictionary.Add(KAT, 1, "cats");
+  assert(StenoDictionary::GetContentGeneration() != contentGeneration);
   // spellchecker: enable
 }
 TEST_END
@@ -14,11 +14,21 @@ const StenoDictionary *StenoWrappedDictionary::GetDictionaryForOutline(
   return dictionary->GetDictionaryForOutline(lookup);
 }
 
+void StenoWrappedDictionary::GetDictionariesForOutlines(
+    StenoDictionaryOutlineQuery *const *queries, size_t count) const {
+  dictionary->GetDictionariesForOutlines(queries, count);
+}
+
 void StenoWrappedDictionary::ReverseLookup(
     StenoReverseDictionaryLookup &result) const {
   return dictionary->ReverseLookup(result);
 }
 
+void StenoWrappedDictionary::SearchTranslations(
+    StenoTranslationSearch &search) const {
+  dictionary->SearchTranslations(search);
+}
+
 void StenoWrappedDictionary::SetParentRecursively(StenoDictionary *parent) {
   StenoDictionary::SetParentRecursively(parent);
   dictionary->SetParentRecursively(this);
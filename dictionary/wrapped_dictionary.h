@@ -27,7 +27,12 @@ public:
     return GetDictionaryForOutline(StenoDictionaryLookup(strokes, length));
   }
 
+  virtual void
+  GetDictionariesForOutlines(StenoDictionaryOutlineQuery *const *queries,
+                             size_t count) const;
+
   virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const;
+  virtual void SearchTranslations(StenoTranslationSearch &search) const;
 
   virtual void SetParentRecursively(StenoDictionary *parent) final;
 
@@ -29,11 +29,16 @@ StenoEngine::StenoEngine(StenoDictionary &dictionary,
     : dictionary(dictionary), orthography(orthography),
       userDictionary(userDictionary) {
 
-  previousConversionBuffer.Prepare(&this->orthography, &this->dictionary);
-  nextConversionBuffer.Prepare(&this->orthography, &this->dictionary);
+  previousConversionBuffer.Prepare(&keyCodeBuffers[0], &this->orthography,
+                                   &this->dictionary);
+  nextConversionBuffer.Prepare(&keyCodeBuffers[1], &this->orthography,
+                               &this->dictionary);
+  suggestionKeyCodeBuffer.Prepare(&this->orthography, &this->dictionary);
   ResetState();
 }
 
+StenoEngine::~StenoEngine() { ClearSuggestionCache(); }
+
 //---------------------------------------------------------------------------
 
 void StenoEngine::Process(const StenoKeyState &value, StenoAction action) {
@@ -52,6 +57,7 @@ void StenoEngine::Process(const StenoKeyState &value, StenoAction action) {
 
 void StenoEngine::ProcessStroke(StenoStroke stroke) {
   ExternalFlashSentry externalFlashSentry;
+  StrokeArenaSentry strokeArenaSentry(strokeArena);
 
   switch (mode) {
   case StenoEngineMode::NORMAL:
@@ -64,8 +70,23 @@ void StenoEngine::ProcessStroke(StenoStroke stroke) {
   }
 }
 
+// Each stroke is still reported to the paper tape and text log, but only the
+// net change in output is emitted once all strokes are processed.
+void StenoEngine::ProcessStrokes(const StenoStroke *strokes, size_t count) {
+  emitter.BeginBatch();
+  for (size_t i = 0; i < count; ++i) {
+    if (strokes[i] == UNDO_STROKE) {
+      ProcessUndo();
+    } else {
+      ProcessStroke(strokes[i]);
+    }
+  }
+  emitter.EndBatch();
+}
+
 void StenoEngine::ProcessUndo() {
   ExternalFlashSentry externalFlashSentry;
+  StrokeArenaSentry strokeArenaSentry(strokeArena);
 
   switch (mode) {
   case StenoEngineMode::NORMAL:
@@ -95,6 +116,7 @@ bool StenoEngine::ProcessScanCode(uint32_t scanCodeAndModifiers,
 //---------------------------------------------------------------------------
 
 void StenoEngine::ResetState() {
+  InvalidateCarriedConversion();
   history.Reset();
   addTranslationHistory.Reset();
   state.Reset();
@@ -111,6 +133,12 @@ void StenoEngine::PrintInfo() const {
                   KeyboardLayout::GetActiveLayout().GetName());
   Console::Printf("    Space position: %s\n",
                   placeSpaceAfter ? "after" : "before");
+  Console::Printf("    Carried conversions: %zu\n", carriedConversionCount);
+  Console::Printf("    Resumed segments: %zu\n", resumedSegmentCount);
+  Console::Printf("    Segment lookup cache: %zu hits, %zu misses\n",
+                  segmentLookupCache.GetHitCount(),
+                  segmentLookupCache.GetMissCount());
+  strokeArena.PrintInfo();
 
   orthography.PrintInfo();
 
@@ -148,6 +176,11 @@ bool StenoEngine::ToggleDictionary(const char *name) {
   return dictionary.ToggleDictionary(name);
 }
 
+void StenoEngine::SearchTranslations(StenoTranslationSearch &search) const {
+  ExternalFlashSentry externalFlashSentry;
+  dictionary.SearchTranslations(search);
+}
+
 void StenoEngine::ReverseLookup(StenoReverseDictionaryLookup &result) const {
   ExternalFlashSentry externalFlashSentry;
 
@@ -181,13 +214,14 @@ void StenoEngine::ReverseLookup(StenoReverseDictionaryLookup &result) const {
 void StenoEngine::SendText(const uint8_t *p) {
   const char *ccp = (const char *)p;
 
-  nextConversionBuffer.keyCodeBuffer.Reset();
-  nextConversionBuffer.keyCodeBuffer.AppendTextNoCaseModeOverride(
+  InvalidateCarriedConversion();
+  nextConversionBuffer.keyCodeBuffer->Reset();
+  nextConversionBuffer.keyCodeBuffer->AppendTextNoCaseModeOverride(
       ccp, strlen(ccp), StenoCaseMode::NORMAL);
-  previousConversionBuffer.keyCodeBuffer.Reset();
+  previousConversionBuffer.keyCodeBuffer->Reset();
 
-  emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                  nextConversionBuffer.keyCodeBuffer);
+  emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                  *nextConversionBuffer.keyCodeBuffer);
 }
 
 __attribute__((weak)) void StenoEngine::Pump() {}
@@ -207,7 +241,6 @@ __attribute__((weak)) void StenoEngine::Pump() {}
 #include "dictionary/test_dictionary.h"
 #include "dictionary/unicode_dictionary.h"
 
-extern StenoOrthography testOrthography;
 extern StenoDictionaryDefinition testDictionaryDefinition;
 // constexpr StenoMapDictionary testDictionary(testDictionaryDefinition);
 
@@ -224,12 +257,23 @@ public:
   static void TestEngine(StenoEngine &engine);
   static void TestAddTranslation(StenoEngine &engine);
   static void TestScancodeAddTranslation(StenoEngine &engine);
+  static void TestSuggestionCache(StenoEngine &engine,
+                                  StenoUserDictionary &userDictionary);
+  static void TestArenaSuggestions(StenoEngine &engine,
+                                   StenoUserDictionary &userDictionary);
+  static void
+  TestSuggestionBufferOverflow(StenoEngine &engine,
+                               StenoUserDictionary &userDictionary);
   static void VerifyTextBuffer(StenoEngine &engine, const char *expected);
+  static void TestCarriedConversion(StenoDictionary &dictionary,
+                                    bool placeSpaceAfter);
+  static void TestSegmentLookupCache(StenoDictionary &dictionary);
+  static void TestProcessStrokes(StenoDictionary &dictionary);
 };
 
 void StenoEngineTester::VerifyTextBuffer(StenoEngine &engine,
                                          const char *expected) {
-  char *p = engine.nextConversionBuffer.keyCodeBuffer.ToString();
+  char *p = engine.nextConversionBuffer.keyCodeBuffer->ToString();
   if (!Str::Eq(p, expected)) {
     printf("Expected: %s\nActual: %s\n", expected, p);
     assert(Str::Eq(p, expected));
@@ -243,14 +287,14 @@ void StenoEngineTester::TestSymbols(StenoEngine &engine) {
   engine.ProcessStroke(StenoStroke("SKWHEUFPL"));
   engine.ProcessStroke(StenoStroke("SKWHEFG"));
   // spellchecker: enable
-  assert(engine.nextConversionBuffer.keyCodeBuffer.count == 4);
-  assert(engine.nextConversionBuffer.keyCodeBuffer.buffer[0] ==
+  assert(engine.nextConversionBuffer.keyCodeBuffer->count == 4);
+  assert(engine.nextConversionBuffer.keyCodeBuffer->buffer[0] ==
          StenoKeyCode('{', StenoCaseMode::NORMAL));
-  assert(engine.nextConversionBuffer.keyCodeBuffer.buffer[1] ==
+  assert(engine.nextConversionBuffer.keyCodeBuffer->buffer[1] ==
          StenoKeyCode('{', StenoCaseMode::NORMAL));
-  assert(engine.nextConversionBuffer.keyCodeBuffer.buffer[2] ==
+  assert(engine.nextConversionBuffer.keyCodeBuffer->buffer[2] ==
          StenoKeyCode::CreateRawKeyCodePress(KeyCode::BACKSPACE));
-  assert(engine.nextConversionBuffer.keyCodeBuffer.buffer[3] ==
+  assert(engine.nextConversionBuffer.keyCodeBuffer->buffer[3] ==
          StenoKeyCode::CreateRawKeyCodeRelease(KeyCode::BACKSPACE));
 }
 
@@ -352,11 +396,230 @@ TEST_BEGIN("Engine: Random spam") {
 }
 TEST_END
 
+// Carrying each stroke's conversion forward must emit the same keys as
+// rebuilding the previous conversion.
+void StenoEngineTester::TestCarriedConversion(StenoDictionary &dictionary,
+                                              bool placeSpaceAfter) {
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine carriedEngine(dictionary, orthography);
+  StenoEngine rebuiltEngine(dictionary, orthography);
+  carriedEngine.SetSpaceAfter(placeSpaceAfter);
+  rebuiltEngine.SetSpaceAfter(placeSpaceAfter);
+
+  srand(0x5678);
+  for (size_t i = 0; i < 2000; ++i) {
+    const bool isUndo = (rand() & 15) == 0;
+    const StenoStroke stroke(rand() & StrokeMask::ALL);
+
+    Key::history.clear();
+    isUndo ? carriedEngine.ProcessUndo() : carriedEngine.ProcessStroke(stroke);
+    const std::vector<Key::HistoryEntry> carriedKeys = Key::history;
+
+    Key::history.clear();
+    rebuiltEngine.InvalidateCarriedConversion();
+    isUndo ? rebuiltEngine.ProcessUndo() : rebuiltEngine.ProcessStroke(stroke);
+
+    assert(carriedKeys.size() == Key::history.size());
+    for (size_t j = 0; j < carriedKeys.size(); ++j) {
+      assert(carriedKeys[j].code == Key::history[j].code);
+      assert(carriedKeys[j].isPress == Key::history[j].isPress);
+    }
+  }
+  Key::history.clear();
+  assert(carriedEngine.carriedConversionCount > 1000);
+  // Carried strokes only convert the segments that changed.
+  assert(carriedEngine.resumedSegmentCount <
+         3 * carriedEngine.carriedConversionCount);
+  assert(rebuiltEngine.carriedConversionCount == 0);
+}
+
+TEST_BEGIN("Engine: Carried conversion test") {
+  static StenoDictionary *DICTIONARIES[] = {
+      &StenoJeffPhrasingDictionary::instance,
+      &StenoEmilySymbolsDictionary::instance,
+      &mainDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      DICTIONARIES, sizeof(DICTIONARIES) / sizeof(*DICTIONARIES)); // NOLINT
+  StenoEngineTester::TestCarriedConversion(dictionaryList, false);
+  StenoEngineTester::TestCarriedConversion(dictionaryList, true);
+}
+TEST_END
+
+// Replays key presses as typed text. Each non-modifier key press, together
+// with the modifiers held at the time, is one character that backspace
+// removes. This only holds while every character is a single key press, so
+// the unicode mode must be NONE.
+static void ReplayKeyHistory(std::vector<uint32_t> &text) {
+  uint32_t modifiers = 0;
+  for (const Key::HistoryEntry &entry : Key::history) {
+    if (entry.code.IsModifier()) {
+      const uint32_t mask = 1 << (entry.code.value - KeyCode::L_CTRL);
+      modifiers = entry.isPress ? modifiers | mask : modifiers & ~mask;
+    } else if (!entry.isPress) {
+      continue;
+    } else if (entry.code == KeyCode::BACKSPACE && modifiers == 0) {
+      if (!text.empty()) {
+        text.pop_back();
+      }
+    } else {
+      text.push_back(modifiers << 8 | entry.code.value);
+    }
+  }
+  Key::history.clear();
+}
+
+// Batched strokes must reach the same state and typed text as processing
+// them one at a time, while emitting fewer keys.
+void StenoEngineTester::TestProcessStrokes(StenoDictionary &dictionary) {
+  const StenoStroke UNDO_STROKE = StenoEngine::UNDO_STROKE;
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine singleEngine(dictionary, orthography);
+  StenoEngine batchEngine(dictionary, orthography);
+
+  const char *unicodeMode = StenoKeyCodeEmitter::GetUnicodeModeName();
+  StenoKeyCodeEmitter::SetUnicodeMode(UnicodeMode::NONE);
+
+  srand(0x9abc);
+  size_t singleKeyCount = 0;
+  size_t batchKeyCount = 0;
+  std::vector<uint32_t> singleText;
+  std::vector<uint32_t> batchText;
+  for (size_t i = 0; i < 40; ++i) {
+    StenoStroke strokes[50];
+    for (StenoStroke &stroke : strokes) {
+      const bool isUndo = (rand() & 3) == 0;
+      stroke = isUndo ? UNDO_STROKE : StenoStroke(rand() & StrokeMask::ALL);
+    }
+    strokes[25] = UNDO_STROKE;
+
+    Key::history.clear();
+    for (const StenoStroke &stroke : strokes) {
+      stroke == UNDO_STROKE ? singleEngine.ProcessUndo()
+                            : singleEngine.ProcessStroke(stroke);
+    }
+    singleKeyCount += Key::history.size();
+    ReplayKeyHistory(singleText);
+
+    batchEngine.ProcessStrokes(strokes, 50);
+    batchKeyCount += Key::history.size();
+    ReplayKeyHistory(batchText);
+
+    assert(singleText == batchText);
+
+    char *single = singleEngine.nextConversionBuffer.keyCodeBuffer->ToString();
+    char *batch = batchEngine.nextConversionBuffer.keyCodeBuffer->ToString();
+    assert(Str::Eq(single, batch));
+    free(single);
+    free(batch);
+  }
+  assert(batchKeyCount < singleKeyCount);
+
+  StenoKeyCodeEmitter::SetUnicodeMode(unicodeMode);
+}
+
+TEST_BEGIN("Engine: Process strokes test") {
+  static StenoDictionary *DICTIONARIES[] = {
+      &StenoJeffPhrasingDictionary::instance,
+      &StenoEmilySymbolsDictionary::instance,
+      &mainDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      DICTIONARIES, sizeof(DICTIONARIES) / sizeof(*DICTIONARIES)); // NOLINT
+  StenoEngineTester::TestProcessStrokes(dictionaryList);
+}
+TEST_END
+
+void StenoEngineTester::TestSegmentLookupCache(StenoDictionary &dictionary) {
+  // spellchecker: disable
+  const StenoStroke STROKES[] = {
+      StenoStroke("KAT"),   StenoStroke("TKOG"), StenoStroke("WORBG"),
+      StenoStroke("TEFT"),  StenoStroke("-D"),   StenoStroke("SKWHU"),
+      StenoStroke("#EU"),   StenoStroke("*"),
+  };
+  // spellchecker: enable
+  const size_t STROKE_COUNT = sizeof(STROKES) / sizeof(*STROKES); // NOLINT
+
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine cachedEngine(dictionary, orthography);
+  StenoEngine uncachedEngine(dictionary, orthography);
+
+  srand(0x1234);
+  for (size_t i = 0; i < 2000; ++i) {
+    const bool isUndo = (rand() & 15) == 0;
+    const StenoStroke stroke = (rand() & 7) == 0
+                                   ? StenoStroke(rand() & StrokeMask::ALL)
+                                   : STROKES[rand() % STROKE_COUNT];
+
+    Key::history.clear();
+    isUndo ? cachedEngine.ProcessUndo() : cachedEngine.ProcessStroke(stroke);
+    const std::vector<Key::HistoryEntry> cachedKeys = Key::history;
+
+    Key::history.clear();
+    uncachedEngine.segmentLookupCache.Clear();
+    isUndo ? uncachedEngine.ProcessUndo()
+           : uncachedEngine.ProcessStroke(stroke);
+
+    assert(cachedKeys.size() == Key::history.size());
+    for (size_t j = 0; j < cachedKeys.size(); ++j) {
+      assert(cachedKeys[j].code == Key::history[j].code);
+      assert(cachedKeys[j].isPress == Key::history[j].isPress);
+    }
+  }
+  Key::history.clear();
+  // Segments more than maximumOutlineLength before the end of the window
+  // should not be looked up again.
+  assert(cachedEngine.segmentLookupCache.GetHitCount() > 2000);
+}
+
+TEST_BEGIN("Engine: Segment lookup cache test") {
+  uint8_t *buffer = new uint8_t[512 * 1024];
+  StenoUserDictionaryData layout(buffer, 512 * 1024);
+  StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+  userDictionary->Reset();
+
+  // spellchecker: disable
+  const StenoStroke KAT("KAT"), TKOG("TKOG"), WORBG("WORBG"), TEFT("TEFT"),
+      D("-D");
+  const struct {
+    size_t length;
+    StenoStroke strokes[6];
+    const char *text;
+  } USER_ENTRIES[] = {
+      {2, {KAT, TKOG}, "cat dog"},
+      {3, {TKOG, WORBG, TEFT}, "dog work test"},
+      {6, {KAT, TKOG, WORBG, TEFT, D, KAT}, "cat dog work tested cat"},
+      {4, {TEFT, TEFT, TEFT, TEFT}, "test four"},
+      {2, {D, D}, "{*?}"},
+  };
+  // spellchecker: enable
+  for (const auto &entry : USER_ENTRIES) {
+    userDictionary->Add(entry.strokes, entry.length, entry.text);
+  }
+
+  static StenoDictionary *dictionaries[] = {
+      userDictionary,
+      &StenoEmilySymbolsDictionary::instance,
+      &mainDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+  StenoEngineTester::TestSegmentLookupCache(dictionaryList);
+
+  delete userDictionary;
+  delete[] buffer;
+}
+TEST_END
+
 TEST_BEGIN("Engine: Add Translation Test") {
   StenoEngineTester tester;
   uint8_t *buffer = new uint8_t[512 * 1024];
   StenoUserDictionaryData layout(buffer, 512 * 1024);
   StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+  userDictionary->Reset();
 
   static StenoDictionary *dictionaries[] = {
       userDictionary,
@@ -374,11 +637,96 @@ TEST_BEGIN("Engine: Add Translation Test") {
 }
 TEST_END
 
+void StenoEngineTester::TestSuggestionCache(
+    StenoEngine &engine, StenoUserDictionary &userDictionary) {
+  char *uncachedData = nullptr;
+  userDictionary.Reset();
+  assert(Str::Eq(engine.GetSuggestionOutlines("cat", 8, uncachedData), ""));
+
+  // spellchecker: disable
+  const StenoStroke KAT[] = {StenoStroke("KAT")};
+  // spellchecker: enable
+  userDictionary.Add(KAT, 1, "cat");
+
+  // Dictionary changes invalidate cached results.
+  const char *outlines = engine.GetSuggestionOutlines("cat", 8, uncachedData);
+  assert(Str::Eq(outlines, "\"KAT\""));
+  const char *catOutlines = outlines;
+  assert(engine.GetSuggestionOutlines("cat", 8, uncachedData) == outlines);
+
+  // Stroke threshold is part of the key.
+  assert(Str::Eq(engine.GetSuggestionOutlines("cat", 1, uncachedData), ""));
+
+  // Results larger than an entry are returned without displacing cached
+  // results.
+  char longText[StenoEngine::SUGGESTION_CACHE_ENTRY_SIZE_LIMIT + 1];
+  memset(longText, 'a', sizeof(longText) - 1);
+  longText[sizeof(longText) - 1] = '\0';
+  outlines = engine.GetSuggestionOutlines(longText, 8, uncachedData);
+  assert(uncachedData != nullptr);
+  assert(Str::Eq(outlines, ""));
+  free(uncachedData);
+  uncachedData = nullptr;
+  assert(engine.GetSuggestionOutlines("cat", 8, uncachedData) == catOutlines);
+}
+
+// Suggestions build their segment lists in the stroke arena, and reset them
+// before looking up the suggestion.
+void StenoEngineTester::TestArenaSuggestions(
+    StenoEngine &engine, StenoUserDictionary &userDictionary) {
+  // spellchecker: disable
+  const StenoStroke KAT[] = {StenoStroke("KAT")};
+  const StenoStroke TKOG[] = {StenoStroke("TKOG")};
+  const StenoStroke KA_O_T[] = {StenoStroke("KA*T")};
+  // spellchecker: enable
+  userDictionary.Reset();
+  userDictionary.Add(KAT, 1, "cat");
+  userDictionary.Add(TKOG, 1, "dog");
+  userDictionary.Add(KA_O_T, 1, "cat dog");
+
+  engine.EnableSuggestions();
+  Console::history.clear();
+  engine.ProcessStroke(KAT[0]);
+  engine.ProcessStroke(TKOG[0]);
+  Console::history.push_back(0);
+  assert(Str::Eq(&Console::history.front(),
+                 "EV {\"event\":\"suggestion\",\"combine_count\":2,"
+                 "\"text\":\"cat dog\",\"outlines\":[\"KA*T\"]}\n\n"));
+  Console::history.clear();
+}
+
+void StenoEngineTester::TestSuggestionBufferOverflow(
+    StenoEngine &engine, StenoUserDictionary &userDictionary) {
+  // spellchecker: disable
+  const StenoStroke KAT[] = {StenoStroke("KAT")};
+  const StenoStroke TKOG[] = {StenoStroke("TKOG")};
+  // spellchecker: enable
+
+  // The suggestion estimate assumes the current single character space,
+  // but each of these spaces expands to 15 key codes.
+  char text[128] = "{:set_space:---------------}";
+  for (size_t i = 0; i < 20; ++i) {
+    strcat(text, " b");
+  }
+  userDictionary.Reset();
+  userDictionary.Add(KAT, 1, text);
+  userDictionary.Add(TKOG, 1, "dog");
+
+  engine.EnableSuggestions();
+  Console::history.clear();
+  engine.ProcessStroke(KAT[0]);
+  engine.ProcessStroke(TKOG[0]);
+  assert(engine.suggestionKeyCodeBuffer.count <=
+         engine.suggestionKeyCodeBuffer.capacity);
+  Console::history.clear();
+}
+
 TEST_BEGIN("Engine: Scancode Add Translation Test") {
   StenoEngineTester tester;
   uint8_t *buffer = new uint8_t[512 * 1024];
   StenoUserDictionaryData layout(buffer, 512 * 1024);
   StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+  userDictionary->Reset();
 
   static StenoDictionary *dictionaries[] = {
       userDictionary,
@@ -397,4 +745,232 @@ TEST_BEGIN("Engine: Scancode Add Translation Test") {
 }
 TEST_END
 
+TEST_BEGIN("Engine: Suggestion cache test") {
+  uint8_t *buffer = new uint8_t[512 * 1024];
+  StenoUserDictionaryData layout(buffer, 512 * 1024);
+  StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+
+  static StenoDictionary *dictionaries[] = {
+      userDictionary,
+      &mainDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine engine(dictionaryList, orthography, userDictionary);
+  StenoEngineTester::TestSuggestionCache(engine, *userDictionary);
+
+  delete userDictionary;
+  delete[] buffer;
+}
+TEST_END
+
+TEST_BEGIN("Engine: Arena suggestions test") {
+  uint8_t *buffer = new uint8_t[512 * 1024];
+  StenoUserDictionaryData layout(buffer, 512 * 1024);
+  StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+
+  static StenoDictionary *dictionaries[] = {
+      userDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine engine(dictionaryList, orthography, userDictionary);
+  StenoEngineTester::TestArenaSuggestions(engine, *userDictionary);
+
+  delete userDictionary;
+  delete[] buffer;
+}
+TEST_END
+
+TEST_BEGIN("Engine: Suggestion buffer overflow test") {
+  uint8_t *buffer = new uint8_t[512 * 1024];
+  StenoUserDictionaryData layout(buffer, 512 * 1024);
+  StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+
+  static StenoDictionary *dictionaries[] = {
+      userDictionary,
+  };
+
+  StenoDictionaryList dictionaryList(
+      dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+  StenoCompiledOrthography orthography(StenoOrthography::emptyOrthography);
+  StenoEngine engine(dictionaryList, orthography, userDictionary);
+  StenoEngineTester::TestSuggestionBufferOverflow(engine, *userDictionary);
+
+  delete userDictionary;
+  delete[] buffer;
+}
+TEST_END
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+#include "benchmark.h"
+#include "dictionary/reverse_auto_suffix_dictionary.h"
+#include "dictionary/reverse_map_dictionary.h"
+#include "dictionary/reverse_prefix_dictionary.h"
+#include "dictionary/reverse_text_block_builder.h"
+#include "dictionary/wrapped_dictionary.h"
+
+// Records the time and number of candidates added by each reverse lookup of
+// the wrapped layer. Times are inclusive of any layers that it wraps.
+class ReverseLookupLayerProfiler final : public StenoWrappedDictionary {
+public:
+  ReverseLookupLayerProfiler(StenoDictionary *dictionary, const char *name)
+      : StenoWrappedDictionary(dictionary),
+        timeSeries(Str::Asprintf("%s time (ns)", name)),
+        candidateSeries(Str::Asprintf("%s candidates", name)) {}
+
+  virtual void ReverseLookup(StenoReverseDictionaryLookup &result) const {
+    const size_t initialResultCount = result.resultCount;
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    dictionary->ReverseLookup(result);
+    Benchmark::AddSample(timeSeries, Benchmark::GetNanoseconds() - startTime);
+    Benchmark::AddSample(candidateSeries,
+                         result.resultCount - initialResultCount);
+  }
+
+  virtual const char *GetName() const { return dictionary->GetName(); }
+
+private:
+  const char *timeSeries;
+  const char *candidateSeries;
+};
+
+// spellchecker: disable
+// Words, multi-word phrases, prefixed and suffixed forms and capitalized
+// variants.
+static const char *const REVERSE_LOOKUP_CORPUS[] = {
+    "test",    "tested",    "testing",  "tests",   "Test",
+    "retest",  "retested",  "untested", "pretest", "Retest",
+    "cat",     "cats",      "Cat",      "dog",     "dogs",
+    "work",    "worked",    "working",  "works",   "Work",
+    "walk",    "walked",    "walking",  "the",     "The",
+    "I",       "I can",     "can I",    "I want",  "I want to",
+    "to go to", "if you go", "I have been going",  "there are",
+    "he would have wanted to",          "I don't know",
+    "untranslatable", "Untranslatable",
+};
+// spellchecker: enable
+
+BENCHMARK_BEGIN("Engine: ProcessStroke heap allocations") {
+  static StenoEngine *engine = nullptr;
+  if (engine == nullptr) {
+    static StenoDictionary *dictionaries[] = {
+        &StenoEmilySymbolsDictionary::instance,
+        &mainDictionary,
+    };
+    StenoDictionaryList *dictionaryList = new StenoDictionaryList(
+        dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+    StenoCompiledOrthography *orthography =
+        new StenoCompiledOrthography(StenoOrthography::emptyOrthography);
+    engine = new StenoEngine(*dictionaryList, *orthography);
+  }
+
+  // Words, a multi-stroke word, suffixes and untranslated strokes.
+  // spellchecker: disable
+  static const StenoStroke STROKES[] = {
+      StenoStroke("TEFT"), StenoStroke("-D"),  StenoStroke("TEFT"),
+      StenoStroke("-G"),   StenoStroke("KAT"), StenoStroke("TEFT"),
+      StenoStroke("TEFT"), StenoStroke("-D"),  StenoStroke("WORBG"),
+  };
+  // spellchecker: enable
+
+  for (const StenoStroke &stroke : STROKES) {
+    Key::history.clear();
+    const size_t startCount = Benchmark::GetHeapAllocationCount();
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    engine->ProcessStroke(stroke);
+    Benchmark::AddSample("time (ns)", Benchmark::GetNanoseconds() - startTime);
+    Benchmark::AddSample("heap allocations",
+                         Benchmark::GetHeapAllocationCount() - startCount);
+  }
+}
+BENCHMARK_END
+
+BENCHMARK_BEGIN("Engine: Reverse lookup layers") {
+  static StenoEngine *engine = nullptr;
+  if (engine == nullptr) {
+    uint8_t *buffer = new uint8_t[512 * 1024];
+    StenoUserDictionaryData layout(buffer, 512 * 1024);
+    StenoUserDictionary *userDictionary = new StenoUserDictionary(layout);
+
+    // spellchecker: disable
+    static const struct {
+      const char *strokes;
+      const char *text;
+    } USER_ENTRIES[] = {
+        {"KAT", "cat"},   {"TKOG", "dog"},   {"WORBG", "work"},
+        {"WAUBG", "walk"}, {"-T", "the"},    {"KWRAEUPL", "I am"},
+    };
+    // spellchecker: enable
+    for (const auto &entry : USER_ENTRIES) {
+      StenoStroke stroke;
+      stroke.Set(entry.strokes);
+      userDictionary->Add(&stroke, 1, entry.text);
+    }
+
+    // The collection is laid out the way the dictionary compiler would,
+    // from the test dictionary. It has no prefix entries, so the prefixes
+    // borrow existing entries.
+    StenoReverseTextBlockBuilder *collection =
+        new StenoReverseTextBlockBuilder;
+    StenoDictionary *collectionDictionary = new StenoCompactMapDictionary(
+        collection->AddDictionary(TestDictionary::definition));
+    collection->Add("{re^}", collection->FindData("test"));
+    collection->Add("{un^}", collection->FindData("{:add_translation}"));
+    collection->Add("{pre^}", collection->FindData("tested"));
+    collection->Build();
+
+    static StenoDictionary *dictionaries[] = {
+        new ReverseLookupLayerProfiler(userDictionary, "user"),
+        new ReverseLookupLayerProfiler(&StenoJeffPhrasingDictionary::instance,
+                                       "jeff-phrasing"),
+        new ReverseLookupLayerProfiler(&StenoJeffNumbersDictionary::instance,
+                                       "jeff-numbers"),
+        new ReverseLookupLayerProfiler(&StenoEmilySymbolsDictionary::instance,
+                                       "emily-symbols"),
+        new ReverseLookupLayerProfiler(collectionDictionary, "main"),
+    };
+
+    StenoDictionaryList *dictionaryList = new StenoDictionaryList(
+        dictionaries, sizeof(dictionaries) / sizeof(*dictionaries)); // NOLINT
+    StenoDictionary *reverseMap = new ReverseLookupLayerProfiler(
+        new StenoReverseMapDictionary(
+            new ReverseLookupLayerProfiler(dictionaryList, "dictionary-list"),
+            collection->GetBaseAddress(), collection->GetTextBlock(),
+            collection->GetTextBlockLength()),
+        "reverse-map");
+    StenoDictionary *reversePrefix = new ReverseLookupLayerProfiler(
+        new StenoReversePrefixDictionary(
+            reverseMap, collection->GetBaseAddress(),
+            collection->GetTextBlock(), collection->GetTextBlockLength(),
+            collection->GetPrefixTable()),
+        "reverse-prefix");
+    StenoCompiledOrthography *orthography =
+        new StenoCompiledOrthography(testOrthography);
+    StenoDictionary *reverseStack = new ReverseLookupLayerProfiler(
+        new StenoReverseAutoSuffixDictionary(reversePrefix, *orthography),
+        "reverse-auto-suffix");
+    engine = new StenoEngine(*reverseStack, *orthography, userDictionary);
+  }
+
+  for (const char *text : REVERSE_LOOKUP_CORPUS) {
+    StenoReverseDictionaryLookup result(8, text);
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    engine->ReverseLookup(result);
+    Benchmark::AddSample("total time (ns)",
+                         Benchmark::GetNanoseconds() - startTime);
+    Benchmark::AddSample("total results", result.resultCount);
+  }
+}
+BENCHMARK_END
+
+#endif
+
 //---------------------------------------------------------------------------
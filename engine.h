@@ -6,6 +6,7 @@
 #include "segment_builder.h"
 #include "steno_key_code_buffer.h"
 #include "steno_key_code_emitter.h"
+#include "stroke_arena.h"
 #include "stroke_history.h"
 
 //---------------------------------------------------------------------------
@@ -14,6 +15,7 @@ class Pattern;
 class StenoDictionary;
 class StenoReverseDictionaryLookup;
 class StenoSegmentList;
+struct StenoTranslationSearch;
 class StenoUserDictionary;
 
 //---------------------------------------------------------------------------
@@ -24,15 +26,24 @@ enum StenoEngineMode { NORMAL, ADD_TRANSLATION };
 
 class StenoEngine final : public StenoProcessorElement {
 public:
+  // The engine keeps a reference to orthography, which must outlive it.
   StenoEngine(StenoDictionary &dictionary,
               const StenoCompiledOrthography &orthography,
               StenoUserDictionary *userDictionary = nullptr);
+  StenoEngine(StenoDictionary &dictionary,
+              const StenoCompiledOrthography &&orthography,
+              StenoUserDictionary *userDictionary = nullptr) = delete;
+  ~StenoEngine();
+
+  // The stroke that ProcessStroke and ProcessStrokes treat as an undo.
+  static const StenoStroke UNDO_STROKE;
 
   size_t GetStrokeCount() const { return strokeCount; }
 
   void Process(const StenoKeyState &value, StenoAction action);
   void ProcessUndo();
   void ProcessStroke(StenoStroke stroke);
+  void ProcessStrokes(const StenoStroke *strokes, size_t count);
   bool ProcessScanCode(uint32_t scanCodeAndModifiers, ScanCodeAction action);
 
   void SendText(const uint8_t *p);
@@ -44,6 +55,7 @@ public:
   bool DisableDictionary(const char *name);
   bool ToggleDictionary(const char *name);
   void ReverseLookup(StenoReverseDictionaryLookup &result) const;
+  void SearchTranslations(StenoTranslationSearch &search) const;
 
   bool IsPaperTapeEnabled() const { return paperTapeEnabled; }
   void EnablePaperTape() { paperTapeEnabled = true; }
@@ -58,7 +70,10 @@ public:
   void DisableTextLog() { textLogEnabled = false; }
 
   bool IsSpaceAfter() const { return placeSpaceAfter; }
-  void SetSpaceAfter(bool spaceAfter) { placeSpaceAfter = spaceAfter; }
+  void SetSpaceAfter(bool spaceAfter) {
+    placeSpaceAfter = spaceAfter;
+    InvalidateCarriedConversion();
+  }
 
   static void SetSpacePosition_Binding(void *context, const char *commandLine);
   static void ListDictionaries_Binding(void *context, const char *commandLine);
@@ -75,12 +90,22 @@ public:
   static void DisableTextLog_Binding(void *context, const char *commandLine);
   static void Lookup_Binding(void *context, const char *commandLine);
   static void LookupStroke_Binding(void *context, const char *commandLine);
+  static void SearchTranslations_Binding(void *context,
+                                         const char *commandLine);
   static void ProcessStrokes_Binding(void *context, const char *commandLine);
+  static void EnableOrthographyProfile_Binding(void *context,
+                                               const char *commandLine);
+  static void DisableOrthographyProfile_Binding(void *context,
+                                                const char *commandLine);
+  static void PrintOrthographyProfile_Binding(void *context,
+                                              const char *commandLine);
 
 private:
-  static const StenoStroke UNDO_STROKE;
   static const size_t SEGMENT_CONVERSION_PREFIX_SUFFIX_LIMIT = 4;
   static const size_t PAPER_TAPE_SUGGESTION_SEGMENT_LIMIT = 8;
+  static const size_t SEARCH_TRANSLATIONS_RESULT_LIMIT = 50;
+  static const size_t SUGGESTION_CACHE_SIZE = 16;
+  static const size_t SUGGESTION_CACHE_ENTRY_SIZE_LIMIT = 256;
 
   bool paperTapeEnabled = false;
   bool suggestionsEnabled = false;
@@ -90,7 +115,7 @@ private:
 
   size_t strokeCount = 0;
   StenoDictionary &dictionary;
-  const StenoCompiledOrthography orthography;
+  const StenoCompiledOrthography &orthography;
   StenoUserDictionary *userDictionary;
 
   StenoState state;
@@ -101,20 +126,78 @@ private:
   StenoStrokeHistory history;
   StenoStrokeHistory addTranslationHistory;
 
+  // The key codes are held in keyCodeBuffers, so that conversions can
+  // exchange them without copying.
   struct ConversionBuffer {
     StenoSegmentBuilder segmentBuilder;
-    StenoKeyCodeBuffer keyCodeBuffer;
+    StenoKeyCodeBuffer *keyCodeBuffer;
 
-    void Prepare(const StenoCompiledOrthography *orthography,
+    void Prepare(StenoKeyCodeBuffer *newKeyCodeBuffer,
+                 const StenoCompiledOrthography *orthography,
                  StenoDictionary *dictionary) {
-      keyCodeBuffer.Prepare(orthography, dictionary);
+      keyCodeBuffer = newKeyCodeBuffer;
+      keyCodeBuffer->Prepare(orthography, dictionary);
+    }
+
+    void SwapKeyCodeBuffer(ConversionBuffer &other) {
+      StenoKeyCodeBuffer *otherKeyCodeBuffer = other.keyCodeBuffer;
+      other.keyCodeBuffer = keyCodeBuffer;
+      keyCodeBuffer = otherKeyCodeBuffer;
     }
   };
 
+  StaticStenoKeyCodeBuffer<> keyCodeBuffers[2];
   ConversionBuffer previousConversionBuffer;
   ConversionBuffer nextConversionBuffer;
 
+  // Suggestions only convert up to PAPER_TAPE_SUGGESTION_SEGMENT_LIMIT
+  // segments, so use a smaller buffer of their own.
+  static const size_t SUGGESTION_KEY_CODE_BUFFER_SIZE = 256;
+  StaticStenoKeyCodeBuffer<SUGGESTION_KEY_CODE_BUFFER_SIZE, 0>
+      suggestionKeyCodeBuffer;
+
+  // Segments and lookups made while processing a stroke. Declared before
+  // the conversions that may use it, so that it is destroyed after them.
+  StrokeArena strokeArena;
+
+  // A stroke's next conversion is what is on screen afterwards, so it is
+  // carried forward as the following stroke's previous conversion rather
+  // than being rebuilt. nextConversionBuffer holds its segment builder and
+  // key codes until then.
+  struct CarriedConversion {
+    bool isValid = false;
+    size_t sourceStrokeCount; // History count when carried.
+    size_t startingStroke;    // History index of the first segment.
+    StenoSegmentList segmentList;
+  };
+  CarriedConversion carriedConversion;
+  size_t carriedConversionCount = 0;
+  size_t resumedSegmentCount = 0; // Segments converted by carried strokes.
+
+  // Dictionary lookups made by normal mode segmentation, which are mostly
+  // repeated from one stroke to the next.
+  StenoSegmentLookupCache segmentLookupCache;
+
+  // Reverse lookups of recent suggestions. Successive strokes request many
+  // of the same phrases, and each lookup is a full reverse stack traversal.
+  //
+  // Each entry is a single heap allocation holding the lookup text and the
+  // JSON list contents, both null terminated. Results that do not fit in
+  // SUGGESTION_CACHE_ENTRY_SIZE_LIMIT bytes are not cached, so the cache
+  // never holds more than 4kb.
+  struct SuggestionCacheEntry {
+    size_t strokeThreshold;
+    char *data;
+
+    const char *GetText() const { return data; }
+    const char *GetOutlines() const;
+  };
+  SuggestionCacheEntry suggestionCache[SUGGESTION_CACHE_SIZE] = {};
+  size_t suggestionCacheNextIndex = 0;
+  uint32_t suggestionCacheGeneration = 0;
+
   struct UpdateNormalModeTextBufferThreadData;
+  struct PrintNormalModeEventsThreadData;
 
   void ProcessNormalModeUndo();
   void ProcessNormalModeStroke(StenoStroke stroke);
@@ -139,6 +222,17 @@ private:
       const StenoSegmentList &longerSegmentList);
   void ConvertText(ConversionBuffer &buffer, StenoSegmentList &segmentList,
                    size_t startingOffset);
+  void ResumeConversion(ConversionBuffer &buffer,
+                        const ConversionBuffer &source,
+                        StenoSegmentList &segmentList, size_t resumeOffset);
+  void AppendSpaceAfter(ConversionBuffer &buffer,
+                        const StenoSegmentList &segmentList);
+
+  void CarryConversion(size_t startingStroke, StenoSegmentList &segmentList);
+  bool UseCarriedConversion(size_t prunedStrokeCount, size_t startingStroke,
+                            StenoSegmentList &segmentList,
+                            size_t &startingOffset);
+  void InvalidateCarriedConversion();
 
   void PrintPaperTape(StenoStroke stroke,
                       const StenoSegmentList &previousSegmentList,
@@ -147,7 +241,10 @@ private:
   void PrintSuggestions(const StenoSegmentList &previousSegmentList,
                         const StenoSegmentList &nextSegmentList);
   void PrintSuggestion(const char *p, size_t arrowPrefixCount,
-                       size_t strokeThreshold) const;
+                       size_t strokeThreshold);
+  const char *GetSuggestionOutlines(const char *text, size_t strokeThreshold,
+                                    char *&uncachedData);
+  void ClearSuggestionCache();
   char *PrintSegmentSuggestion(size_t wordCount,
                                const StenoSegmentList &segmentList,
                                char *lastLookup);
@@ -19,15 +19,16 @@ static const char TRANSLATION_PROMPT[] = "; Translation: ";
 
 void StenoEngine::InitiateAddTranslationMode() {
   mode = StenoEngineMode::ADD_TRANSLATION;
+  InvalidateCarriedConversion();
 
   addTranslationHistory.Reset();
   addTranslationState = state;
   addTranslationState.joinNext = true;
 
-  previousConversionBuffer.keyCodeBuffer.Reset();
+  previousConversionBuffer.keyCodeBuffer->Reset();
   UpdateAddTranslationModeTextBuffer(nextConversionBuffer);
-  emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                  nextConversionBuffer.keyCodeBuffer);
+  emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                  *nextConversionBuffer.keyCodeBuffer);
 }
 
 void StenoEngine::ProcessAddTranslationModeStroke(StenoStroke stroke) {
@@ -78,10 +79,10 @@ void StenoEngine::ProcessAddTranslationModeStroke(StenoStroke stroke) {
   addTranslationHistory.Add(stroke, addTranslationState);
 
   UpdateAddTranslationModeTextBuffer(nextConversionBuffer);
-  addTranslationState = nextConversionBuffer.keyCodeBuffer.state;
+  addTranslationState = nextConversionBuffer.keyCodeBuffer->state;
 
-  if (emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                      nextConversionBuffer.keyCodeBuffer)) {
+  if (emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                      *nextConversionBuffer.keyCodeBuffer)) {
     addTranslationHistory.SetBackCombineUndo();
   }
 }
@@ -102,16 +103,16 @@ void StenoEngine::ProcessAddTranslationModeUndo() {
 
   UpdateAddTranslationModeTextBuffer(nextConversionBuffer);
 
-  emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                  nextConversionBuffer.keyCodeBuffer);
+  emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                  *nextConversionBuffer.keyCodeBuffer);
 }
 
 size_t
 StenoEngine::UpdateAddTranslationModeTextBuffer(ConversionBuffer &buffer) {
-  buffer.keyCodeBuffer.Reset();
-  buffer.keyCodeBuffer.AppendText(ADD_TRANSLATION_PROMPT,
-                                  Str::Length<>(ADD_TRANSLATION_PROMPT),
-                                  StenoCaseMode::NORMAL);
+  buffer.keyCodeBuffer->Reset();
+  buffer.keyCodeBuffer->AppendText(ADD_TRANSLATION_PROMPT,
+                                   Str::Length<>(ADD_TRANSLATION_PROMPT),
+                                   StenoCaseMode::NORMAL);
 
   size_t i = 0;
   for (;;) {
@@ -124,18 +125,18 @@ StenoEngine::UpdateAddTranslationModeTextBuffer(ConversionBuffer &buffer) {
     }
 
     if (i != 1) {
-      buffer.keyCodeBuffer.AppendText("/", 1, StenoCaseMode::NORMAL);
+      buffer.keyCodeBuffer->AppendText("/", 1, StenoCaseMode::NORMAL);
     }
 
     char strokeBuffer[StenoStroke::MAX_STRING_LENGTH];
     char *p = stroke.ToString(strokeBuffer);
-    buffer.keyCodeBuffer.AppendText(strokeBuffer, p - strokeBuffer,
-                                    StenoCaseMode::NORMAL);
+    buffer.keyCodeBuffer->AppendText(strokeBuffer, p - strokeBuffer,
+                                     StenoCaseMode::NORMAL);
   }
 
-  buffer.keyCodeBuffer.AppendText(TRANSLATION_PROMPT,
-                                  Str::Length<>(TRANSLATION_PROMPT),
-                                  StenoCaseMode::NORMAL);
+  buffer.keyCodeBuffer->AppendText(TRANSLATION_PROMPT,
+                                   Str::Length<>(TRANSLATION_PROMPT),
+                                   StenoCaseMode::NORMAL);
 
   StenoSegmentList segmentList;
   BuildSegmentContext context(segmentList, dictionary, orthography);
@@ -146,21 +147,20 @@ StenoEngine::UpdateAddTranslationModeTextBuffer(ConversionBuffer &buffer) {
   buffer.segmentBuilder.CreateSegments(context, i);
   addTranslationHistory.UpdateDefinitionBoundaries(i, segmentList);
 
-  StenoTokenizer *tokenizer = segmentList.CreateTokenizer();
-  buffer.keyCodeBuffer.Append(tokenizer);
-  delete tokenizer;
-  if (placeSpaceAfter && !buffer.keyCodeBuffer.state.joinNext &&
+  StenoSegmentListTokenizer tokenizer(segmentList);
+  buffer.keyCodeBuffer->Append(tokenizer);
+  if (placeSpaceAfter && !buffer.keyCodeBuffer->state.joinNext &&
       buffer.segmentBuilder.IsNotEmpty()) {
-    buffer.keyCodeBuffer.AppendSpace();
+    buffer.keyCodeBuffer->AppendSpace();
   }
   return i + segmentList.GetCount();
 }
 
 void StenoEngine::EndAddTranslationMode() {
   UpdateAddTranslationModeTextBuffer(previousConversionBuffer);
-  nextConversionBuffer.keyCodeBuffer.Reset();
-  emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                  nextConversionBuffer.keyCodeBuffer);
+  nextConversionBuffer.keyCodeBuffer->Reset();
+  emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                  *nextConversionBuffer.keyCodeBuffer);
 
   mode = StenoEngineMode::NORMAL;
 }
@@ -170,7 +170,7 @@ void StenoEngine::AddTranslation(size_t newlineIndex) {
     return;
   }
 
-  nextConversionBuffer.keyCodeBuffer.Reset();
+  nextConversionBuffer.keyCodeBuffer->Reset();
 
   StenoSegmentList segmentList;
   BuildSegmentContext context(segmentList, dictionary, orthography);
@@ -180,11 +180,10 @@ void StenoEngine::AddTranslation(size_t newlineIndex) {
       StenoSegmentBuilder::BUFFER_SIZE);
   nextConversionBuffer.segmentBuilder.CreateSegments(context, newlineIndex + 1);
 
-  StenoTokenizer *tokenizer = segmentList.CreateTokenizer();
-  nextConversionBuffer.keyCodeBuffer.Append(tokenizer);
-  delete tokenizer;
+  StenoSegmentListTokenizer tokenizer(segmentList);
+  nextConversionBuffer.keyCodeBuffer->Append(tokenizer);
 
-  char *word = nextConversionBuffer.keyCodeBuffer.ToString();
+  char *word = nextConversionBuffer.keyCodeBuffer->ToString();
   StenoStroke strokes[newlineIndex];
   for (size_t i = 0; i < newlineIndex; ++i) {
     strokes[i] = addTranslationHistory[i].stroke;
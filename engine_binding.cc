@@ -201,6 +201,54 @@ void StenoEngine::LookupStroke_Binding(void *context, const char *commandLine) {
   }
 }
 
+struct SearchTranslationsContext {
+  const StenoEngine *engine;
+  size_t resultCount;
+};
+
+static void PrintSearchTranslationsResult(void *context, const char *text) {
+  SearchTranslationsContext *searchContext =
+      (SearchTranslationsContext *)context;
+
+  StenoReverseDictionaryLookup result(
+      StenoReverseDictionaryLookup::MAX_STROKE_THRESHOLD, text);
+  searchContext->engine->ReverseLookup(result);
+
+  Console::Printf(searchContext->resultCount++ == 0
+                      ? "\n  {\"text\": \"%J\", \"outlines\": ["
+                      : ",\n  {\"text\": \"%J\", \"outlines\": [",
+                  text);
+  for (size_t i = 0; i < result.resultCount; ++i) {
+    const StenoReverseDictionaryResult &lookup = result.results[i];
+    Console::Printf(i == 0 ? "\"%T\"" : ", \"%T\"", lookup.strokes,
+                    lookup.length);
+  }
+  Console::Printf("]}");
+}
+
+void StenoEngine::SearchTranslations_Binding(void *context,
+                                             const char *commandLine) {
+  const char *fragment = strchr(commandLine, ' ');
+  if (fragment == nullptr || fragment[1] == '\0') {
+    Console::Printf("ERR Unable to search for empty fragment\n\n");
+    return;
+  }
+
+  ++fragment;
+  SearchTranslationsContext searchContext = {
+      .engine = (const StenoEngine *)context,
+      .resultCount = 0,
+  };
+  StenoTranslationSearch search(fragment, SEARCH_TRANSLATIONS_RESULT_LIMIT,
+                                PrintSearchTranslationsResult,
+                                &searchContext);
+
+  // Results are printed as they are found.
+  Console::Printf("[");
+  searchContext.engine->SearchTranslations(search);
+  Console::Printf("\n]\n\n");
+}
+
 void StenoEngine::ProcessStrokes_Binding(void *context,
                                          const char *commandLine) {
   const char *strokeStart = strchr(commandLine, ' ');
@@ -219,10 +267,28 @@ void StenoEngine::ProcessStrokes_Binding(void *context,
 
   ConsoleWriter::Push(&ConsoleWriter::instance);
   StenoEngine *engine = (StenoEngine *)context;
-  for (size_t i = 0; i < parser.length; ++i) {
-    engine->ProcessStroke(parser.strokes[i]);
-  }
+  engine->ProcessStrokes(parser.strokes, parser.length);
   ConsoleWriter::Pop();
 }
 
+void StenoEngine::EnableOrthographyProfile_Binding(void *context,
+                                                   const char *commandLine) {
+  StenoEngine *engine = (StenoEngine *)context;
+  engine->orthography.EnableProfile();
+  Console::SendOk();
+}
+
+void StenoEngine::DisableOrthographyProfile_Binding(void *context,
+                                                    const char *commandLine) {
+  StenoEngine *engine = (StenoEngine *)context;
+  engine->orthography.DisableProfile();
+  Console::SendOk();
+}
+
+void StenoEngine::PrintOrthographyProfile_Binding(void *context,
+                                                  const char *commandLine) {
+  StenoEngine *engine = (StenoEngine *)context;
+  engine->orthography.PrintProfile();
+}
+
 //---------------------------------------------------------------------------
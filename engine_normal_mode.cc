@@ -9,6 +9,7 @@
 #include "str.h"
 #include "thread.h"
 #include "utf8_pointer.h"
+#include "writer.h"
 
 //---------------------------------------------------------------------------
 
@@ -40,9 +41,41 @@ struct StenoEngine::UpdateNormalModeTextBufferThreadData {
   }
 };
 
+// The text log and paper tape are written by the worker thread once key codes
+// have been emitted. Suggestions call Pump(), so they are printed on the
+// engine thread after them.
+struct StenoEngine::PrintNormalModeEventsThreadData {
+  PrintNormalModeEventsThreadData(StenoEngine *engine, StenoStroke stroke,
+                                  const StenoSegmentList *previousSegmentList,
+                                  const StenoSegmentList *nextSegmentList)
+      : engine(engine), stroke(stroke),
+        previousSegmentList(previousSegmentList),
+        nextSegmentList(nextSegmentList) {}
+
+  StenoEngine *engine;
+  StenoStroke stroke;
+  const StenoSegmentList *previousSegmentList;
+  const StenoSegmentList *nextSegmentList;
+
+  static void PrintTextLogEntryPoint(void *data) {
+    StenoEngine *engine = ((PrintNormalModeEventsThreadData *)data)->engine;
+    engine->PrintTextLog(*engine->previousConversionBuffer.keyCodeBuffer,
+                         *engine->nextConversionBuffer.keyCodeBuffer);
+  }
+
+  static void PrintPaperTapeEntryPoint(void *data) {
+    PrintNormalModeEventsThreadData *threadData =
+        (PrintNormalModeEventsThreadData *)data;
+    threadData->engine->PrintPaperTape(threadData->stroke,
+                                       *threadData->previousSegmentList,
+                                       *threadData->nextSegmentList);
+  }
+};
+
 #endif
 
 void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
+  const size_t unprunedStrokeCount = history.GetCount();
   history.PruneIfFull();
 
   size_t previousSourceStrokeCount = history.GetCount();
@@ -57,6 +90,14 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
   size_t startingStroke = history.GetStartingStroke(maximumConversionStrokes);
   size_t conversionCount = history.GetCount() - startingStroke;
 
+  // The carried conversion is in nextConversionBuffer, so has to be moved
+  // before it is reused.
+  StenoSegmentList previousSegmentList;
+  size_t carriedOffset;
+  bool isCarried = UseCarriedConversion(
+      unprunedStrokeCount - previousSourceStrokeCount, startingStroke,
+      previousSegmentList, carriedOffset);
+
   StenoSegmentList nextSegmentList;
   CreateSegments(history.GetCount(), nextConversionBuffer, conversionCount,
                  nextSegmentList);
@@ -67,11 +108,12 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
   uint32_t t1 = Clock::GetMicroseconds();
 #endif
 
-  StenoSegmentList previousSegmentList;
   if (nextConversionBuffer.segmentBuilder.HasModifiedStrokeHistory()) {
+    previousSegmentList.Clear();
+    isCarried = false;
     CreateSegments(previousSourceStrokeCount, previousConversionBuffer,
                    conversionCount - 1, previousSegmentList);
-  } else {
+  } else if (!isCarried) {
     CreateSegmentsUsingLongerResult(previousSourceStrokeCount,
                                     previousConversionBuffer,
                                     conversionCount - 1, previousSegmentList,
@@ -92,31 +134,40 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
   uint32_t t3 = Clock::GetMicroseconds();
 #endif
 
+  if (isCarried && carriedOffset <= startingOffset) {
+    // previousConversionBuffer has the carried text from carriedOffset, and
+    // segments before startingOffset are the same in both lists, so only the
+    // segments after them are converted again.
+    ++carriedConversionCount;
+    ResumeConversion(nextConversionBuffer, previousConversionBuffer,
+                     nextSegmentList, startingOffset);
+  } else {
 #if JAVELIN_THREADS
-  UpdateNormalModeTextBufferThreadData previousThreadData(
-      this, &previousConversionBuffer, &previousSegmentList, startingOffset);
-  UpdateNormalModeTextBufferThreadData nextThreadData(
-      this, &nextConversionBuffer, &nextSegmentList, startingOffset);
-
-  RunParallel(&UpdateNormalModeTextBufferThreadData::ConvertTextEntryPoint,
-              &previousThreadData,
-              &UpdateNormalModeTextBufferThreadData::ConvertTextEntryPoint,
-              &nextThreadData);
+    UpdateNormalModeTextBufferThreadData previousThreadData(
+        this, &previousConversionBuffer, &previousSegmentList, startingOffset);
+    UpdateNormalModeTextBufferThreadData nextThreadData(
+        this, &nextConversionBuffer, &nextSegmentList, startingOffset);
+
+    RunParallel(&UpdateNormalModeTextBufferThreadData::ConvertTextEntryPoint,
+                &previousThreadData,
+                &UpdateNormalModeTextBufferThreadData::ConvertTextEntryPoint,
+                &nextThreadData);
 #else
-  ConvertText(previousConversionBuffer, previousSegmentList, startingOffset);
-  ConvertText(nextConversionBuffer, nextSegmentList, startingOffset);
+    ConvertText(previousConversionBuffer, previousSegmentList, startingOffset);
+    ConvertText(nextConversionBuffer, nextSegmentList, startingOffset);
 #endif
+  }
 
 #if ENABLE_PROFILE
   uint32_t t4 = Clock::GetMicroseconds();
 #endif
 
-  state = nextConversionBuffer.keyCodeBuffer.state;
+  state = nextConversionBuffer.keyCodeBuffer->state;
   state.shouldCombineUndo = false;
   state.isManualStateChange = false;
 
-  if (nextConversionBuffer.keyCodeBuffer.addTranslationCount >
-      previousConversionBuffer.keyCodeBuffer.addTranslationCount) {
+  if (nextConversionBuffer.keyCodeBuffer->addTranslationCount >
+      previousConversionBuffer.keyCodeBuffer->addTranslationCount) {
     PrintPaperTape(stroke, previousSegmentList, nextSegmentList);
 
     history.RemoveBack();
@@ -129,12 +180,12 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
 #endif
 
   bool printSuggestions = true;
-  if (emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                      nextConversionBuffer.keyCodeBuffer)) {
+  if (emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                      *nextConversionBuffer.keyCodeBuffer)) {
     history.SetBackCombineUndo();
 
-    if (previousConversionBuffer.keyCodeBuffer.count ==
-        nextConversionBuffer.keyCodeBuffer.count) {
+    if (previousConversionBuffer.keyCodeBuffer->count ==
+        nextConversionBuffer.keyCodeBuffer->count) {
       history.SetBackHasManualStateChange();
       if (state.caseMode != StenoCaseMode::NORMAL ||
           state.overrideCaseMode != StenoCaseMode::NORMAL) {
@@ -152,15 +203,31 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
   uint32_t t6 = Clock::GetMicroseconds();
 #endif
 
-  PrintTextLog(previousConversionBuffer.keyCodeBuffer,
-               nextConversionBuffer.keyCodeBuffer);
+#if JAVELIN_THREADS
+  PrintNormalModeEventsThreadData eventsThreadData(
+      this, stroke, &previousSegmentList, &nextSegmentList);
+  if (IsTextLogEnabled()) {
+    QueueTask(&PrintNormalModeEventsThreadData::PrintTextLogEntryPoint,
+              &eventsThreadData);
+  }
+  if (IsPaperTapeEnabled()) {
+    QueueTask(&PrintNormalModeEventsThreadData::PrintPaperTapeEntryPoint,
+              &eventsThreadData);
+  }
+  WaitForQueuedTasks();
+#else
+  PrintTextLog(*previousConversionBuffer.keyCodeBuffer,
+               *nextConversionBuffer.keyCodeBuffer);
   PrintPaperTape(stroke, previousSegmentList, nextSegmentList);
+#endif
   if (printSuggestions) {
     PrintSuggestions(previousSegmentList, nextSegmentList);
   }
 
-  if (nextConversionBuffer.keyCodeBuffer.resetStateCount >
-      previousConversionBuffer.keyCodeBuffer.resetStateCount) {
+  CarryConversion(history.GetCount() - conversionCount, nextSegmentList);
+
+  if (nextConversionBuffer.keyCodeBuffer->resetStateCount >
+      previousConversionBuffer.keyCodeBuffer->resetStateCount) {
     ResetState();
     return;
   }
@@ -174,6 +241,8 @@ void StenoEngine::ProcessNormalModeStroke(StenoStroke stroke) {
 }
 
 void StenoEngine::ProcessNormalModeUndo() {
+  InvalidateCarriedConversion();
+
   size_t maximumConversionStrokes = dictionary.GetMaximumOutlineLength() +
                                     SEGMENT_CONVERSION_PREFIX_SUFFIX_LIMIT;
 
@@ -235,11 +304,11 @@ void StenoEngine::ProcessNormalModeUndo() {
   ConvertText(nextConversionBuffer, nextSegmentList, startingOffset);
 #endif
 
-  emitter.Process(previousConversionBuffer.keyCodeBuffer,
-                  nextConversionBuffer.keyCodeBuffer);
+  emitter.Process(*previousConversionBuffer.keyCodeBuffer,
+                  *nextConversionBuffer.keyCodeBuffer);
 
-  PrintTextLog(previousConversionBuffer.keyCodeBuffer,
-               nextConversionBuffer.keyCodeBuffer);
+  PrintTextLog(*previousConversionBuffer.keyCodeBuffer,
+               *nextConversionBuffer.keyCodeBuffer);
   PrintPaperTapeUndo(undoCount);
 }
 
@@ -250,6 +319,7 @@ void StenoEngine::CreateSegments(size_t sourceStrokeCount,
   buffer.segmentBuilder.TransferFrom(history, sourceStrokeCount,
                                      conversionLimit);
   BuildSegmentContext context(segmentList, dictionary, orthography);
+  context.lookupCache = &segmentLookupCache;
   buffer.segmentBuilder.CreateSegments(context);
 }
 
@@ -287,19 +357,109 @@ void StenoEngine::CreateSegmentsUsingLongerResult(
   buffer.segmentBuilder.TransferStartFrom(longerBuffer.segmentBuilder,
                                           startingOffset);
   BuildSegmentContext context(segmentList, dictionary, orthography);
+  context.lookupCache = &segmentLookupCache;
   buffer.segmentBuilder.CreateSegments(context, startingOffset);
 }
 
+void StenoEngine::CarryConversion(size_t startingStroke,
+                                  StenoSegmentList &segmentList) {
+  carriedConversion.segmentList.Clear();
+  if (nextConversionBuffer.segmentBuilder.HasModifiedStrokeHistory()) {
+    carriedConversion.isValid = false;
+    return;
+  }
+
+  carriedConversion.isValid = true;
+  carriedConversion.sourceStrokeCount = history.GetCount();
+  carriedConversion.startingStroke = startingStroke;
+  carriedConversion.segmentList.Swap(segmentList);
+}
+
+// Moves the carried conversion to previousConversionBuffer and segmentList,
+// dropping segments that have left the conversion window. The carried key
+// codes are moved by swapping buffers rather than copying. prunedStrokeCount
+// is how many strokes were pruned from the front of history since the
+// conversion was carried. Returns false if there is no carried conversion
+// for the current history.
+bool StenoEngine::UseCarriedConversion(size_t prunedStrokeCount,
+                                       size_t startingStroke,
+                                       StenoSegmentList &segmentList,
+                                       size_t &startingOffset) {
+  CarriedConversion &carried = carriedConversion;
+  if (!carried.isValid ||
+      carried.sourceStrokeCount != history.GetCount() + prunedStrokeCount - 1 ||
+      startingStroke + prunedStrokeCount < carried.startingStroke) {
+    InvalidateCarriedConversion();
+    return false;
+  }
+
+  // The window can only move by whole segments, and only if the key codes of
+  // the segments that are kept do not depend on those dropped.
+  const size_t droppedStrokeCount =
+      startingStroke + prunedStrokeCount - carried.startingStroke;
+  size_t droppedSegmentCount = 0;
+  size_t strokeCount = 0;
+  while (strokeCount < droppedStrokeCount &&
+         droppedSegmentCount < carried.segmentList.GetCount()) {
+    strokeCount += carried.segmentList[droppedSegmentCount++].strokeLength;
+  }
+  StenoKeyCodeBuffer &keyCodeBuffer = *nextConversionBuffer.keyCodeBuffer;
+  if (strokeCount != droppedStrokeCount ||
+      !keyCodeBuffer.RemoveFrontSegments(droppedSegmentCount)) {
+    InvalidateCarriedConversion();
+    return false;
+  }
+
+  for (size_t i = 0; i < droppedSegmentCount; ++i) {
+    carried.segmentList[i].lookup.Destroy();
+  }
+  carried.segmentList.RemoveFront(droppedSegmentCount);
+
+  const StenoSegmentBuilder &source = nextConversionBuffer.segmentBuilder;
+  StenoSegmentBuilder &destination = previousConversionBuffer.segmentBuilder;
+  destination.TransferEndFrom(source, droppedStrokeCount);
+  for (StenoSegment &segment : carried.segmentList) {
+    segment.state = destination.GetStatePointer(
+        source.GetStateIndex(segment.state) - droppedStrokeCount);
+  }
+  previousConversionBuffer.SwapKeyCodeBuffer(nextConversionBuffer);
+
+  segmentList.Swap(carried.segmentList);
+  startingOffset = keyCodeBuffer.GetStartingOffset();
+  carried.isValid = false;
+  return true;
+}
+
+void StenoEngine::InvalidateCarriedConversion() {
+  carriedConversion.isValid = false;
+  carriedConversion.segmentList.Clear();
+}
+
 void StenoEngine::ConvertText(ConversionBuffer &buffer,
                               StenoSegmentList &segmentList,
                               size_t startingOffset) {
-  StenoTokenizer *tokenizer = segmentList.CreateTokenizer(startingOffset);
-  buffer.keyCodeBuffer.Populate(tokenizer);
-  if (placeSpaceAfter && !buffer.keyCodeBuffer.state.joinNext &&
+  buffer.keyCodeBuffer->Populate(segmentList, startingOffset);
+  AppendSpaceAfter(buffer, segmentList);
+}
+
+// source holds the carried conversion, which matches segmentList up to
+// resumeOffset.
+void StenoEngine::ResumeConversion(ConversionBuffer &buffer,
+                                   const ConversionBuffer &source,
+                                   StenoSegmentList &segmentList,
+                                   size_t resumeOffset) {
+  const size_t resumedOffset = buffer.keyCodeBuffer->Resume(
+      *source.keyCodeBuffer, segmentList, resumeOffset);
+  resumedSegmentCount += segmentList.GetCount() - resumedOffset;
+  AppendSpaceAfter(buffer, segmentList);
+}
+
+void StenoEngine::AppendSpaceAfter(ConversionBuffer &buffer,
+                                   const StenoSegmentList &segmentList) {
+  if (placeSpaceAfter && !buffer.keyCodeBuffer->state.joinNext &&
       segmentList.IsNotEmpty()) {
-    buffer.keyCodeBuffer.AppendSpace();
+    buffer.keyCodeBuffer->AppendSpace();
   }
-  delete tokenizer;
 }
 
 //---------------------------------------------------------------------------
@@ -340,25 +500,18 @@ void StenoEngine::PrintPaperTape(
     Console::Printf(",\"undo\":%zu", undoCount);
   }
 
-  StenoSegmentList newSegments;
-  for (size_t i = commonIndex; i < nextSegmentList.GetCount(); ++i) {
-    newSegments.Add(nextSegmentList[i]);
-  }
-
   Console::Printf(",\"text\":\"");
-  StenoTokenizer *tokenizer = newSegments.CreateTokenizer();
+  StenoSegmentListTokenizer tokenizer(nextSegmentList, commonIndex);
   bool isFirstToken = true;
-  while (tokenizer->HasMore()) {
+  while (tokenizer.HasMore()) {
     if (isFirstToken) {
       isFirstToken = false;
     } else {
       Console::Printf(" ");
     }
-    Console::WriteAsJson(tokenizer->GetNext().text, buffer);
+    Console::WriteAsJson(tokenizer.GetNext().text, buffer);
   }
-  delete tokenizer;
 
-  newSegments.Reset();
   Console::Printf("\"}\n\n");
 }
 
@@ -381,14 +534,14 @@ void StenoEngine::PrintSuggestions(const StenoSegmentList &previousSegmentList,
     *p = '\0';
     const StenoKeyCode *skc =
         &nextConversionBuffer.keyCodeBuffer
-             .buffer[nextConversionBuffer.keyCodeBuffer.count - 1];
+             ->buffer[nextConversionBuffer.keyCodeBuffer->count - 1];
 
-    if (placeSpaceAfter && skc > nextConversionBuffer.keyCodeBuffer.buffer) {
+    if (placeSpaceAfter && skc > nextConversionBuffer.keyCodeBuffer->buffer) {
       skc--;
     }
 
     size_t keyCodeCount = 0;
-    while (skc >= nextConversionBuffer.keyCodeBuffer.buffer &&
+    while (skc >= nextConversionBuffer.keyCodeBuffer->buffer &&
            !skc->IsWhitespace() && !skc->IsRawKeyCode()) {
       uint32_t unicode = skc->GetUnicode();
       size_t length = Utf8Pointer::BytesForCharacterCode(unicode);
@@ -420,25 +573,96 @@ void StenoEngine::PrintSuggestions(const StenoSegmentList &previousSegmentList,
 }
 
 void StenoEngine::PrintSuggestion(const char *p, size_t arrowPrefixCount,
-                                  size_t strokeThreshold) const {
-  StenoReverseDictionaryLookup result(strokeThreshold, p);
-  ReverseLookup(result);
-  if (result.resultCount == 0) {
-    return;
-  }
+                                  size_t strokeThreshold) {
+  char *uncachedData = nullptr;
+  const char *outlines =
+      GetSuggestionOutlines(p, strokeThreshold, uncachedData);
+  if (*outlines != '\0') {
+    Console::Printf("EV {"
+                    "\"event\":\"suggestion\","
+                    "\"combine_count\":%zu,"
+                    "\"text\":\"%J\","
+                    "\"outlines\":[%s]}\n\n",
+                    arrowPrefixCount, p, outlines);
+  }
+  free(uncachedData);
+}
 
-  Console::Printf("EV {"
-                  "\"event\":\"suggestion\","
-                  "\"combine_count\":%zu,"
-                  "\"text\":\"%J\","
-                  "\"outlines\":[",
-                  arrowPrefixCount, p);
+const char *StenoEngine::SuggestionCacheEntry::GetOutlines() const {
+  return data + strlen(data) + 1;
+}
+
+// Writes each result as a quoted outline, separated by commas.
+static void
+WriteSuggestionOutlines(IWriter &writer,
+                        const StenoReverseDictionaryLookup &result) {
+  char scratch[StenoStroke::MAX_STRING_LENGTH + 1];
   for (size_t i = 0; i < result.resultCount; ++i) {
     const StenoReverseDictionaryResult &lookup = result.results[i];
-    Console::Printf(i == 0 ? "\"%T\"" : ",\"%T\"", lookup.strokes,
-                    lookup.length);
+    if (i != 0) {
+      writer.WriteByte(',');
+    }
+    writer.WriteByte('"');
+    for (size_t j = 0; j < lookup.length; ++j) {
+      char *p = scratch;
+      if (j != 0) {
+        *p++ = '/';
+      }
+      p = lookup.strokes[j].ToString(p);
+      writer.Write(scratch, p - scratch);
+    }
+    writer.WriteByte('"');
+  }
+}
+
+// Returns the JSON list contents of the suggestion outlines for text, which
+// is empty when there are no results. Results that are too large to cache
+// are returned in uncachedData, which the caller frees.
+const char *StenoEngine::GetSuggestionOutlines(const char *text,
+                                               size_t strokeThreshold,
+                                               char *&uncachedData) {
+  const uint32_t contentGeneration = StenoDictionary::GetContentGeneration();
+  if (suggestionCacheGeneration != contentGeneration) {
+    ClearSuggestionCache();
+    suggestionCacheGeneration = contentGeneration;
+  }
+
+  for (const SuggestionCacheEntry &entry : suggestionCache) {
+    if (entry.data != nullptr && entry.strokeThreshold == strokeThreshold &&
+        Str::Eq(entry.GetText(), text)) {
+      return entry.GetOutlines();
+    }
+  }
+
+  StenoReverseDictionaryLookup result(strokeThreshold, text);
+  ReverseLookup(result);
+
+  const size_t textSize = strlen(text) + 1;
+  BufferWriter writer;
+  writer.Write(text, textSize);
+  WriteSuggestionOutlines(writer, result);
+  writer.WriteByte('\0');
+
+  if (writer.GetCount() > SUGGESTION_CACHE_ENTRY_SIZE_LIMIT) {
+    uncachedData = writer.AdoptBuffer();
+    return uncachedData + textSize;
+  }
+
+  SuggestionCacheEntry &entry = suggestionCache[suggestionCacheNextIndex];
+  suggestionCacheNextIndex =
+      (suggestionCacheNextIndex + 1) % SUGGESTION_CACHE_SIZE;
+  free(entry.data);
+  entry.strokeThreshold = strokeThreshold;
+  entry.data = writer.AdoptBuffer();
+
+  return entry.data + textSize;
+}
+
+void StenoEngine::ClearSuggestionCache() {
+  for (SuggestionCacheEntry &entry : suggestionCache) {
+    free(entry.data);
+    entry.data = nullptr;
   }
-  Console::Printf("]}\n\n");
 }
 
 static bool ShouldShowSuggestions(const StenoSegmentList &segmentList) {
@@ -496,14 +720,30 @@ char *StenoEngine::PrintSegmentSuggestion(size_t wordCount,
   StenoSegmentList testSegments;
 
   size_t strokeThresholdCount = 0;
+  size_t maximumKeyCodeCount = 0;
   for (size_t i = startSegmentIndex; i < segmentList.GetCount(); ++i) {
-    testSegments.Add(segmentList[i]);
-    strokeThresholdCount += segmentList[i].strokeLength;
+    const StenoSegment &segment = segmentList[i];
+    testSegments.Add(segment);
+    strokeThresholdCount += segment.strokeLength;
+
+    // Each character can at most be preceded by a space.
+    maximumKeyCodeCount += (Str::Length(segment.lookup.GetText()) + 1) *
+                           (segment.state->spaceCharacterLength + 1);
+  }
+  if (maximumKeyCodeCount > suggestionKeyCodeBuffer.capacity) {
+    testSegments.Reset();
+    return nullptr;
   }
 
-  StenoTokenizer *tokenizer = testSegments.CreateTokenizer();
-  previousConversionBuffer.keyCodeBuffer.Populate(tokenizer);
-  delete tokenizer;
+  StenoSegmentListTokenizer tokenizer(testSegments);
+  suggestionKeyCodeBuffer.Populate(tokenizer);
+
+  // The estimate above doesn't cover commands that lengthen later text,
+  // such as set_space. A full buffer may have been truncated.
+  if (suggestionKeyCodeBuffer.count == suggestionKeyCodeBuffer.capacity) {
+    testSegments.Reset();
+    return nullptr;
+  }
 
   if (!ShouldShowSuggestions(testSegments)) {
     testSegments.Reset();
@@ -513,8 +753,8 @@ char *StenoEngine::PrintSegmentSuggestion(size_t wordCount,
   char *lookup =
       testSegments.HasManualStateChange() ||
               Str::HasPrefix(testSegments.Back().lookup.GetText(), "{:")
-          ? previousConversionBuffer.keyCodeBuffer.ToString()
-          : previousConversionBuffer.keyCodeBuffer.ToUnresolvedString();
+          ? suggestionKeyCodeBuffer.ToString()
+          : suggestionKeyCodeBuffer.ToUnresolvedString();
 
   char *spaceRemoved = *lookup == ' ' ? lookup + 1 : lookup;
 
@@ -29,6 +29,15 @@ public:
     free(toFree);
   }
 
+  void Swap(_ListBase &other) {
+    uint8_t *otherBuffer = other.buffer;
+    size_t otherCount = other.count;
+    other.buffer = buffer;
+    other.count = count;
+    buffer = otherBuffer;
+    count = otherCount;
+  }
+
 protected:
   _ListBase() : count(0), buffer(nullptr) {}
 
@@ -1,6 +1,8 @@
 //---------------------------------------------------------------------------
 
 #include "orthography.h"
+#include "bit.h"
+#include "clock.h"
 #include "console.h"
 #include "crc.h"
 #include "str.h"
@@ -10,8 +12,6 @@
 
 #if USE_ORTHOGRAPHY_CACHE
 
-#define RECORD_ORTHOGRAPHY_CACHE_STATS 0
-
 #if RUN_TESTS
 
 void StenoCompiledOrthography::LockCache() {}
@@ -19,53 +19,117 @@ void StenoCompiledOrthography::UnlockCache() {}
 
 #endif
 
-StenoCompiledOrthography::CacheEntry::CacheEntry(const char *word,
-                                                 const char *suffix,
-                                                 const char *result)
-    : word(Str::Dup(word)), suffix(Str::Dup(suffix)), result(Str::Dup(result)) {
-}
+bool StenoCompiledOrthography::CacheBlock::Lookup(
+    uint32_t hash, size_t suffixIndex, const char *word, size_t wordLength,
+    char *buffer, size_t bufferSize) const {
+  const uint32_t startSequence = sequence.load(std::memory_order_acquire);
+  if (startSequence & 1) {
+    return false;
+  }
 
-StenoCompiledOrthography::CacheEntry::~CacheEntry() {
-  free(word);
-  free(suffix);
-  free(result);
-}
+  for (const CacheEntry &entry : entries) {
+    if (entry.hash != hash || entry.suffixIndex != suffixIndex ||
+        entry.wordLength != wordLength) {
+      continue;
+    }
 
-bool StenoCompiledOrthography::CacheEntry::IsEqual(const char *word,
-                                                   const char *suffix) const {
-  return Str::Eq(word, this->word) && Str::Eq(suffix, this->suffix);
+    // Lengths may be torn by a concurrent writer, so bounds check them
+    // before use.
+    const size_t resultLength = entry.resultLength;
+    if (wordLength + resultLength > sizeof(entry.text) ||
+        resultLength >= bufferSize) {
+      return false;
+    }
+    if (memcmp(entry.text, word, wordLength) != 0) {
+      continue;
+    }
+    memcpy(buffer, entry.text + wordLength, resultLength);
+    buffer[resultLength] = '\0';
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence.load(std::memory_order_relaxed) == startSequence;
+  }
+  return false;
 }
 
-char *StenoCompiledOrthography::CacheBlock::Lookup(const char *word,
-                                                   const char *suffix) const {
-  LockCache();
-  for (size_t i = 0; i < CACHE_ASSOCIATIVITY; ++i) {
-    const CacheEntry *entry = entries[i];
-    if (entry && entry->IsEqual(word, suffix)) {
-      char *result = Str::Dup(entry->result);
-      UnlockCache();
-      return result;
+// Must be called with the cache locked. Returns true if an entry was evicted.
+bool StenoCompiledOrthography::CacheBlock::AddEntry(uint32_t hash,
+                                                    size_t suffixIndex,
+                                                    const char *word,
+                                                    size_t wordLength,
+                                                    const char *result) {
+  const size_t resultLength = Str::Length(result);
+  if (wordLength + resultLength > sizeof(CacheEntry::text)) {
+    return false;
+  }
+
+  // Another thread may have added the entry since the lookup.
+  for (const CacheEntry &entry : entries) {
+    if (entry.hash == hash && entry.suffixIndex == suffixIndex &&
+        entry.wordLength == wordLength &&
+        memcmp(entry.text, word, wordLength) == 0) {
+      return false;
     }
   }
 
-  UnlockCache();
-  return nullptr;
+  CacheEntry &entry = entries[nextIndex++ & (CACHE_ASSOCIATIVITY - 1)];
+  const bool isEviction = entry.suffixIndex != 0;
+
+  const uint32_t startSequence = sequence.load(std::memory_order_relaxed);
+  sequence.store(startSequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  entry.hash = hash;
+  entry.suffixIndex = suffixIndex;
+  entry.wordLength = wordLength;
+  entry.resultLength = resultLength;
+  memcpy(entry.text, word, wordLength);
+  memcpy(entry.text + wordLength, result, resultLength);
+
+  sequence.store(startSequence + 2, std::memory_order_release);
+  return isEviction;
 }
 
-void StenoCompiledOrthography::CacheBlock::AddEntry(CacheEntry *entry) {
-  LockCache();
+// Returns the 1-based index of suffix, or 0 if it has not been interned.
+size_t StenoCompiledOrthography::FindCachedSuffix(const char *suffix) const {
+  const size_t count = cachedSuffixCount.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; ++i) {
+    if (Str::Eq(cachedSuffixes[i], suffix)) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
 
-  size_t entryIndex = index++ & (CACHE_ASSOCIATIVITY - 1);
-  CacheEntry *oldEntry = entries[entryIndex];
-  entries[entryIndex] = entry;
+// Must be called with the cache locked. Returns 0 if the suffix cannot be
+// interned.
+size_t StenoCompiledOrthography::AddCachedSuffix(const char *suffix) const {
+  const size_t existingIndex = FindCachedSuffix(suffix);
+  if (existingIndex != 0) {
+    return existingIndex;
+  }
 
-  UnlockCache();
+  const size_t count = cachedSuffixCount.load(std::memory_order_relaxed);
+  const size_t length = Str::Length(suffix);
+  if (count >= MAXIMUM_CACHED_SUFFIX_COUNT ||
+      length > MAXIMUM_CACHED_SUFFIX_LENGTH) {
+    return 0;
+  }
 
-  delete oldEntry;
+  memcpy(cachedSuffixes[count], suffix, length + 1);
+  cachedSuffixCount.store(count + 1, std::memory_order_release);
+  return count + 1;
 }
 
 #endif
 
+// Load and store rather than fetch_add, which is not available on all
+// targets.
+void StenoCompiledOrthography::Increment(std::atomic<uint32_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
 //---------------------------------------------------------------------------
 
 constexpr StenoOrthography StenoOrthography::emptyOrthography = {
@@ -79,16 +143,177 @@ constexpr StenoOrthography StenoOrthography::emptyOrthography = {
     .reverseAutoSuffixes = nullptr,
 };
 
+#if RUN_TESTS || RUN_BENCHMARKS
+
+// spellchecker: disable
+// The common English orthography rules, in the order they are applied.
+static const StenoOrthographyRule TEST_ORTHOGRAPHY_RULES[] = {
+    {R"(^(.*[aeiou]c) \^ly$)", R"(\1ally)"},
+    {R"(^(.*)([bcdfghjklmnpqrstvwxz])le \^ly$)", R"(\1\2ly)"},
+    {R"(^(.*)able \^ly$)", R"(\1ably)"},
+    {R"(^(.*[aeiou])l \^ly$)", R"(\1lly)"},
+    {R"(^(.*)y \^ful$)", R"(\1iful)"},
+    {R"(^(.*(?:s|sh|x|z|zh|ch)) \^s$)", R"(\1es)"},
+    {R"(^(.*[bcdfghjklmnpqrstvwxz])y \^s$)", R"(\1ies)"},
+    {R"(^(.*)ie \^ing$)", R"(\1ying)"},
+    {R"(^(.*[bcdfghjklmnpqrstvwxz])y \^([a-hj-xz].*)$)", R"(\1i\2)"},
+    {R"(^(.*)ee \^e(.*)$)", R"(\1ee\2)"},
+    {R"(^(.*(?:[bcdfghjklmnprstvwxyz]|qu)[aeiou])([bcdfgklmnprtvz]) \^([aeiouy].*)$)",
+     R"(\1\2\2\3)"},
+    {R"(^(.*[bcdfghjklmnpqrstuvwxz])e \^([aeiouy].*)$)", R"(\1\2)"},
+    {R"(^(.*)([aeiou])\2 \^(.*)$)", R"(\1\2\2\3)"},
+    {R"(^(.+)(?:er|or) \^ess$)", R"(\1ress)"},
+    {R"(^(.*)ic \^(?:al|ally)$)", R"(\1ically)"},
+};
+
+static StenoOrthographyAutoSuffix TEST_ORTHOGRAPHY_AUTO_SUFFIXES[] = {
+    {.stroke = StenoStroke(StrokeMask::ZR), .text = " {^s}"},
+    {.stroke = StenoStroke(StrokeMask::DR), .text = " {^ed}"},
+    {.stroke = StenoStroke(StrokeMask::GR), .text = " {^ing}"},
+};
+
+static const StenoOrthographyReverseAutoSuffix
+    TEST_ORTHOGRAPHY_REVERSE_AUTO_SUFFIXES[] = {
+        {
+            .autoSuffix = &TEST_ORTHOGRAPHY_AUTO_SUFFIXES[0],
+            .suppressMask = StenoStroke(StrokeMask::SR | StrokeMask::ZR),
+            .testPattern = "^(.*[^s])s$",
+            .replacement = "\\1",
+        },
+        {
+            .autoSuffix = &TEST_ORTHOGRAPHY_AUTO_SUFFIXES[1],
+            .suppressMask = StenoStroke(StrokeMask::DR),
+            .testPattern = "^(.*)ed$",
+            .replacement = "\\1",
+        },
+        {
+            .autoSuffix = &TEST_ORTHOGRAPHY_AUTO_SUFFIXES[2],
+            .suppressMask = StenoStroke(StrokeMask::GR),
+            .testPattern = "^(.*)ing$",
+            .replacement = "\\1",
+        },
+};
+
+static const StenoOrthographyRule SAMPLE_ORTHOGRAPHY_RULES[] = {
+    {R"(^(.*)e \^ed$)", R"(\1ed)"},
+    {R"(^(.*)s \^s$)", R"(\1les)"},
+};
+
+static const StenoOrthographyAlias SAMPLE_ORTHOGRAPHY_ALIASES[] = {
+    {.text = "age", .alias = "edge"},
+    {.text = "ful", .alias = "fill"},
+};
+// spellchecker: enable
+
+const StenoOrthography testOrthography = {
+    .ruleCount = sizeof(TEST_ORTHOGRAPHY_RULES) /
+                 sizeof(*TEST_ORTHOGRAPHY_RULES), // NOLINT
+    .rules = TEST_ORTHOGRAPHY_RULES,
+    .aliasCount = 0,
+    .aliases = nullptr,
+    .autoSuffixMask =
+        StenoStroke(StrokeMask::ZR | StrokeMask::DR | StrokeMask::GR),
+    .autoSuffixCount = sizeof(TEST_ORTHOGRAPHY_AUTO_SUFFIXES) /
+                       sizeof(*TEST_ORTHOGRAPHY_AUTO_SUFFIXES), // NOLINT
+    .autoSuffixes = TEST_ORTHOGRAPHY_AUTO_SUFFIXES,
+    .reverseAutoSuffixCount =
+        sizeof(TEST_ORTHOGRAPHY_REVERSE_AUTO_SUFFIXES) /
+        sizeof(*TEST_ORTHOGRAPHY_REVERSE_AUTO_SUFFIXES), // NOLINT
+    .reverseAutoSuffixes = TEST_ORTHOGRAPHY_REVERSE_AUTO_SUFFIXES,
+};
+
+const StenoOrthography sampleOrthography = {
+    .ruleCount = sizeof(SAMPLE_ORTHOGRAPHY_RULES) /
+                 sizeof(*SAMPLE_ORTHOGRAPHY_RULES), // NOLINT
+    .rules = SAMPLE_ORTHOGRAPHY_RULES,
+    .aliasCount = sizeof(SAMPLE_ORTHOGRAPHY_ALIASES) /
+                  sizeof(*SAMPLE_ORTHOGRAPHY_ALIASES), // NOLINT
+    .aliases = SAMPLE_ORTHOGRAPHY_ALIASES,
+    .autoSuffixMask = StenoStroke(),
+    .autoSuffixCount = 0,
+    .autoSuffixes = nullptr,
+    .reverseAutoSuffixCount = 0,
+    .reverseAutoSuffixes = nullptr,
+};
+
+#endif
+
 //---------------------------------------------------------------------------
 
-struct StenoCompiledOrthography::SuffixEntry {
-  SuffixEntry();
-  SuffixEntry(char *text, int score) : text(text), score(score) {}
+// Holds candidate spellings while adding a suffix, and the best ranked
+// candidate so far. Allocations come from an inline buffer, so the common
+// case doesn't touch the heap, and only overflow is malloc'd.
+class StenoCompiledOrthography::SuffixScratch {
+public:
+  SuffixScratch() = default;
+  SuffixScratch(const SuffixScratch &) = delete;
+  ~SuffixScratch() {
+    while (overflow) {
+      Overflow *next = overflow->next;
+      free(overflow);
+      overflow = next;
+    }
+  }
+
+  void *Allocate(size_t size) {
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    if (used + size <= sizeof(buffer)) {
+      void *result = buffer + used;
+      used += size;
+      return result;
+    }
+    Overflow *block = (Overflow *)malloc(sizeof(Overflow) + size);
+    block->next = overflow;
+    overflow = block;
+    return block + 1;
+  }
+
+  char *Join(const char *a, const char *b, const char *c) {
+    const size_t aLength = strlen(a);
+    const size_t bLength = strlen(b);
+    const size_t cLength = strlen(c);
+    char *result = (char *)Allocate(aLength + bLength + cLength + 1);
+    memcpy(result, a, aLength);
+    memcpy(result + aLength, b, bLength);
+    memcpy(result + aLength + bLength, c, cLength + 1);
+    return result;
+  }
+
+  // Candidates must be added in priority order, as ties keep the earlier
+  // candidate. Returns true if text has the best possible rank, so no later
+  // candidate can replace it.
+  bool AddCandidate(const char *text) {
+    const int rank = WordList::GetWordRank(text);
+    if (rank >= 0 && (bestCandidate == nullptr || rank < bestRank)) {
+      bestCandidate = text;
+      bestRank = rank;
+    }
+    return bestRank == WordList::BEST_RANK;
+  }
+
+  // Returns nullptr if no candidate is in the word list.
+  const char *GetBestCandidate() const { return bestCandidate; }
 
-  char *text;
-  int score;
+private:
+  struct Overflow {
+    Overflow *next;
+  };
+
+  size_t used = 0;
+  Overflow *overflow = nullptr;
+  const char *bestCandidate = nullptr;
+  int bestRank = -1;
+  alignas(void *) char buffer[256];
 };
 
+// Returns buffer if text fits, otherwise a new string.
+static char *CopyToBuffer(const char *text, char *buffer, size_t bufferSize) {
+  const size_t length = strlen(text);
+  char *result = length < bufferSize ? buffer : (char *)malloc(length + 1);
+  memcpy(result, text, length + 1);
+  return result;
+}
+
 //---------------------------------------------------------------------------
 
 void StenoOrthography::Print() const {
@@ -151,10 +376,28 @@ void StenoOrthography::Print() const {
 //---------------------------------------------------------------------------
 
 StenoCompiledOrthography::StenoCompiledOrthography(
-    const StenoOrthography &orthography)
-    : data(orthography), patterns(CreatePatterns(orthography)) {
+    const StenoOrthography &orthography,
+    const StenoOrthographySuffixTable *suffixTable)
+    : data(orthography), patterns(CreatePatterns(orthography)),
+      suffixTable(suffixTable) {
+  InitializeCache();
+  CreateRuleIndex();
+}
+
+void StenoCompiledOrthography::InitializeCache() {
+  suffixTableHitCount.store(0, std::memory_order_relaxed);
+  suffixTableMissCount.store(0, std::memory_order_relaxed);
+
 #if USE_ORTHOGRAPHY_CACHE
-  memset(&cache, 0, sizeof(cache));
+  for (CacheBlock &block : cache) {
+    block.sequence.store(0, std::memory_order_relaxed);
+    block.nextIndex = 0;
+    memset(block.entries, 0, sizeof(block.entries));
+  }
+  cachedSuffixCount.store(0, std::memory_order_relaxed);
+  cacheHitCount.store(0, std::memory_order_relaxed);
+  cacheMissCount.store(0, std::memory_order_relaxed);
+  cacheEvictionCount.store(0, std::memory_order_relaxed);
 #endif
 }
 
@@ -168,93 +411,218 @@ StenoCompiledOrthography::CreatePatterns(const StenoOrthography &orthography) {
   return patterns;
 }
 
+//---------------------------------------------------------------------------
+
+// Byte classes are 'a'-'z', then everything else.
+size_t StenoCompiledOrthography::GetByteClass(uint8_t c) {
+  size_t index = c - 'a';
+  return index < 26 ? index : 26;
+}
+
+void StenoCompiledOrthography::CreateRuleIndex() {
+  ruleMaskSize = (data.ruleCount + 31) / 32;
+  const size_t size = BYTE_CLASS_COUNT * ruleMaskSize * sizeof(uint32_t);
+  wordEndingRuleMasks = (uint32_t *)malloc(size);
+  suffixRuleMasks = (uint32_t *)malloc(size);
+  memset(wordEndingRuleMasks, 0, size);
+  memset(suffixRuleMasks, 0, size);
+
+  for (size_t i = 0; i < data.ruleCount; ++i) {
+    uint8_t wordEndings[16] = {};
+    uint8_t suffixStarts[16] = {};
+    if (!patterns[i].GetNeighborBytes(" ^", wordEndings, suffixStarts)) {
+      memset(wordEndings, 0xff, sizeof(wordEndings));
+      memset(suffixStarts, 0xff, sizeof(suffixStarts));
+    }
+
+    const size_t wordIndex = i / 32;
+    const uint32_t bit = 1 << (i & 31);
+    for (int c = 0; c < 128; ++c) {
+      if (wordEndings[c / 8] & (1 << (c & 7))) {
+        wordEndingRuleMasks[GetByteClass(c) * ruleMaskSize + wordIndex] |= bit;
+      }
+      if (suffixStarts[c / 8] & (1 << (c & 7))) {
+        suffixRuleMasks[GetByteClass(c) * ruleMaskSize + wordIndex] |= bit;
+      }
+    }
+
+    // Bytes >= 128 are always possible.
+    wordEndingRuleMasks[(BYTE_CLASS_COUNT - 1) * ruleMaskSize + wordIndex] |=
+        bit;
+    suffixRuleMasks[(BYTE_CLASS_COUNT - 1) * ruleMaskSize + wordIndex] |= bit;
+  }
+}
+
+// Iterates, in order, the rules that can match a word and suffix.
+class StenoCompiledOrthography::RuleIterator {
+public:
+  RuleIterator(const StenoCompiledOrthography &orthography, const char *word,
+               const char *suffix) {
+    const size_t wordLength = strlen(word);
+    const uint8_t wordEnding = wordLength ? word[wordLength - 1] : 0;
+    ruleMaskSize = orthography.ruleMaskSize;
+    wordEndingRuleMask = orthography.wordEndingRuleMasks +
+                         GetByteClass(wordEnding) * ruleMaskSize;
+    suffixRuleMask = orthography.suffixRuleMasks +
+                     GetByteClass(*suffix) * ruleMaskSize;
+  }
+
+  bool Next(size_t &ruleIndex) {
+    while (mask == 0) {
+      if (wordIndex == ruleMaskSize) {
+        return false;
+      }
+      mask = wordEndingRuleMask[wordIndex] & suffixRuleMask[wordIndex];
+      ++wordIndex;
+    }
+    ruleIndex = (wordIndex - 1) * 32 + Bit<4>::CountTrailingZeros(mask);
+    mask &= mask - 1;
+    return true;
+  }
+
+private:
+  size_t wordIndex = 0;
+  size_t ruleMaskSize;
+  uint32_t mask = 0;
+  const uint32_t *wordEndingRuleMask;
+  const uint32_t *suffixRuleMask;
+};
+
+//---------------------------------------------------------------------------
+
 #if USE_ORTHOGRAPHY_CACHE
 
-#if RECORD_ORTHOGRAPHY_CACHE_STATS
-static size_t cacheHits;
-static size_t cacheMisses;
-#endif
-char *StenoCompiledOrthography::AddSuffix(const char *word,
-                                          const char *suffix) const {
-  size_t blockIndex = Crc32(word, Str::Length(word)) & (CACHE_BLOCK_COUNT - 1);
-  char *cachedResult = cache[blockIndex].Lookup(word, suffix);
-  if (cachedResult) {
-#if RECORD_ORTHOGRAPHY_CACHE_STATS
-    cacheHits++;
-#endif
-    return cachedResult;
+char *StenoCompiledOrthography::AddSuffix(const char *word, const char *suffix,
+                                          char *buffer,
+                                          size_t bufferSize) const {
+  const size_t wordLength = Str::Length(word);
+  const uint32_t hash = Crc32(word, wordLength);
+  CacheBlock &block = cache[hash & (CACHE_BLOCK_COUNT - 1)];
+
+  size_t suffixIndex = FindCachedSuffix(suffix);
+  if (suffixIndex != 0 &&
+      block.Lookup(hash, suffixIndex, word, wordLength, buffer, bufferSize)) {
+    Increment(cacheHitCount);
+    return buffer;
   }
+  Increment(cacheMissCount);
 
-#if RECORD_ORTHOGRAPHY_CACHE_STATS
-  cacheMisses++;
-#endif
+  char *result = AddSuffixInternal(word, suffix, buffer, bufferSize);
+
+  LockCache();
+  if (suffixIndex == 0) {
+    suffixIndex = AddCachedSuffix(suffix);
+  }
+  if (suffixIndex != 0 &&
+      block.AddEntry(hash, suffixIndex, word, wordLength, result)) {
+    Increment(cacheEvictionCount);
+  }
+  UnlockCache();
 
-  char *result = AddSuffixInternal(word, suffix);
-  CacheEntry *entry = new CacheEntry(word, suffix, result);
-  cache[blockIndex].AddEntry(entry);
   return result;
 }
 
-char *StenoCompiledOrthography::AddSuffixInternal(const char *word,
-                                                  const char *suffix) const {
 #else
-char *StenoCompiledOrthography::AddSuffix(const char *word,
-                                          const char *suffix) const {
+
+char *StenoCompiledOrthography::AddSuffix(const char *word, const char *suffix,
+                                          char *buffer,
+                                          size_t bufferSize) const {
+  return AddSuffixInternal(word, suffix, buffer, bufferSize);
+}
+
 #endif
-  List<SuffixEntry> candidates;
 
-  for (size_t i = 0; i < data.aliasCount; ++i) {
-    if (Str::Eq(word, data.aliases[i].text)) {
-      AddCandidates(candidates, word, data.aliases[i].alias);
+char *StenoCompiledOrthography::AddSuffixInternal(const char *word,
+                                                  const char *suffix,
+                                                  char *buffer,
+                                                  size_t bufferSize) const {
+  if (suffixTable) {
+    char *result = suffixTable->Lookup(word, suffix, buffer, bufferSize);
+    if (result) {
+      Increment(suffixTableHitCount);
+      return result;
     }
+    Increment(suffixTableMissCount);
   }
 
-  char *simple = Str::Join(word, suffix, nullptr);
-
-  int score = WordList::GetWordRank(simple);
-  if (score >= 0) {
-    candidates.Add(SuffixEntry(simple, score));
-  } else {
-    free(simple);
+  // Overruns on the other conversion thread may also be reported here, which
+  // is acceptable for a diagnostic.
+  const size_t overrunCount = Pattern::GetStepBudgetOverrunCount();
+  char *result = ApplyRules(word, suffix, buffer, bufferSize);
+  if (Pattern::GetStepBudgetOverrunCount() != overrunCount) {
+    Console::Printf("Orthography rules exceeded the pattern step budget "
+                    "adding \"%s\" to \"%s\"\n",
+                    suffix, word);
   }
+  return result;
+}
 
-  AddCandidates(candidates, word, suffix);
+char *StenoCompiledOrthography::ApplyRules(const char *word, const char *suffix,
+                                           char *buffer,
+                                           size_t bufferSize) const {
+  if (IsProfiling()) {
+    Increment(profileCallCount);
+  }
 
-  if (candidates.IsNotEmpty()) {
-    candidates.Sort([](const void *pa, const void *pb) -> int {
-      const SuffixEntry *a = (const SuffixEntry *)pa;
-      const SuffixEntry *b = (const SuffixEntry *)pb;
-      if (a->score != b->score) {
-        return a->score - b->score;
-      }
-      return (int)(a - b);
-    });
-    for (size_t i = 1; i < candidates.GetCount(); ++i) {
-      free(candidates[i].text);
-    }
-    return candidates[0].text;
+  // Candidates are ranked as they are generated, and generation stops once
+  // one can't be beaten.
+  SuffixScratch scratch;
+  const char *simple = scratch.Join(word, "", suffix);
+  if (!AddAliasCandidates(scratch, word) && !scratch.AddCandidate(simple)) {
+    AddCandidates(scratch, word, suffix);
   }
-  for (SuffixEntry &entry : candidates) {
-    free(entry.text);
+
+  const char *bestCandidate = scratch.GetBestCandidate();
+  if (bestCandidate) {
+    return CopyToBuffer(bestCandidate, buffer, bufferSize);
   }
 
-  char *text = Str::Join(word, " ^", suffix, nullptr);
-  for (size_t i = 0; i < data.ruleCount; ++i) {
+  const char *text = scratch.Join(word, " ^", suffix);
+  RuleProfileCounters *const profile = GetActiveProfile();
+  RuleIterator rules(*this, word, suffix);
+  size_t i;
+  while (rules.Next(i)) {
+    const uint32_t startTime = profile ? Clock::GetMicroseconds() : 0;
     const PatternMatch &match = patterns[i].Match(text);
+    if (profile) {
+      profile[i].Record(match.match, startTime);
+    }
     if (!match.match) {
       continue;
     }
 
-    char *candidate = match.Replace(data.rules[i].replacement);
-    free(text);
-    return candidate;
+    const char *format = data.rules[i].replacement;
+    const size_t length = match.Replace(format, buffer, bufferSize);
+    if (length < bufferSize) {
+      return buffer;
+    }
+    char *result = (char *)malloc(length + 1);
+    match.Replace(format, result, length + 1);
+    return result;
   }
 
-  free(text);
-  return Str::Join(word, suffix, nullptr);
+  return CopyToBuffer(simple, buffer, bufferSize);
+}
+
+char *StenoCompiledOrthography::AddSuffix(const char *word,
+                                          const char *suffix) const {
+  char buffer[64];
+  char *result = AddSuffix(word, suffix, buffer, sizeof(buffer));
+  return result == buffer ? Str::Dup(buffer) : result;
+}
+
+bool StenoCompiledOrthography::AddAliasCandidates(SuffixScratch &scratch,
+                                                  const char *word) const {
+  for (size_t i = 0; i < data.aliasCount; ++i) {
+    if (Str::Eq(word, data.aliases[i].text) &&
+        AddCandidates(scratch, word, data.aliases[i].alias)) {
+      return true;
+    }
+  }
+  return false;
 }
 
-void StenoCompiledOrthography::AddCandidates(List<SuffixEntry> &candidates,
+bool StenoCompiledOrthography::AddCandidates(SuffixScratch &scratch,
                                              const char *word,
                                              const char *suffix) const {
   const size_t MAXIMUM_PREFIX_LENGTH = 8;
@@ -262,37 +630,207 @@ void StenoCompiledOrthography::AddCandidates(List<SuffixEntry> &candidates,
   size_t offset = wordLength > MAXIMUM_PREFIX_LENGTH
                       ? wordLength - MAXIMUM_PREFIX_LENGTH
                       : 0;
-  char *text = Str::Join(word + offset, " ^", suffix, nullptr);
+  const char *text = scratch.Join(word + offset, " ^", suffix);
 
   PatternQuickReject inputQuickReject(text);
 
-  for (size_t i = 0; i < data.ruleCount; ++i) {
+  RuleProfileCounters *const profile = GetActiveProfile();
+  RuleIterator rules(*this, word, suffix);
+  size_t i;
+  while (rules.Next(i)) {
     const Pattern &pattern = patterns[i];
     if (!pattern.IsPossibleMatch(inputQuickReject)) {
       continue;
     }
 
+    const uint32_t startTime = profile ? Clock::GetMicroseconds() : 0;
     const PatternMatch match = pattern.MatchBypassingQuickReject(text);
+    if (profile) {
+      profile[i].Record(match.match, startTime);
+    }
     if (!match.match) {
       continue;
     }
 
-    char *candidate = match.Replace(data.rules[i].replacement);
-    if (offset != 0) {
-      char *fullCandidate = (char *)malloc(wordLength + strlen(candidate));
-      memcpy(fullCandidate, word, offset);
-      strcpy(fullCandidate + offset, candidate);
-      free(candidate);
-      candidate = fullCandidate;
+    const char *format = data.rules[i].replacement;
+    const size_t length = match.Replace(format, nullptr, 0);
+    char *candidate = (char *)scratch.Allocate(offset + length + 1);
+    memcpy(candidate, word, offset);
+    match.Replace(format, candidate + offset, length + 1);
+    if (scratch.AddCandidate(candidate)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//---------------------------------------------------------------------------
+
+uint32_t StenoOrthographySuffixTable::Hash(const char *word,
+                                           const char *suffix) {
+  return Crc32(word, strlen(word)) * 31 + Crc32(suffix, strlen(suffix));
+}
+
+char *StenoOrthographySuffixTable::Lookup(const char *word,
+                                          const char *suffix, char *buffer,
+                                          size_t bufferSize) const {
+  const uint32_t hash = Hash(word, suffix);
+  const uint32_t *buckets = GetBuckets();
+  const uint32_t *entries = GetEntries();
+  const char *text = GetText();
+
+  const uint32_t bucket = hash & (bucketCount - 1);
+  const uint32_t fingerprint = hash >> 24;
+  for (uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; ++i) {
+    const uint32_t entry = entries[i];
+    if (entry >> 24 != fingerprint) {
+      continue;
+    }
+
+    const char *p = text + (entry & 0xffffff);
+    if (!Str::Eq(p, word)) {
+      continue;
     }
-    int score = WordList::GetWordRank(candidate);
-    if (score < 0) {
-      free(candidate);
+    p += strlen(p) + 1;
+    if (!Str::Eq(p, suffix)) {
       continue;
     }
-    candidates.Add(SuffixEntry(candidate, score));
+    p += strlen(p) + 1;
+
+    const size_t prefixLength = uint8_t(*p++);
+    const size_t remainderLength = strlen(p);
+    const size_t resultLength = prefixLength + remainderLength;
+    char *result = resultLength < bufferSize
+                       ? buffer
+                       : (char *)malloc(resultLength + 1);
+    memcpy(result, word, prefixLength);
+    memcpy(result + prefixLength, p, remainderLength + 1);
+    return result;
+  }
+  return nullptr;
+}
+
+void StenoOrthographySuffixTable::PrintInfo() const {
+  Console::Printf("      Suffix table entries: %zu\n", size_t(entryCount));
+  Console::Printf("      Suffix table respelled entries: %zu\n",
+                  size_t(respelledCount));
+  Console::Printf("      Suffix table size: %zu bytes\n", size_t(size));
+}
+
+static void AddUniqueSuffix(List<const char *> &suffixes, const char *suffix) {
+  for (const char *existingSuffix : suffixes) {
+    if (Str::Eq(existingSuffix, suffix)) {
+      return;
+    }
+  }
+  suffixes.Add(suffix);
+}
+
+StenoOrthographySuffixTable *StenoCompiledOrthography::CreateSuffixTable(
+    const char *const *words, size_t wordCount, const char *const *suffixes,
+    size_t suffixCount) const {
+  // Auto-suffix text is of the form ` {^suffix}`.
+  List<const char *> allSuffixes;
+  List<char *> autoSuffixes;
+  for (size_t i = 0; i < data.autoSuffixCount; ++i) {
+    const char *text = data.autoSuffixes[i].text;
+    const size_t length = strlen(text);
+    if (length > 4 && memcmp(text, " {^", 3) == 0 && text[length - 1] == '}') {
+      autoSuffixes.Add(Str::DupN(text + 3, length - 4));
+    }
+  }
+  for (const char *suffix : autoSuffixes) {
+    AddUniqueSuffix(allSuffixes, suffix);
+  }
+  for (size_t i = 0; i < suffixCount; ++i) {
+    AddUniqueSuffix(allSuffixes, suffixes[i]);
+  }
+
+  // Entries are generated with text offsets, then bucketed.
+  List<uint32_t> hashes;
+  List<uint32_t> offsets;
+  List<char> text;
+  uint32_t respelledCount = 0;
+  for (size_t i = 0; i < wordCount; ++i) {
+    const char *word = words[i];
+    const size_t wordLength = strlen(word);
+    if (wordLength > 0xff) {
+      continue;
+    }
+
+    for (const char *suffix : allSuffixes) {
+      char *result = AddSuffix(word, suffix);
+      size_t prefixLength = 0;
+      while (prefixLength < wordLength &&
+             result[prefixLength] == word[prefixLength]) {
+        ++prefixLength;
+      }
+      const size_t suffixLength = strlen(suffix);
+      if (prefixLength != wordLength ||
+          !Str::Eq(result + prefixLength, suffix)) {
+        ++respelledCount;
+      }
+
+      hashes.Add(StenoOrthographySuffixTable::Hash(word, suffix));
+      offsets.Add(text.GetCount());
+      for (size_t k = 0; k <= wordLength; ++k) {
+        text.Add(word[k]);
+      }
+      for (size_t k = 0; k <= suffixLength; ++k) {
+        text.Add(suffix[k]);
+      }
+      text.Add(char(prefixLength));
+      for (const char *p = result + prefixLength;; ++p) {
+        text.Add(*p);
+        if (*p == '\0') {
+          break;
+        }
+      }
+      free(result);
+    }
+  }
+  for (char *suffix : autoSuffixes) {
+    free(suffix);
+  }
+  assert(text.GetCount() <= 0x1000000);
+
+  const uint32_t entryCount = hashes.GetCount();
+  uint32_t bucketCount = 1;
+  while (2 * bucketCount < entryCount) {
+    bucketCount *= 2;
   }
-  free(text);
+
+  const size_t size = sizeof(StenoOrthographySuffixTable) +
+                      (bucketCount + 1 + entryCount) * sizeof(uint32_t) +
+                      text.GetCount();
+  StenoOrthographySuffixTable *table =
+      (StenoOrthographySuffixTable *)malloc(size);
+  table->bucketCount = bucketCount;
+  table->entryCount = entryCount;
+  table->respelledCount = respelledCount;
+  table->size = size;
+
+  // Count the entries in each bucket, then convert the counts to bucket
+  // ends, and fill each bucket from its end.
+  uint32_t *buckets = (uint32_t *)table->GetBuckets();
+  uint32_t *entries = (uint32_t *)table->GetEntries();
+  memset(buckets, 0, (bucketCount + 1) * sizeof(uint32_t));
+  for (uint32_t hash : hashes) {
+    buckets[hash & (bucketCount - 1)]++;
+  }
+  for (size_t i = 1; i <= bucketCount; ++i) {
+    buckets[i] += buckets[i - 1];
+  }
+  for (size_t i = 0; i < entryCount; ++i) {
+    const uint32_t hash = hashes[i];
+    const uint32_t entryIndex = --buckets[hash & (bucketCount - 1)];
+    entries[entryIndex] = (hash >> 24 << 24) | offsets[i];
+  }
+  if (text.IsNotEmpty()) {
+    memcpy((char *)table->GetText(), &text[0], text.GetCount());
+  }
+
+  return table;
 }
 
 //---------------------------------------------------------------------------
@@ -304,10 +842,418 @@ void StenoCompiledOrthography::PrintInfo() const {
   Console::Printf("      Auto-suffixes: %zu\n", data.autoSuffixCount);
   Console::Printf("      Reverse auto-suffixes: %zu\n",
                   data.reverseAutoSuffixCount);
-#if RECORD_ORTHOGRAPHY_CACHE_STATS
-  Console::Printf("      Cache hits: %zu/%zu\n", cacheHits,
-                  cacheHits + cacheMisses);
+  Console::Printf("      Pattern step budget overruns: %zu\n",
+                  Pattern::GetStepBudgetOverrunCount());
+  if (suffixTable) {
+    suffixTable->PrintInfo();
+    const size_t hits = suffixTableHitCount.load(std::memory_order_relaxed);
+    const size_t misses = suffixTableMissCount.load(std::memory_order_relaxed);
+    Console::Printf("      Suffix table hits: %zu/%zu\n", hits,
+                    hits + misses);
+  }
+#if USE_ORTHOGRAPHY_CACHE
+  const size_t hits = cacheHitCount.load(std::memory_order_relaxed);
+  const size_t misses = cacheMissCount.load(std::memory_order_relaxed);
+  Console::Printf("      Cache size: %zu\n", CACHE_SIZE);
+  Console::Printf("      Cache hits: %zu/%zu\n", hits, hits + misses);
+  Console::Printf("      Cache evictions: %zu\n",
+                  size_t(cacheEvictionCount.load(std::memory_order_relaxed)));
+  Console::Printf("      Cached suffixes: %zu\n",
+                  cachedSuffixCount.load(std::memory_order_relaxed));
 #endif
 }
 
 //---------------------------------------------------------------------------
+
+void StenoCompiledOrthography::RuleProfileCounters::Record(bool isMatch,
+                                                           uint32_t startTime) {
+  Increment(evaluationCount);
+  if (isMatch) {
+    Increment(matchCount);
+  }
+  microseconds.store(microseconds.load(std::memory_order_relaxed) +
+                         Clock::GetMicroseconds() - startTime,
+                     std::memory_order_relaxed);
+}
+
+// Enabling resets the counters. Counts recorded concurrently may be lost,
+// which is acceptable for a diagnostic.
+void StenoCompiledOrthography::EnableProfile() const {
+  if (ruleProfiles == nullptr) {
+    ruleProfiles = new RuleProfileCounters[data.ruleCount];
+  }
+  for (size_t i = 0; i < data.ruleCount; ++i) {
+    ruleProfiles[i].evaluationCount.store(0, std::memory_order_relaxed);
+    ruleProfiles[i].matchCount.store(0, std::memory_order_relaxed);
+    ruleProfiles[i].microseconds.store(0, std::memory_order_relaxed);
+  }
+  profileCallCount.store(0, std::memory_order_relaxed);
+  profiling.store(true, std::memory_order_release);
+}
+
+void StenoCompiledOrthography::DisableProfile() const {
+  profiling.store(false, std::memory_order_release);
+}
+
+StenoCompiledOrthography::RuleProfile
+StenoCompiledOrthography::GetRuleProfile(size_t ruleIndex) const {
+  if (ruleProfiles == nullptr) {
+    return RuleProfile{};
+  }
+  const RuleProfileCounters &counters = ruleProfiles[ruleIndex];
+  return RuleProfile{
+      .evaluationCount =
+          counters.evaluationCount.load(std::memory_order_relaxed),
+      .matchCount = counters.matchCount.load(std::memory_order_relaxed),
+      .microseconds = counters.microseconds.load(std::memory_order_relaxed),
+  };
+}
+
+void StenoCompiledOrthography::PrintProfile() const {
+  Console::Printf("{"
+                  "\n\t\"enabled\": %s,"
+                  "\n\t\"calls\": %u,"
+                  "\n\t\"rules\": [",
+                  IsProfiling() ? "true" : "false",
+                  profileCallCount.load(std::memory_order_relaxed));
+  for (size_t i = 0; i < data.ruleCount; ++i) {
+    if (i != 0) {
+      Console::Printf(",");
+    }
+    const RuleProfile profile = GetRuleProfile(i);
+    Console::Printf("\n\t\t{"
+                    "\n\t\t\t\"pattern\": \"%J\","
+                    "\n\t\t\t\"evaluations\": %u,"
+                    "\n\t\t\t\"matches\": %u,"
+                    "\n\t\t\t\"time_us\": %u"
+                    "\n\t\t}",
+                    data.rules[i].testPattern, profile.evaluationCount,
+                    profile.matchCount, profile.microseconds);
+  }
+  Console::Printf("\n\t]\n}\n\n");
+}
+
+#if USE_ORTHOGRAPHY_CACHE
+uint32_t StenoCompiledOrthography::GetCacheHitCount() const {
+  return cacheHitCount.load(std::memory_order_relaxed);
+}
+
+uint32_t StenoCompiledOrthography::GetCacheMissCount() const {
+  return cacheMissCount.load(std::memory_order_relaxed);
+}
+#else
+uint32_t StenoCompiledOrthography::GetCacheHitCount() const { return 0; }
+uint32_t StenoCompiledOrthography::GetCacheMissCount() const { return 0; }
+#endif
+
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#include "unit_test.h"
+
+// spellchecker: disable
+TEST_BEGIN("Orthography: Rule index test") {
+  const StenoCompiledOrthography compiledOrthography(testOrthography);
+
+  static const struct {
+    const char *word;
+    const char *suffix;
+    const char *expected;
+  } CASES[] = {
+      {"carry", "s", "carries"},  {"fix", "s", "fixes"},
+      {"make", "ing", "making"},  {"defer", "ed", "deferred"},
+      {"play", "s", "plays"},     {"test", "ing", "testing"},
+      {"", "s", "s"},             {"caf\xc3\xa9", "s", "caf\xc3\xa9s"},
+  };
+  for (const auto &c : CASES) {
+    char *result = compiledOrthography.AddSuffix(c.word, c.suffix);
+    assert(Str::Eq(result, c.expected));
+    free(result);
+  }
+}
+TEST_END
+
+TEST_BEGIN("Orthography: Cache test") {
+  const StenoCompiledOrthography compiledOrthography(testOrthography);
+
+  // Repeated lookups hit the cache, and must return the same result whether
+  // the result fits the buffer or not.
+  for (size_t i = 0; i < 2; ++i) {
+    char buffer[16];
+    char *result =
+        compiledOrthography.AddSuffix("make", "ing", buffer, sizeof(buffer));
+    assert(result == buffer);
+    assert(Str::Eq(result, "making"));
+
+    char smallBuffer[4];
+    result = compiledOrthography.AddSuffix("make", "ing", smallBuffer,
+                                           sizeof(smallBuffer));
+    assert(result != smallBuffer);
+    assert(Str::Eq(result, "making"));
+    free(result);
+  }
+
+  // Words and suffixes too long to cache still produce results.
+  static const char LONG_WORD[] =
+      "pneumonoultramicroscopicsilicovolcanoconiosispneumonoultramicroscope";
+  for (size_t i = 0; i < 2; ++i) {
+    char *result = compiledOrthography.AddSuffix(LONG_WORD, "ing");
+    assert(Str::Eq(result, "pneumonoultramicroscopicsilicovolcanoconiosis"
+                           "pneumonoultramicroscoping"));
+    free(result);
+
+    result = compiledOrthography.AddSuffix("make", "ingestingestingest");
+    assert(Str::Eq(result, "makingestingestingest"));
+    free(result);
+  }
+
+  // Evicted entries are recalculated.
+  char word[] = "a_e";
+  for (size_t i = 0; i < 2; ++i) {
+    for (const char *p = "bcdfghjklmnpqrstvwxz"; *p; ++p) {
+      const char c = *p;
+      word[1] = c;
+      char *result = compiledOrthography.AddSuffix(word, "ed");
+      assert(result[0] == 'a' && result[1] == c && Str::Eq(result + 2, "ed"));
+      free(result);
+    }
+  }
+}
+TEST_END
+
+TEST_BEGIN("Orthography: Suffix table test") {
+  const StenoCompiledOrthography compiledOrthography(testOrthography);
+
+  static const char *const WORDS[] = {"carry", "make", "test"};
+  static const char *const SUFFIXES[] = {"ed", "s"};
+  StenoOrthographySuffixTable *table = compiledOrthography.CreateSuffixTable(
+      WORDS, sizeof(WORDS) / sizeof(*WORDS), // NOLINT
+      SUFFIXES, sizeof(SUFFIXES) / sizeof(*SUFFIXES)); // NOLINT
+
+  // s, ing and ed for each word. carries, carried, making and maked are
+  // respelled.
+  assert(table->entryCount == 9);
+  assert(table->respelledCount == 4);
+
+  static const struct {
+    const char *word;
+    const char *suffix;
+    const char *expected;
+  } CASES[] = {
+      {"carry", "s", "carries"}, {"carry", "ed", "carried"},
+      {"carry", "ing", "carrying"},
+      {"make", "ing", "making"}, {"make", "s", "makes"},
+      {"test", "ed", "tested"},
+  };
+  char buffer[16];
+  for (const auto &c : CASES) {
+    char *result = table->Lookup(c.word, c.suffix, buffer, sizeof(buffer));
+    assert(result == buffer && Str::Eq(result, c.expected));
+  }
+  char *result = table->Lookup("carry", "s", buffer, 4);
+  assert(result != buffer && Str::Eq(result, "carries"));
+  free(result);
+  assert(table->Lookup("carry", "ly", buffer, sizeof(buffer)) == nullptr);
+  assert(table->Lookup("hope", "ing", buffer, sizeof(buffer)) == nullptr);
+
+  const StenoCompiledOrthography tableOrthography(testOrthography, table);
+  result = tableOrthography.AddSuffix("carry", "s");
+  assert(Str::Eq(result, "carries"));
+  free(result);
+  result = tableOrthography.AddSuffix("hope", "ing");
+  assert(Str::Eq(result, "hoping"));
+  free(result);
+
+  free(table);
+}
+TEST_END
+
+TEST_BEGIN("Orthography: Candidate ranking test") {
+  const StenoCompiledOrthography compiledOrthography(testOrthography);
+
+  static const uint8_t DATA[] = {
+      0xf0, 'f', 'i', 't', 'e', 'd', 0xf3, 'f', 'i', 't', 't', 'e', 'd',
+      0xf1, 'h', 'o', 'p', 'i', 'n', 'g', 0xf2, 't', 'e', 's', 't', 'e',
+      'd',  0xf0, 'v', 'i', 's', 'i', 't', 'e', 'd', 0xf2, 'v', 'i', 's',
+      'i',  't', 't', 'e', 'd', 0xf2,
+  };
+  const WordList savedInstance = WordList::instance;
+  WordList::SetData(DATA, sizeof(DATA));
+  compiledOrthography.EnableProfile();
+
+  static const struct {
+    const char *word;
+    const char *suffix;
+    const char *expected;
+  } CASES[] = {
+      {"hope", "ing", "hoping"},    // Only the rule's result is a word.
+      {"fit", "ed", "fitted"},      // The rule's result ranks better.
+      {"visit", "ed", "visited"},   // Ties keep the earlier candidate.
+      {"test", "ed", "tested"},     // Unbeatable, so no rules are evaluated.
+  };
+  for (const auto &c : CASES) {
+    char *result = compiledOrthography.AddSuffix(c.word, c.suffix);
+    assert(Str::Eq(result, c.expected));
+    free(result);
+
+    if (Str::Eq(c.word, "visit")) {
+      compiledOrthography.EnableProfile();
+    }
+  }
+  for (size_t i = 0; i < testOrthography.ruleCount; ++i) {
+    assert(compiledOrthography.GetRuleProfile(i).evaluationCount == 0);
+  }
+
+  WordList::instance = savedInstance;
+}
+TEST_END
+
+TEST_BEGIN("Orthography: Profile test") {
+  // Indices of the y to ies and silent e rules in testOrthography.
+  const size_t Y_TO_IES_RULE = 6;
+  const size_t SILENT_E_RULE = 11;
+  assert(Str::Eq(testOrthography.rules[Y_TO_IES_RULE].replacement,
+                 R"(\1ies)"));
+  assert(Str::Eq(testOrthography.rules[SILENT_E_RULE].replacement,
+                 R"(\1\2)"));
+
+  const StenoCompiledOrthography compiledOrthography(testOrthography);
+  assert(!compiledOrthography.IsProfiling());
+
+  free(compiledOrthography.AddSuffix("carry", "s"));
+  assert(compiledOrthography.GetRuleProfile(Y_TO_IES_RULE).evaluationCount ==
+         0);
+
+  compiledOrthography.EnableProfile();
+  assert(compiledOrthography.IsProfiling());
+  free(compiledOrthography.AddSuffix("carry", "ed"));
+  free(compiledOrthography.AddSuffix("hope", "ing"));
+
+  // The rule index skips rules that cannot match.
+  const StenoCompiledOrthography::RuleProfile carryProfile =
+      compiledOrthography.GetRuleProfile(Y_TO_IES_RULE);
+  assert(carryProfile.evaluationCount == 0);
+
+  const StenoCompiledOrthography::RuleProfile silentEProfile =
+      compiledOrthography.GetRuleProfile(SILENT_E_RULE);
+  assert(silentEProfile.matchCount >= 1);
+  assert(silentEProfile.matchCount <= silentEProfile.evaluationCount);
+
+#if USE_ORTHOGRAPHY_CACHE
+  // Cache hits do not evaluate rules.
+  free(compiledOrthography.AddSuffix("hope", "ing"));
+  assert(compiledOrthography.GetRuleProfile(SILENT_E_RULE).evaluationCount ==
+         silentEProfile.evaluationCount);
+#endif
+
+  compiledOrthography.DisableProfile();
+  free(compiledOrthography.AddSuffix("hope", "ed"));
+  assert(compiledOrthography.GetRuleProfile(SILENT_E_RULE).evaluationCount ==
+         silentEProfile.evaluationCount);
+
+  // Enabling again resets the counts.
+  compiledOrthography.EnableProfile();
+  assert(compiledOrthography.GetRuleProfile(SILENT_E_RULE).evaluationCount ==
+         0);
+}
+TEST_END
+// spellchecker: enable
+
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+#include "benchmark.h"
+
+// spellchecker: disable
+// Common words, roughly in order of frequency, and the suffixes most often
+// added to them.
+static const char *const BENCHMARK_WORDS[] = {
+    "make",  "work",   "use",    "try",   "call",    "play",  "move",
+    "live",  "carry",  "stop",   "run",   "begin",   "plan",  "hope",
+    "fix",   "wish",   "watch",  "study", "travel",  "admit", "defer",
+    "agree", "die",    "lie",    "quit",  "happy",   "basic", "real",
+    "simple", "comfortable", "beauty", "dance", "act", "age", "dress",
+    "kiss",  "box",    "church", "apply", "refer",   "visit", "open",
+    "large", "nice",   "true",   "free",  "see",     "flee",
+};
+
+static const char *const BENCHMARK_SUFFIXES[] = {
+    "s", "ed", "ing", "s", "ed", "ing", "er", "ly", "ful", "able", "ness",
+};
+// spellchecker: enable
+
+// Word and suffix pairs, with earlier words chosen more often, as in text.
+struct BenchmarkSuffixCorpus {
+  static const size_t COUNT = 2048;
+  const char *words[COUNT];
+  const char *suffixes[COUNT];
+
+  BenchmarkSuffixCorpus() {
+    const size_t wordCount =
+        sizeof(BENCHMARK_WORDS) / sizeof(*BENCHMARK_WORDS); // NOLINT
+    const size_t suffixCount =
+        sizeof(BENCHMARK_SUFFIXES) / sizeof(*BENCHMARK_SUFFIXES); // NOLINT
+    uint32_t seed = 1;
+    for (size_t i = 0; i < COUNT; ++i) {
+      seed = seed * 1103515245 + 12345;
+      const size_t a = (seed >> 8) % wordCount;
+      seed = seed * 1103515245 + 12345;
+      const size_t b = (seed >> 8) % wordCount;
+      words[i] = BENCHMARK_WORDS[a * b / wordCount];
+      seed = seed * 1103515245 + 12345;
+      suffixes[i] = BENCHMARK_SUFFIXES[(seed >> 8) % suffixCount];
+    }
+  }
+};
+
+// Reports the time of each AddSuffix call, the throughput of the corpus and
+// the cache hit rate. The orthography persists between runs, so the cache
+// reaches a steady state.
+static void BenchmarkAddSuffix(const StenoCompiledOrthography &orthography) {
+  static const BenchmarkSuffixCorpus corpus;
+
+  const uint32_t initialHits = orthography.GetCacheHitCount();
+  const uint32_t initialMisses = orthography.GetCacheMissCount();
+  const uint64_t corpusStartTime = Benchmark::GetNanoseconds();
+  for (size_t i = 0; i < BenchmarkSuffixCorpus::COUNT; ++i) {
+    char buffer[64];
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    char *result = orthography.AddSuffix(corpus.words[i], corpus.suffixes[i],
+                                         buffer, sizeof(buffer));
+    Benchmark::AddSample("time (ns)", Benchmark::GetNanoseconds() - startTime);
+    if (result != buffer) {
+      free(result);
+    }
+  }
+  const uint64_t duration = Benchmark::GetNanoseconds() - corpusStartTime;
+  Benchmark::AddSample("calls/sec",
+                       BenchmarkSuffixCorpus::COUNT * 1'000'000'000 /
+                           duration);
+
+  const uint32_t hits = orthography.GetCacheHitCount() - initialHits;
+  const uint32_t misses = orthography.GetCacheMissCount() - initialMisses;
+  if (hits + misses != 0) {
+    Benchmark::AddSample("cache hit rate (%)", 100 * hits / (hits + misses));
+  }
+}
+
+BENCHMARK_BEGIN("Orthography: sample-orthography.json AddSuffix") {
+  static const StenoCompiledOrthography *orthography =
+      new StenoCompiledOrthography(sampleOrthography);
+  BenchmarkAddSuffix(*orthography);
+}
+BENCHMARK_END
+
+BENCHMARK_BEGIN("Orthography: English rules AddSuffix") {
+  static const StenoCompiledOrthography *orthography =
+      new StenoCompiledOrthography(testOrthography);
+  BenchmarkAddSuffix(*orthography);
+}
+BENCHMARK_END
+
+#endif
+
+//---------------------------------------------------------------------------
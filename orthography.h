@@ -5,12 +5,28 @@
 #include "malloc_allocate.h"
 #include "pattern.h"
 #include "stroke.h"
+#include <atomic>
 #include <stddef.h>
 
 //---------------------------------------------------------------------------
 
 #define USE_ORTHOGRAPHY_CACHE 1
 
+// Number of cached suffix results. Must be a multiple of 4.
+#ifndef JAVELIN_ORTHOGRAPHY_CACHE_SIZE
+#define JAVELIN_ORTHOGRAPHY_CACHE_SIZE 256
+#endif
+
+// Bytes per cached suffix result, which must be a multiple of 4. Each entry
+// holds the word and result inline in the entry size less 7 bytes, and
+// results that don't fit are not cached.
+//
+// The default caches 256 results whose word and result total up to 25
+// characters. With block headers and interned suffixes, that is 9kb.
+#ifndef JAVELIN_ORTHOGRAPHY_CACHE_ENTRY_SIZE
+#define JAVELIN_ORTHOGRAPHY_CACHE_ENTRY_SIZE 32
+#endif
+
 //---------------------------------------------------------------------------
 
 struct StenoOrthographyRule {
@@ -56,57 +72,210 @@ struct StenoOrthography {
   void Print() const;
 };
 
+#if RUN_TESTS || RUN_BENCHMARKS
+// Fixtures shared by tests and benchmarks. testOrthography has the common
+// English rules, with ^s, ^ed and ^ing auto suffixes and their reverse
+// auto suffixes. sampleOrthography has the rules and aliases from
+// sample-orthography.json.
+extern const StenoOrthography testOrthography;
+extern const StenoOrthography sampleOrthography;
+#endif
+
+//---------------------------------------------------------------------------
+
+// Precomputed AddSuffix results for commonly used word and suffix pairs. The
+// table is position independent, so it can be built on a host with
+// StenoCompiledOrthography::CreateSuffixTable and stored in flash.
+//
+// Layout, following the header:
+//   buckets[bucketCount + 1]: Start of each bucket's entries.
+//   entries[entryCount]: (fingerprint << 24) | text offset, grouped by bucket.
+//   text: For each entry, the null terminated word and suffix, a byte with
+//         the length of the prefix the result shares with the word, and the
+//         null terminated remainder of the result.
+struct StenoOrthographySuffixTable {
+  uint32_t bucketCount;
+  uint32_t entryCount;
+  uint32_t respelledCount; // Entries where the result isn't word + suffix.
+  uint32_t size;           // In bytes, including the header.
+
+  // Returns nullptr if the pair is not in the table, buffer if the result
+  // fits, otherwise a new string that the caller must free.
+  char *Lookup(const char *word, const char *suffix, char *buffer,
+               size_t bufferSize) const;
+
+  void PrintInfo() const;
+
+  static uint32_t Hash(const char *word, const char *suffix);
+
+private:
+  const uint32_t *GetBuckets() const { return (const uint32_t *)(this + 1); }
+  const uint32_t *GetEntries() const {
+    return GetBuckets() + bucketCount + 1;
+  }
+  const char *GetText() const {
+    return (const char *)(GetEntries() + entryCount);
+  }
+
+  friend class StenoCompiledOrthography;
+};
+
 //---------------------------------------------------------------------------
 
 class StenoCompiledOrthography {
 public:
-  explicit StenoCompiledOrthography(const StenoOrthography &orthography);
+  explicit StenoCompiledOrthography(
+      const StenoOrthography &orthography,
+      const StenoOrthographySuffixTable *suffixTable = nullptr);
 
+  // The cache makes this large, so share it by reference instead.
+  StenoCompiledOrthography(const StenoCompiledOrthography &) = delete;
+
+  // Returns a new string that the caller must free.
   char *AddSuffix(const char *word, const char *suffix) const;
 
+  // Returns buffer if the result fits, otherwise a new string that the
+  // caller must free.
+  char *AddSuffix(const char *word, const char *suffix, char *buffer,
+                  size_t bufferSize) const;
+
+  // Precomputes AddSuffix for every word with each of the orthography's
+  // auto-suffixes and each of suffixes. Words should be unique. Returns a
+  // table that the caller must free.
+  StenoOrthographySuffixTable *
+  CreateSuffixTable(const char *const *words, size_t wordCount,
+                    const char *const *suffixes, size_t suffixCount) const;
+
   void PrintInfo() const;
 
+  // Profiling counts the evaluations, matches and time of each rule. Rules
+  // are only evaluated on cache and suffix table misses. Times have the
+  // resolution of Clock, so are only meaningful in aggregate.
+  struct RuleProfile {
+    uint32_t evaluationCount;
+    uint32_t matchCount;
+    uint32_t microseconds;
+  };
+
+  void EnableProfile() const;
+  void DisableProfile() const;
+  bool IsProfiling() const {
+    return profiling.load(std::memory_order_acquire);
+  }
+  RuleProfile GetRuleProfile(size_t ruleIndex) const;
+  void PrintProfile() const;
+
+  uint32_t GetCacheHitCount() const;
+  uint32_t GetCacheMissCount() const;
+
   const StenoOrthography &data;
 
 private:
-  struct SuffixEntry;
+  class SuffixScratch;
+  class RuleIterator;
 
   const Pattern *patterns;
+  const StenoOrthographySuffixTable *const suffixTable;
 
-#if USE_ORTHOGRAPHY_CACHE
-  struct CacheEntry : public JavelinMallocAllocate {
-    CacheEntry(const char *word, const char *suffix, const char *result);
-    ~CacheEntry();
+  mutable std::atomic<uint32_t> suffixTableHitCount;
+  mutable std::atomic<uint32_t> suffixTableMissCount;
+
+  // Rules are indexed by the byte class of the last byte of the word and the
+  // first byte of the suffix. Each class has a bit mask of the rules that
+  // can match, ruleMaskSize words long.
+  static const size_t BYTE_CLASS_COUNT = 27;
+
+  size_t ruleMaskSize;
+  uint32_t *wordEndingRuleMasks;
+  uint32_t *suffixRuleMasks;
 
-    char *const word;
-    char *const suffix;
-    char *const result;
+  static size_t GetByteClass(uint8_t c);
+  void CreateRuleIndex();
+  void InitializeCache();
 
-    bool IsEqual(const char *word, const char *suffix) const;
+#if USE_ORTHOGRAPHY_CACHE
+  // Entries store the word and the result, without terminators.
+  // Suffixes are interned, and stored as an index.
+  struct CacheEntry {
+    uint32_t hash;
+    uint8_t suffixIndex; // 0 for unused entries.
+    uint8_t wordLength;
+    uint8_t resultLength;
+    char text[JAVELIN_ORTHOGRAPHY_CACHE_ENTRY_SIZE - 7];
+  };
+  static_assert(sizeof(CacheEntry) == JAVELIN_ORTHOGRAPHY_CACHE_ENTRY_SIZE,
+                "Cache entry size must be a multiple of 4");
+
+  // Lookups don't lock. Writers take the lock and make the sequence odd
+  // while updating entries, and readers discard anything read while the
+  // sequence was odd or changed.
+  struct CacheBlock {
+    std::atomic<uint32_t> sequence;
+    uint32_t nextIndex;
+    CacheEntry entries[4];
+
+    bool Lookup(uint32_t hash, size_t suffixIndex, const char *word,
+                size_t wordLength, char *buffer, size_t bufferSize) const;
+    bool AddEntry(uint32_t hash, size_t suffixIndex, const char *word,
+                  size_t wordLength, const char *result);
   };
 
   static void LockCache();
   static void UnlockCache();
 
-  static const size_t CACHE_SIZE = 256;
+  static const size_t CACHE_SIZE = JAVELIN_ORTHOGRAPHY_CACHE_SIZE;
   static const size_t CACHE_ASSOCIATIVITY = 4;
   static const size_t CACHE_BLOCK_COUNT = CACHE_SIZE / CACHE_ASSOCIATIVITY;
+  static_assert((CACHE_BLOCK_COUNT & (CACHE_BLOCK_COUNT - 1)) == 0,
+                "Cache block count must be a power of 2");
 
-  struct CacheBlock {
-    uint32_t index;
-    CacheEntry *entries[CACHE_ASSOCIATIVITY];
-
-    char *Lookup(const char *word, const char *suffix) const;
-    void AddEntry(CacheEntry *entry);
-  };
+  static const size_t MAXIMUM_CACHED_SUFFIX_COUNT = 32;
+  static const size_t MAXIMUM_CACHED_SUFFIX_LENGTH = 15;
 
   mutable CacheBlock cache[CACHE_BLOCK_COUNT];
 
+  // Suffixes are only ever added, and are published by cachedSuffixCount.
+  mutable std::atomic<size_t> cachedSuffixCount;
+  mutable char cachedSuffixes[MAXIMUM_CACHED_SUFFIX_COUNT]
+                             [MAXIMUM_CACHED_SUFFIX_LENGTH + 1];
+
+  // Statistics are updated without synchronization, so may undercount.
+  mutable std::atomic<uint32_t> cacheHitCount;
+  mutable std::atomic<uint32_t> cacheMissCount;
+  mutable std::atomic<uint32_t> cacheEvictionCount;
+
+  size_t FindCachedSuffix(const char *suffix) const;
+  size_t AddCachedSuffix(const char *suffix) const;
 #endif
 
-  char *AddSuffixInternal(const char *word, const char *suffix) const;
+  static void Increment(std::atomic<uint32_t> &counter);
+
+  struct RuleProfileCounters {
+    std::atomic<uint32_t> evaluationCount;
+    std::atomic<uint32_t> matchCount;
+    std::atomic<uint32_t> microseconds;
+
+    void Record(bool isMatch, uint32_t startTime);
+  };
+
+  // Allocated when profiling is first enabled, and published by profiling.
+  mutable RuleProfileCounters *ruleProfiles = nullptr;
+  mutable std::atomic<bool> profiling = false;
+  mutable std::atomic<uint32_t> profileCallCount = 0;
+
+  // Returns nullptr unless profiling.
+  RuleProfileCounters *GetActiveProfile() const {
+    return IsProfiling() ? ruleProfiles : nullptr;
+  }
+
+  char *AddSuffixInternal(const char *word, const char *suffix, char *buffer,
+                          size_t bufferSize) const;
+  char *ApplyRules(const char *word, const char *suffix, char *buffer,
+                   size_t bufferSize) const;
 
-  void AddCandidates(List<SuffixEntry> &candidates, const char *word,
+  // These return true once a candidate can't be beaten.
+  bool AddAliasCandidates(SuffixScratch &scratch, const char *word) const;
+  bool AddCandidates(SuffixScratch &scratch, const char *word,
                      const char *suffix) const;
 
   static const Pattern *CreatePatterns(const StenoOrthography &orthography);
@@ -1,207 +1,437 @@
 //---------------------------------------------------------------------------
 
 #include "pattern.h"
-#include "pattern_component.h"
 #include "str.h"
+#include "writer.h"
 #include <assert.h>
+#include <atomic>
 #include <stdlib.h>
+#include <string.h>
 
 //---------------------------------------------------------------------------
 
-struct Pattern::BuildContext {
-  const char *p;
-  int captureIndex;
+// Jump operands are signed 16-bit offsets relative to the end of the
+// instruction, so that code can be moved when a quantifier is applied.
+enum PatternOpcode : uint8_t {
+  MATCH,
+  TAIL,            // length, text[length]. The text must end with text.
+  BYTE,            // c
+  LITERAL,         // length, text[length]
+  ANY,             //
+  ANY_STAR,        // next[16]. Greedy, tries the longest match first.
+  CHARACTER_SET,   // mask[16]
+  CHARACTER_STAR,  // mask[16], next[16]. Greedy.
+  START_OF_LINE,   //
+  END_OF_LINE,     //
+  SAVE,            // capture index. Restored when backtracking.
+  MANDATORY_SAVE,  // capture index. Set on every path, so never restored.
+  BACK_REFERENCE,  // group index
+  SPLIT,           // offset. Tries the next instruction, then offset.
+  LOOP,            // offset. Tries offset, then the next instruction.
+  JUMP,            // offset
 };
 
-struct Pattern::BuildResult {
-  BuildResult(PatternComponent *p) : head(p), tail(p) {}
-  BuildResult(PatternComponent *pHead, PatternComponent *pTail)
-      : head(pHead), tail(pTail) {}
+// The next operand of stars is the set of bytes that can follow the star.
+// Bytes >= 128 are always included. Shorter matches skip positions that
+// cannot be followed.
 
-  PatternComponent *head;
-  PatternComponent *tail;
-};
+const size_t CHARACTER_SET_SIZE = 1 + 16;
+const size_t ANY_STAR_SIZE = 1 + 16;
+const size_t CHARACTER_STAR_SIZE = 1 + 16 + 16;
+const size_t JUMP_SIZE = 1 + 2;
 
-//---------------------------------------------------------------------------
+static bool IsInCharacterSet(const uint8_t *mask, uint8_t c) {
+  if (c >= 128) {
+    return false;
+  }
+  return (mask[c / 8] & (1 << (c & 7))) != 0;
+}
 
-Pattern Pattern::Compile(const char *p) {
-  BuildContext context;
-  context.p = p;
-  context.captureIndex = 2;
+static void AddToCharacterSet(uint8_t *mask, uint8_t c) {
+  mask[c / 8] |= 1 << (c & 7);
+}
 
-  PatternComponent *captureStart = new CapturePatternComponent(0);
-  BuildResult result = ParseAlternate(context);
-  captureStart->next = result.head;
-  result.tail->next = new CapturePatternComponent(1);
+static const uint8_t *GetJumpTarget(const uint8_t *pc) {
+  const int16_t offset = int16_t(pc[1] | (pc[2] << 8));
+  return pc + JUMP_SIZE + offset;
+}
 
-  // If this assert is hit, then the entire pattern hasn't been processed.
-  assert(*context.p == '\0');
-  captureStart->RemoveEpsilon();
+static size_t GetInstructionSize(const uint8_t *pc) {
+  switch (*pc) {
+  case TAIL:
+  case LITERAL:
+    return 2 + pc[1];
+  case CHARACTER_SET:
+    return CHARACTER_SET_SIZE;
+  case ANY_STAR:
+    return ANY_STAR_SIZE;
+  case CHARACTER_STAR:
+    return CHARACTER_STAR_SIZE;
+  case SPLIT:
+  case LOOP:
+  case JUMP:
+    return JUMP_SIZE;
+  case BYTE:
+  case SAVE:
+  case MANDATORY_SAVE:
+  case BACK_REFERENCE:
+    return 2;
+  default:
+    return 1;
+  }
+}
 
-  PatternQuickReject quickReject;
-  captureStart->UpdateQuickReject(quickReject);
-  return Pattern(captureStart, quickReject);
+// Returns false if the program at pc definitely cannot match at a position
+// with byte c.
+static bool CanMatch(const uint8_t *pc, uint8_t c) {
+  switch (*pc) {
+  case BYTE:
+    return c == pc[1];
+  case LITERAL:
+    return c == pc[2];
+  case ANY:
+    return c != '\0';
+  case CHARACTER_SET:
+    return IsInCharacterSet(pc + 1, c);
+  case END_OF_LINE:
+    return c == '\0';
+  case SAVE:
+  case MANDATORY_SAVE:
+    return CanMatch(pc + 2, c);
+  case SPLIT:
+    // SPLIT targets are always forward, so this terminates.
+    return CanMatch(pc + JUMP_SIZE, c) || CanMatch(GetJumpTarget(pc), c);
+  default:
+    return true;
+  }
+}
+
+// Adds the bytes that the program at pc can start with to mask.
+// Returns false if they aren't known.
+static bool AddFirstBytes(const uint8_t *pc, uint8_t *mask) {
+  switch (*pc) {
+  case BYTE:
+  case LITERAL: {
+    const uint8_t c = pc[*pc == BYTE ? 1 : 2];
+    if (c < 128) {
+      AddToCharacterSet(mask, c);
+    }
+    return true;
+  }
+  case ANY:
+    for (int c = 1; c < 128; ++c) {
+      AddToCharacterSet(mask, c);
+    }
+    return true;
+  case CHARACTER_SET:
+    for (size_t i = 0; i < 16; ++i) {
+      mask[i] |= pc[1 + i];
+    }
+    return true;
+  case END_OF_LINE:
+    AddToCharacterSet(mask, '\0');
+    return true;
+  case SAVE:
+  case MANDATORY_SAVE:
+    return AddFirstBytes(pc + 2, mask);
+  case SPLIT:
+    return AddFirstBytes(pc + JUMP_SIZE, mask) &&
+           AddFirstBytes(GetJumpTarget(pc), mask);
+  default:
+    return false;
+  }
+}
+
+// Returns true if pc is outside every repeat, optional and alternate.
+static bool IsMandatory(const uint8_t *program, const uint8_t *end,
+                        const uint8_t *pc) {
+  for (const uint8_t *jump = program; jump < end;
+       jump += GetInstructionSize(jump)) {
+    if (*jump != SPLIT && *jump != LOOP && *jump != JUMP) {
+      continue;
+    }
+    const uint8_t *next = jump + JUMP_SIZE;
+    const uint8_t *target = GetJumpTarget(jump);
+    if (next < target ? next <= pc && pc < target
+                      : target <= pc && pc < next) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the last position in [limit, p] that is in next, or nullptr.
+static const char *FindPrevious(const char *p, const char *limit,
+                                const uint8_t *next) {
+  for (;;) {
+    const uint8_t c = *p;
+    if (c >= 128 || IsInCharacterSet(next, c)) {
+      return p;
+    }
+    if (p == limit) {
+      return nullptr;
+    }
+    --p;
+  }
 }
 
 //---------------------------------------------------------------------------
 
-Pattern::BuildResult Pattern::ParseAlternate(BuildContext &c) {
-  BuildResult result = ParseSequence(c);
-  assert(result.head != nullptr);
-  assert(result.tail != nullptr);
-  if (*c.p != '|') {
-    return result;
+struct Pattern::BuildContext {
+  const char *p;
+  int captureIndex;
+  PatternQuickReject quickReject;
+
+  uint8_t *program;
+  size_t length;
+  size_t capacity;
+
+  void Emit(int byte) { *Reserve(1) = byte; }
+  void Emit(int opcode, int operand) {
+    uint8_t *d = Reserve(2);
+    d[0] = opcode;
+    d[1] = operand;
+  }
+  void Emit(const void *data, size_t size) {
+    memcpy(Reserve(size), data, size);
   }
 
-  AlternatePatternComponent *alternate =
-      new AlternatePatternComponent(result.head);
-  EpsilonPatternComponent *epsilon = new EpsilonPatternComponent;
+  // Emits a jump instruction and returns its offset, for use with
+  // SetJumpTarget.
+  size_t EmitJump(PatternOpcode opcode, size_t target = 0) {
+    const size_t offset = length;
+    Emit(opcode);
+    Reserve(2);
+    SetJumpTarget(offset, target);
+    return offset;
+  }
 
-  result.tail->next = epsilon;
+  // Makes space for size bytes at offset, shifting everything after it.
+  uint8_t *Insert(size_t offset, size_t size) {
+    Reserve(size);
+    memmove(program + offset + size, program + offset,
+            length - size - offset);
+    return program + offset;
+  }
 
-  while (*c.p == '|') {
-    c.p++;
-    BuildResult result = ParseSequence(c);
-    assert(result.head != nullptr);
-    assert(result.tail != nullptr);
-    alternate->Add(result.head);
-    result.tail->next = epsilon;
+  void InsertJump(size_t offset, PatternOpcode opcode, size_t target) {
+    *Insert(offset, JUMP_SIZE) = opcode;
+    SetJumpTarget(offset, target);
   }
-  alternate->next = epsilon;
 
-  return BuildResult(alternate, epsilon);
-}
+  void SetJumpTarget(size_t offset, size_t target) {
+    const int relativeTarget = int(target) - int(offset + JUMP_SIZE);
+    assert(INT16_MIN <= relativeTarget && relativeTarget <= INT16_MAX);
+    program[offset + 1] = relativeTarget;
+    program[offset + 2] = relativeTarget >> 8;
+  }
 
-Pattern::BuildResult Pattern::ParseSequence(BuildContext &c) {
-  BuildResult result = ParseQuantifiedAtom(c);
+  void Optimize();
 
-  for (;;) {
-    BuildResult nextElement = ParseQuantifiedAtom(c);
-    if (nextElement.head == nullptr) {
-      return result;
+  uint8_t *Reserve(size_t size) {
+    if (length + size > capacity) {
+      capacity = 2 * capacity + size;
+      program = (uint8_t *)realloc(program, capacity);
     }
+    uint8_t *result = program + length;
+    length += size;
+    return result;
+  }
+
+private:
+  bool IsMandatory(const uint8_t *pc) const;
+  void AddTail();
+};
+
+//---------------------------------------------------------------------------
+
+Pattern Pattern::Compile(const char *p) {
+  BuildContext context = {
+      .p = p,
+      .captureIndex = 2,
+      .quickReject = PatternQuickReject(),
+      .program = nullptr,
+      .length = 0,
+      .capacity = 0,
+  };
+
+  context.Emit(SAVE, 0);
+  ParseAlternate(context);
+  context.Emit(SAVE, 1);
+  context.Emit(MATCH);
+
+  // If this assert is hit, then the entire pattern hasn't been processed.
+  assert(*context.p == '\0');
+  context.Optimize();
+
+  const uint8_t *program =
+      (const uint8_t *)realloc(context.program, context.length);
+  return Pattern(program, context.quickReject);
+}
+
+//---------------------------------------------------------------------------
 
-    result.tail->next = nextElement.head;
-    result.tail = nextElement.tail;
+// a|b|c is compiled as:
+//
+//      SPLIT L1
+//      <a>
+//      JUMP L2
+//  L1: <b|c>
+//  L2:
+void Pattern::ParseAlternate(BuildContext &c) {
+  const size_t start = c.length;
+  const PatternQuickReject quickReject = c.quickReject;
+  ParseSequence(c);
+  assert(c.length != start);
+  if (*c.p != '|') {
+    return;
   }
+  c.p++;
+
+  // Only text required by every alternate can be used for quick rejects.
+  c.InsertJump(start, SPLIT, 0);
+  const size_t jump = c.EmitJump(JUMP);
+  c.SetJumpTarget(start, c.length);
+  ParseAlternate(c);
+  c.SetJumpTarget(jump, c.length);
+  c.quickReject = quickReject;
+}
 
-  return result;
+void Pattern::ParseSequence(BuildContext &c) {
+  while (ParseQuantifiedAtom(c)) {
+  }
 }
 
-Pattern::BuildResult Pattern::ParseQuantifiedAtom(BuildContext &c) {
+bool Pattern::ParseQuantifiedAtom(BuildContext &c) {
   if (c.p[0] == '.') {
     if (c.p[1] == '*') {
       c.p += 2;
-      return BuildResult(new AnyStarPatternComponent);
+      c.Emit(ANY_STAR);
+      c.Reserve(16);
+      return true;
     } else if (c.p[1] == '+') {
       c.p += 2;
-      PatternComponent *any = new AnyPatternComponent;
-      PatternComponent *anyStar = new AnyStarPatternComponent;
-      any->next = anyStar;
-      return BuildResult(any, anyStar);
+      c.Emit(ANY);
+      c.Emit(ANY_STAR);
+      c.Reserve(16);
+      return true;
     }
   }
 
-  BuildResult atom = ParseAtom(c);
-  if (atom.head == nullptr) {
-    return atom;
+  const size_t atomOffset = c.length;
+  const PatternQuickReject quickReject = c.quickReject;
+  if (!ParseAtom(c)) {
+    return false;
   }
 
-  return ParseQuantifier(c, atom);
+  ParseQuantifier(c, atomOffset, quickReject);
+  return true;
 }
 
-Pattern::BuildResult Pattern::ParseAtom(BuildContext &c) {
+bool Pattern::ParseAtom(BuildContext &c) {
   switch (*c.p) {
   case '\0':
   case ')':
   case '|':
-    return BuildResult(nullptr);
+    return false;
   case '^':
     c.p++;
-    return BuildResult(new StartOfLinePatternComponent);
+    c.Emit(START_OF_LINE);
+    return true;
 
   case '$':
     c.p++;
-    return BuildResult(new EndOfLinePatternComponent);
+    c.Emit(END_OF_LINE);
+    return true;
 
   case '(': {
     c.p++;
 
     if (c.p[0] == '?' && c.p[1] == ':') {
       c.p += 2;
-      BuildResult component = ParseAlternate(c);
+      ParseAlternate(c);
       assert(*c.p == ')');
       c.p++;
-      return component;
+      return true;
     }
 
     assert(c.captureIndex < 8);
 
     int captureIndex = c.captureIndex;
     c.captureIndex += 2;
-    PatternComponent *captureStart = new CapturePatternComponent(captureIndex);
-    BuildResult component = ParseAlternate(c);
+    c.Emit(SAVE, captureIndex);
+    ParseAlternate(c);
     assert(*c.p == ')');
     c.p++;
-    captureStart->next = component.head;
-    PatternComponent *captureEnd =
-        new CapturePatternComponent(captureIndex + 1);
-    component.tail->next = captureEnd;
-    return BuildResult(captureStart, captureEnd);
+    c.Emit(SAVE, captureIndex + 1);
+    return true;
   }
   case '\\': {
     c.p++;
     switch (*c.p) {
     case '^':
     case '\\':
-      return BuildResult(new BytePatternComponent(*c.p++));
+      c.quickReject.Update(*c.p);
+      c.Emit(BYTE, *c.p++);
+      return true;
 
     case '1':
     case '2':
     case '3':
-      return BuildResult(new BackReferencePatternComponent(*c.p++ - '0'));
+      c.Emit(BACK_REFERENCE, *c.p++ - '0');
+      return true;
 
     default:
       assert(!"Unhandled symbol");
+      return false;
     }
   }
   case '[': {
-    CharacterSetComponent *component = new CharacterSetComponent();
+    uint8_t mask[16] = {};
     const char *p = c.p + 1;
     while (*p != ']') {
       assert(*p);
 
       if (p[0] == '-' && p[1] != ']') {
         for (int index = p[-1]; index <= p[1]; ++index) {
-          component->SetBit(index);
+          assert(index < 128);
+          AddToCharacterSet(mask, index);
         }
         // Don't increment p here -- this protects against
         // bad input where '-' is at the end of a string and there's
         // no terminating ']'.
       } else {
-        component->SetBit(*p);
+        assert(uint8_t(*p) < 128);
+        AddToCharacterSet(mask, *p);
       }
       ++p;
     }
     c.p = p + 1;
 
-    return BuildResult(component);
+    c.Emit(CHARACTER_SET);
+    c.Emit(mask, sizeof(mask));
+    return true;
   }
   case '.':
     c.p++;
-    return BuildResult(new AnyPatternComponent);
+    c.Emit(ANY);
+    return true;
 
   default:
     const char *pStart = c.p;
     c.p = FindLiteralEnd(pStart);
     size_t length = c.p - pStart;
-    PatternComponent *component;
+    for (size_t i = 0; i < length; ++i) {
+      c.quickReject.Update(pStart[i]);
+    }
     if (length == 1) {
-      component = new BytePatternComponent(*pStart);
+      c.Emit(BYTE, *pStart);
     } else {
-      component = new (length) LiteralPatternComponent(pStart, length);
+      assert(length < 256);
+      c.Emit(LITERAL, length);
+      c.Emit(pStart, length);
     }
-    return BuildResult(component);
+    return true;
   }
 }
 
@@ -233,39 +463,571 @@ const char *Pattern::FindLiteralEnd(const char *p) {
   }
 }
 
-Pattern::BuildResult Pattern::ParseQuantifier(BuildContext &c,
-                                              BuildResult atom) {
-  switch (*c.p) {
-  case '*': {
-    c.p++;
-    BranchPatternComponent *star = new BranchPatternComponent(atom.head);
-    atom.tail->next = star;
+const char *Pattern::FindLiteralTail(const char *pattern, size_t &length) {
+  length = 0;
+  if (Str::Contains(pattern, '|')) {
+    return nullptr;
+  }
 
-    return BuildResult(star);
+  const char *end = pattern + strlen(pattern);
+  if (end == pattern || end[-1] != '$') {
+    return nullptr;
   }
-  case '+': {
-    c.p++;
-    BranchPatternComponent *plus = new BranchPatternComponent(atom.head);
-    atom.tail->next = plus;
+  --end;
 
-    return BuildResult(atom.head, plus);
+  const char *p = end;
+  while (p > pattern) {
+    switch (p[-1]) {
+    case ')':
+    case '(':
+    case '^':
+    case '$':
+    case '\\':
+    case '[':
+    case ']':
+    case '.':
+    case '*':
+    case '+':
+    case '?':
+      goto End;
+    }
+
+    // Escaped characters and back references are not literals.
+    if (p - 1 > pattern && p[-2] == '\\') {
+      goto End;
+    }
+    --p;
   }
 
-  case '?': {
-    c.p++;
-    PatternComponent *epsilon = new EpsilonPatternComponent;
-    BranchPatternComponent *alternate = new BranchPatternComponent(atom.head);
-    alternate->next = epsilon;
-    atom.tail->next = epsilon;
-    return BuildResult(alternate, epsilon);
+End:
+  length = end - p;
+  return length == 0 ? nullptr : p;
+}
+
+// Single character atoms are repeated with CHARACTER_STAR. Otherwise:
+//
+// a* is compiled as:        a+ is compiled as:     a? is compiled as:
+//
+//  L1: SPLIT L2              L1: <a>                   SPLIT L1
+//      <a>                       LOOP L1               <a>
+//      JUMP L1                                     L1:
+//  L2:
+void Pattern::ParseQuantifier(BuildContext &c, size_t atomOffset,
+                              PatternQuickReject atomQuickReject) {
+  const char quantifier = *c.p;
+  if (quantifier != '*' && quantifier != '+' && quantifier != '?') {
+    return;
   }
-  default:
-    return atom;
+  c.p++;
+
+  // Atoms that are optional cannot be used for quick rejects.
+  if (quantifier != '+') {
+    c.quickReject = atomQuickReject;
+  }
+
+  if (quantifier != '?') {
+    uint8_t mask[16] = {};
+    bool isCharacter = false;
+    const uint8_t *atom = c.program + atomOffset;
+    const size_t atomLength = c.length - atomOffset;
+    if (atom[0] == CHARACTER_SET && atomLength == CHARACTER_SET_SIZE) {
+      memcpy(mask, atom + 1, sizeof(mask));
+      isCharacter = true;
+    } else if (atom[0] == BYTE && atomLength == 2 && atom[1] < 128) {
+      AddToCharacterSet(mask, atom[1]);
+      isCharacter = true;
+    }
+
+    if (isCharacter) {
+      if (quantifier == '*') {
+        c.length = atomOffset;
+      }
+      c.Emit(CHARACTER_STAR);
+      c.Emit(mask, sizeof(mask));
+      c.Reserve(16);
+      return;
+    }
+  }
+
+  switch (quantifier) {
+  case '*':
+    c.InsertJump(atomOffset, SPLIT, 0);
+    c.EmitJump(JUMP, atomOffset);
+    c.SetJumpTarget(atomOffset, c.length);
+    break;
+
+  case '+':
+    c.EmitJump(LOOP, atomOffset);
+    break;
+
+  case '?':
+    c.InsertJump(atomOffset, SPLIT, 0);
+    c.SetJumpTarget(atomOffset, c.length);
+    break;
+  }
+}
+
+// Fills in the next operand of stars, converts captures that are run on
+// every path to MANDATORY_SAVE, and adds a TAIL check.
+//
+// Backtracking into a choice point before a mandatory capture always runs
+// the capture again before its value is used, unless a back reference
+// precedes the group.
+void Pattern::BuildContext::Optimize() {
+  const uint8_t *end = program + length;
+  bool hasForwardReference = false;
+  uint32_t referencedGroups = 0;
+  for (const uint8_t *pc = program; pc < end; pc += GetInstructionSize(pc)) {
+    if (*pc == BACK_REFERENCE) {
+      referencedGroups |= 1 << pc[1];
+    } else if (*pc == SAVE && (referencedGroups & (1 << (pc[1] / 2)))) {
+      hasForwardReference = true;
+    }
+  }
+
+  for (uint8_t *pc = program; pc < end; pc += GetInstructionSize(pc)) {
+    switch (*pc) {
+    case ANY_STAR:
+    case CHARACTER_STAR: {
+      const uint8_t *next = pc + GetInstructionSize(pc);
+      uint8_t *nextMask = (uint8_t *)next - 16;
+      memset(nextMask, 0, 16);
+      if (!AddFirstBytes(next, nextMask)) {
+        memset(nextMask, 0xff, 16);
+      }
+    } break;
+
+    case SAVE:
+      if (!hasForwardReference && IsMandatory(pc)) {
+        *pc = MANDATORY_SAVE;
+      }
+      break;
+    }
+  }
+
+  AddTail();
+}
+
+bool Pattern::BuildContext::IsMandatory(const uint8_t *pc) const {
+  return ::IsMandatory(program, program + length, pc);
+}
+
+// Most orthography rules end with literal text and `$`, e.g. ` \^ing$`.
+// Checking that first rejects most inputs without backtracking.
+void Pattern::BuildContext::AddTail() {
+  const size_t MAXIMUM_TAIL_LENGTH = 16;
+  uint8_t tail[MAXIMUM_TAIL_LENGTH];
+  size_t tailLength = 0;
+
+  const uint8_t *end = program + length;
+  for (const uint8_t *pc = program; pc < end; pc += GetInstructionSize(pc)) {
+    switch (*pc) {
+    case SAVE:
+    case MANDATORY_SAVE:
+      continue;
+
+    case BYTE:
+    case LITERAL:
+      if (IsMandatory(pc)) {
+        const uint8_t *text = *pc == BYTE ? pc + 1 : pc + 2;
+        const size_t textLength = *pc == BYTE ? 1 : pc[1];
+        for (size_t i = 0; i < textLength; ++i) {
+          if (tailLength == MAXIMUM_TAIL_LENGTH) {
+            memmove(tail, tail + 1, --tailLength);
+          }
+          tail[tailLength++] = text[i];
+        }
+        continue;
+      }
+      break;
+
+    case END_OF_LINE:
+      if (tailLength != 0 && IsMandatory(pc)) {
+        // Only valid if nothing but captures follows.
+        const uint8_t *next = pc + 1;
+        while (*next == SAVE || *next == MANDATORY_SAVE) {
+          next += 2;
+        }
+        if (*next == MATCH) {
+          uint8_t *d = Insert(0, 2 + tailLength);
+          d[0] = TAIL;
+          d[1] = tailLength;
+          memcpy(d + 2, tail, tailLength);
+          quickReject.SetTail(tail, tailLength);
+          return;
+        }
+      }
+      break;
+    }
+    tailLength = 0;
   }
 }
 
 //---------------------------------------------------------------------------
 
+class Pattern::BacktrackStack {
+public:
+  enum class Type : uint8_t {
+    RETRY,
+    RETRY_SHORTER,
+    RESTORE_CAPTURE,
+  };
+
+  // For RETRY_SHORTER, p is the last position tried and limit is the
+  // shortest position. For RESTORE_CAPTURE, p is the previous value.
+  struct Entry {
+    Type type;
+    uint8_t captureIndex;
+    const uint8_t *pc;
+    const char *p;
+    const char *limit;
+  };
+
+  ~BacktrackStack() {
+    if (entries != inlineEntries) {
+      free(entries);
+    }
+  }
+
+  bool IsEmpty() const { return count == 0; }
+  Entry &Back() { return entries[count - 1]; }
+  void Pop() { --count; }
+
+  void Push(Type type, const uint8_t *pc, const char *p,
+            const char *limit = nullptr, uint8_t captureIndex = 0) {
+    if (count == capacity) {
+      Grow();
+    }
+    Entry &entry = entries[count++];
+    entry.type = type;
+    entry.captureIndex = captureIndex;
+    entry.pc = pc;
+    entry.p = p;
+    entry.limit = limit;
+  }
+
+private:
+  static const size_t INLINE_CAPACITY = 16;
+
+  size_t count = 0;
+  size_t capacity = INLINE_CAPACITY;
+  Entry *entries = inlineEntries;
+  Entry inlineEntries[INLINE_CAPACITY];
+
+  void Grow() {
+    Entry *newEntries = (Entry *)malloc(2 * capacity * sizeof(Entry));
+    memcpy(newEntries, entries, count * sizeof(Entry)); // NOLINT
+    if (entries != inlineEntries) {
+      free(entries);
+    }
+    entries = newEntries;
+    capacity *= 2;
+  }
+};
+
+// Bounds the work done by one match attempt.
+//
+// Once an attempt has taken MEMO_STEP_COUNT steps, (instruction, position)
+// states at branches are recorded. The search is depth first, so reaching a
+// recorded state again means it has already failed, or is an empty loop
+// iteration, and it can fail immediately. This is only valid without
+// back-references, where the outcome from a state doesn't depend on the
+// captures. Attempts with more states than JAVELIN_PATTERN_MEMO_SIZE bytes
+// can record run without the memo.
+class PatternExecutionLimit {
+public:
+
+  // Counts a backtrack or branch. Returns false if the budget is exhausted.
+  bool Step(const uint8_t *program, const char *start) {
+    if (++stepCount < MEMO_STEP_COUNT) {
+      return true;
+    }
+    if (stepCount > JAVELIN_PATTERN_STEP_BUDGET) {
+      return false;
+    }
+    if (stepCount == MEMO_STEP_COUNT) {
+      StartMemo(program, start);
+    }
+    return true;
+  }
+
+  // Returns true if the state has been visited before, and records it.
+  bool Visit(const uint8_t *pc, const char *p) {
+    if (!isMemoEnabled) {
+      return false;
+    }
+    const size_t index = (pc - program) * stride + (p - start);
+    const uint8_t bit = 1 << (index & 7);
+    if (visited[index >> 3] & bit) {
+      return true;
+    }
+    visited[index >> 3] |= bit;
+    return false;
+  }
+
+private:
+  static const size_t MEMO_STEP_COUNT = 64;
+
+  size_t stepCount = 0;
+  bool isMemoEnabled = false;
+  size_t stride;
+  const uint8_t *program;
+  const char *start;
+  uint8_t visited[JAVELIN_PATTERN_MEMO_SIZE];
+
+  void StartMemo(const uint8_t *program, const char *start) {
+    const uint8_t *pc = program;
+    while (*pc != MATCH) {
+      if (*pc == BACK_REFERENCE) {
+        return;
+      }
+      pc += GetInstructionSize(pc);
+    }
+
+    const size_t textLength = strlen(start);
+    const size_t byteCount = ((pc - program) * (textLength + 1) + 7) / 8;
+    if (byteCount > sizeof(visited)) {
+      return;
+    }
+
+    this->program = program;
+    this->start = start;
+    stride = textLength + 1;
+    memset(visited, 0, byteCount);
+    isMemoEnabled = true;
+  }
+};
+
+static std::atomic<uint32_t> stepBudgetOverrunCount;
+
+size_t Pattern::GetStepBudgetOverrunCount() {
+  return stepBudgetOverrunCount.load(std::memory_order_relaxed);
+}
+
+bool Pattern::Execute(const char *p, const char *start,
+                      const char **captures) const {
+  using Type = BacktrackStack::Type;
+
+  BacktrackStack stack;
+  PatternExecutionLimit executionLimit;
+  const uint8_t *pc = program;
+  const char *limit;
+
+  for (;;) {
+    switch (*pc) {
+    case MATCH:
+      return true;
+
+    case TAIL: {
+      const size_t length = pc[1];
+      const size_t textLength = strlen(p);
+      if (textLength < length ||
+          memcmp(p + textLength - length, pc + 2, length) != 0) {
+        return false;
+      }
+      pc += 2 + length;
+      continue;
+    }
+
+    case BYTE:
+      if (*p != char(pc[1])) {
+        goto Fail;
+      }
+      ++p;
+      pc += 2;
+      continue;
+
+    case LITERAL: {
+      const size_t length = pc[1];
+      if (strncmp(p, (const char *)pc + 2, length) != 0) {
+        goto Fail;
+      }
+      p += length;
+      pc += 2 + length;
+      continue;
+    }
+
+    case ANY:
+      if (*p == '\0') {
+        goto Fail;
+      }
+      ++p;
+      ++pc;
+      continue;
+
+    case ANY_STAR:
+      if (executionLimit.Visit(pc, p)) {
+        goto Fail;
+      }
+      limit = p;
+      p += strlen(p);
+      pc += ANY_STAR_SIZE;
+      goto Star;
+
+    case CHARACTER_STAR:
+      if (executionLimit.Visit(pc, p)) {
+        goto Fail;
+      }
+      limit = p;
+      while (IsInCharacterSet(pc + 1, *p)) {
+        ++p;
+      }
+      pc += CHARACTER_STAR_SIZE;
+
+    Star:
+      // next is the last operand of both star instructions.
+      p = FindPrevious(p, limit, pc - 16);
+      if (p == nullptr) {
+        goto Fail;
+      }
+      if (p != limit) {
+        stack.Push(Type::RETRY_SHORTER, pc, p, limit);
+      }
+      continue;
+
+    case CHARACTER_SET:
+      if (!IsInCharacterSet(pc + 1, *p)) {
+        goto Fail;
+      }
+      ++p;
+      pc += CHARACTER_SET_SIZE;
+      continue;
+
+    case START_OF_LINE:
+      if (p != start) {
+        goto Fail;
+      }
+      ++pc;
+      continue;
+
+    case END_OF_LINE:
+      if (*p != '\0') {
+        goto Fail;
+      }
+      ++pc;
+      continue;
+
+    case MANDATORY_SAVE:
+      captures[pc[1]] = p;
+      pc += 2;
+      continue;
+
+    case SAVE: {
+      const size_t index = pc[1];
+      // Without a choice point, failure ends the match, so there is
+      // nothing to restore.
+      if (!stack.IsEmpty()) {
+        stack.Push(Type::RESTORE_CAPTURE, nullptr, captures[index], nullptr,
+                   index);
+      }
+      captures[index] = p;
+      pc += 2;
+      continue;
+    }
+
+    case BACK_REFERENCE: {
+      const size_t index = pc[1];
+      const char *compareP = captures[index * 2];
+      const char *compareEnd = captures[index * 2 + 1];
+      while (compareP < compareEnd) {
+        if (*p != *compareP) {
+          goto Fail;
+        }
+        ++p;
+        ++compareP;
+      }
+      pc += 2;
+      continue;
+    }
+
+    case SPLIT: {
+      if (!executionLimit.Step(program, start)) {
+        goto Overrun;
+      }
+      if (executionLimit.Visit(pc, p)) {
+        goto Fail;
+      }
+
+      // Branches that would fail immediately are skipped without a
+      // choice point.
+      const uint8_t *target = GetJumpTarget(pc);
+      pc += JUMP_SIZE;
+      if (!CanMatch(pc, *p)) {
+        pc = target;
+      } else if (CanMatch(target, *p)) {
+        stack.Push(Type::RETRY, target, p);
+      }
+      continue;
+    }
+
+    case LOOP:
+      if (!executionLimit.Step(program, start)) {
+        goto Overrun;
+      }
+      if (executionLimit.Visit(pc, p)) {
+        goto Fail;
+      }
+      stack.Push(Type::RETRY, pc + JUMP_SIZE, p);
+      pc = GetJumpTarget(pc);
+      continue;
+
+    case JUMP:
+      pc = GetJumpTarget(pc);
+      continue;
+
+    default:
+      assert(!"Invalid opcode");
+      return false;
+    }
+
+  Fail:
+    for (;;) {
+      if (stack.IsEmpty()) {
+        return false;
+      }
+      BacktrackStack::Entry &entry = stack.Back();
+      switch (entry.type) {
+      case Type::RESTORE_CAPTURE:
+        captures[entry.captureIndex] = entry.p;
+        stack.Pop();
+        continue;
+
+      case Type::RETRY:
+        pc = entry.pc;
+        p = entry.p;
+        stack.Pop();
+        break;
+
+      case Type::RETRY_SHORTER:
+        pc = entry.pc;
+        p = entry.p - 1;
+        p = FindPrevious(p, entry.limit, pc - 16);
+        if (p == nullptr) {
+          stack.Pop();
+          continue;
+        }
+        entry.p = p;
+        if (p == entry.limit) {
+          stack.Pop();
+        }
+        break;
+      }
+      break;
+    }
+    if (!executionLimit.Step(program, start)) {
+      goto Overrun;
+    }
+  }
+
+Overrun:
+  stepBudgetOverrunCount.store(
+      stepBudgetOverrunCount.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+  return false;
+}
+
+//---------------------------------------------------------------------------
+
 PatternMatch Pattern::Match(const char *text) const {
   PatternQuickReject textReject(text);
   if (!textReject.IsPossibleMatch(quickReject)) {
@@ -291,74 +1053,224 @@ PatternMatch Pattern::MatchBypassingQuickReject(const char *text) const {
   result.captures[6] = nullptr;
   result.captures[7] = nullptr;
 
-  PatternContext context = {
-      .start = text,
-      .captureList = result.captures,
-  };
-  result.match = root->Match(text, context);
+  result.match = Execute(text, text, result.captures);
   return result;
 }
 
 PatternMatch Pattern::Search(const char *text) const {
   PatternMatch result;
-  PatternContext context = {
-      .start = text,
-      .captureList = result.captures,
-  };
+  const char *start = text;
   do {
-    result.match = root->Match(text, context);
+    // Failed attempts can leave captures set.
+    for (const char *&capture : result.captures) {
+      capture = nullptr;
+    }
+    result.match = Execute(text, start, result.captures);
   } while (!result.match && *text++ != '\0');
   return result;
 }
 
+bool Pattern::GetNeighborBytes(const char *text, uint8_t *before,
+                               uint8_t *after) const {
+  const size_t MAXIMUM_TEXT_LENGTH = 7;
+  const size_t textLength = strlen(text);
+  assert(0 < textLength && textLength <= MAXIMUM_TEXT_LENGTH);
+
+  const uint8_t *end = program;
+  while (*end != MATCH) {
+    end += GetInstructionSize(end);
+  }
+
+  // The masks of the most recent bytes that every match has at a fixed
+  // distance from each other.
+  uint8_t history[MAXIMUM_TEXT_LENGTH + 1][16];
+  size_t historyLength = 0;
+
+  for (const uint8_t *pc = program; pc < end; pc += GetInstructionSize(pc)) {
+    const uint8_t opcode = *pc;
+    if (opcode == TAIL || opcode == SAVE || opcode == MANDATORY_SAVE) {
+      continue;
+    }
+    if ((opcode != BYTE && opcode != LITERAL && opcode != CHARACTER_SET) ||
+        !IsMandatory(program, end, pc)) {
+      historyLength = 0;
+      continue;
+    }
+
+    const size_t byteCount = opcode == LITERAL ? pc[1] : 1;
+    for (size_t i = 0; i < byteCount; ++i) {
+      if (historyLength == MAXIMUM_TEXT_LENGTH + 1) {
+        memmove(history, history + 1, MAXIMUM_TEXT_LENGTH * sizeof(*history));
+        --historyLength;
+      }
+      uint8_t *mask = history[historyLength++];
+      if (opcode == CHARACTER_SET) {
+        memcpy(mask, pc + 1, 16);
+      } else {
+        memset(mask, 0, 16);
+        const uint8_t c = pc[opcode == BYTE ? 1 : 2 + i];
+        if (c < 128) {
+          AddToCharacterSet(mask, c);
+        }
+      }
+
+      if (historyLength < textLength) {
+        continue;
+      }
+      const uint8_t(*textHistory)[16] = history + historyLength - textLength;
+      bool isText = true;
+      for (size_t j = 0; j < textLength; ++j) {
+        uint8_t textMask[16] = {};
+        AddToCharacterSet(textMask, text[j]);
+        if (memcmp(textHistory[j], textMask, 16) != 0) {
+          isText = false;
+          break;
+        }
+      }
+      if (!isText) {
+        continue;
+      }
+
+      if (historyLength > textLength) {
+        for (size_t j = 0; j < 16; ++j) {
+          before[j] |= textHistory[-1][j];
+        }
+      } else {
+        memset(before, 0xff, 16);
+      }
+
+      if (i + 1 < byteCount) {
+        if (pc[3 + i] < 128) {
+          AddToCharacterSet(after, pc[3 + i]);
+        }
+      } else if (!AddFirstBytes(pc + GetInstructionSize(pc), after)) {
+        memset(after, 0xff, 16);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 char *Pattern::Replace(char *text, const char *format) const {
   const PatternMatch match = Search(text);
   if (!match.match) {
     return text;
   }
-  char *prefix = Str::DupN(text, match.captures[0] - text);
-  char *suffix =
-      Str::DupN(match.captures[1], text + strlen(text) - match.captures[1]);
-  char *replacement = match.Replace(format);
 
-  char *result = Str::Join(prefix, replacement, suffix, nullptr);
-  free(prefix);
-  free(suffix);
-  free(replacement);
+  const size_t prefixLength = match.captures[0] - text;
+  const size_t suffixLength = strlen(match.captures[1]);
+  const size_t replacementLength = match.Replace(format, nullptr, 0);
+
+  char *result =
+      (char *)malloc(prefixLength + replacementLength + suffixLength + 1);
+  memcpy(result, text, prefixLength);
+  match.Replace(format, result + prefixLength, replacementLength + 1);
+  memcpy(result + prefixLength + replacementLength, match.captures[1],
+         suffixLength + 1);
   free(text);
   return result;
 }
 
-//---------------------------------------------------------------------------
+// Appends to buffer, truncating to bufferSize - 1 bytes. length tracks the
+// untruncated length.
+static void AppendBounded(char *buffer, size_t bufferSize, size_t &length,
+                          const char *p, size_t count) {
+  if (length + 1 < bufferSize) {
+    const size_t available = bufferSize - 1 - length;
+    memcpy(buffer + length, p, count < available ? count : available);
+  }
+  length += count;
+}
 
-char *PatternMatch::Replace(const char *format) const {
-  assert(match);
+static void TerminateBounded(char *buffer, size_t bufferSize, size_t length) {
+  if (bufferSize != 0) {
+    buffer[length < bufferSize ? length : bufferSize - 1] = '\0';
+  }
+}
 
-  char *buffer = (char *)malloc(256);
-  char *d = buffer;
-  for (;;) {
-    switch (*format) {
-    case '\0':
-      *d++ = '\0';
-      assert(d <= buffer + 256);
-      return (char *)realloc(buffer, d - buffer);
+// Calls f(p, count) for each literal run and capture reference in format.
+template <typename F>
+static void ForEachReplacementPart(const PatternMatch &match,
+                                   const char *format, F &&f) {
+  assert(match.match);
 
-    case '\\': {
-      ++format;
-      int index = *format - '0';
+  for (;;) {
+    const char *literalStart = format;
+    while (*format != '\0' && *format != '\\') {
       ++format;
-      assert(0 <= index && index < 4);
-      const char *start = captures[index * 2];
-      const char *end = captures[index * 2 + 1];
-      memcpy(d, start, end - start);
-      d += end - start;
-    } break;
-
-    default:
-      *d++ = *format++;
-      break;
     }
+    f(literalStart, format - literalStart);
+    if (*format == '\0') {
+      return;
+    }
+
+    const int index = format[1] - '0';
+    format += 2;
+    assert(0 <= index && index < 4);
+    const char *start = match.captures[index * 2];
+    const char *end = match.captures[index * 2 + 1];
+    f(start, end - start);
+  }
+}
+
+static void AppendReplacement(const PatternMatch &match, const char *format,
+                              char *buffer, size_t bufferSize,
+                              size_t &length) {
+  ForEachReplacementPart(match, format, [&](const char *p, size_t count) {
+    AppendBounded(buffer, bufferSize, length, p, count);
+  });
+}
+
+size_t Pattern::Replace(const char *text, const char *format, char *buffer,
+                        size_t bufferSize) const {
+  const PatternMatch match = Search(text);
+  size_t length = 0;
+  if (!match.match) {
+    AppendBounded(buffer, bufferSize, length, text, strlen(text));
+  } else {
+    AppendBounded(buffer, bufferSize, length, text, match.captures[0] - text);
+    AppendReplacement(match, format, buffer, bufferSize, length);
+    AppendBounded(buffer, bufferSize, length, match.captures[1],
+                  strlen(match.captures[1]));
   }
+  TerminateBounded(buffer, bufferSize, length);
+  return length;
+}
+
+void Pattern::Replace(IWriter &writer, const char *text,
+                      const char *format) const {
+  const PatternMatch match = Search(text);
+  if (!match.match) {
+    writer.Write(text, strlen(text));
+    return;
+  }
+  writer.Write(text, match.captures[0] - text);
+  match.Replace(writer, format);
+  writer.Write(match.captures[1], strlen(match.captures[1]));
+}
+
+//---------------------------------------------------------------------------
+
+char *PatternMatch::Replace(const char *format) const {
+  const size_t length = Replace(format, nullptr, 0);
+  char *result = (char *)malloc(length + 1);
+  Replace(format, result, length + 1);
+  return result;
+}
+
+size_t PatternMatch::Replace(const char *format, char *buffer,
+                             size_t bufferSize) const {
+  size_t length = 0;
+  AppendReplacement(*this, format, buffer, bufferSize, length);
+  TerminateBounded(buffer, bufferSize, length);
+  return length;
+}
+
+void PatternMatch::Replace(IWriter &writer, const char *format) const {
+  ForEachReplacementPart(*this, format, [&](const char *p, size_t count) {
+    writer.Write(p, count);
+  });
 }
 
 //---------------------------------------------------------------------------
@@ -415,6 +1327,165 @@ TEST_BEGIN("Pattern: Backreference Test") {
 }
 TEST_END
 
+TEST_BEGIN("Pattern: Backtracking test") {
+  // Alternates are tried in order, and captures from failed alternates are
+  // restored.
+  const Pattern pattern = Pattern::Compile("(a|ab)(c|bcd)(d*)");
+  const char *abcd = "abcd";
+  const PatternMatch match = pattern.Match(abcd);
+  assert(match.match);
+  assert(match.captures[2] == abcd && match.captures[3] == abcd + 1);
+  assert(match.captures[4] == abcd + 1 && match.captures[5] == abcd + 4);
+  assert(match.captures[6] == abcd + 4 && match.captures[7] == abcd + 4);
+
+  const Pattern groupRepeat = Pattern::Compile("^(?:ab|a)+b$");
+  assert(groupRepeat.Match("b").match == false);
+  assert(groupRepeat.Match("aab").match);
+  assert(groupRepeat.Match("abab").match);
+
+  const Pattern optional = Pattern::Compile("^x?[b-d]*e$");
+  assert(optional.Match("e").match);
+  assert(optional.Match("xbcde").match);
+  assert(optional.Match("xxe").match == false);
+}
+TEST_END
+
+TEST_BEGIN("Pattern: Search and Replace test") {
+  const Pattern pattern = Pattern::Compile("(ab)+c");
+  const char *text = "xababcd";
+  const PatternMatch match = pattern.Search(text);
+  assert(match.match);
+  assert(match.captures[0] == text + 1 && match.captures[1] == text + 6);
+  assert(match.captures[2] == text + 3 && match.captures[3] == text + 5);
+
+  char *t1 = pattern.Replace(Str::Dup(text), "<\\1>");
+  assert(strcmp(t1, "x<ab>d") == 0);
+  free(t1);
+}
+TEST_END
+
+TEST_BEGIN("Pattern: Step budget test") {
+  // Empty loop iterations used to loop forever.
+  const Pattern emptyLoop = Pattern::Compile("^(?:a*)*$");
+  assert(emptyLoop.Match("aaa").match);
+  assert(!emptyLoop.Match("aaab").match);
+
+  // Exponential without failure memoization.
+  const Pattern alternation = Pattern::Compile("^(a|aa)*$");
+  assert(alternation.Match("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa").match);
+  assert(!alternation.Match("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab").match);
+
+  // Back-references can't be memoized, so this runs out of steps.
+  const size_t overrunCount = Pattern::GetStepBudgetOverrunCount();
+  const Pattern backReferences =
+      Pattern::Compile("^(.*)(.*)(.*)\\1\\2\\3$");
+  assert(!backReferences.Match("abababababababababababababababababababababb")
+              .match);
+  assert(Pattern::GetStepBudgetOverrunCount() == overrunCount + 1);
+
+  // Text with more states than the memo holds runs without it.
+  char longText[8 * JAVELIN_PATTERN_MEMO_SIZE + 2];
+  memset(longText, 'a', sizeof(longText) - 2);
+  longText[sizeof(longText) - 2] = 'b';
+  longText[sizeof(longText) - 1] = '\0';
+  assert(!alternation.Match(longText).match);
+  assert(Pattern::GetStepBudgetOverrunCount() == overrunCount + 2);
+}
+TEST_END
+
+TEST_BEGIN("Pattern: Buffer and writer Replace test") {
+  const Pattern pattern = Pattern::Compile("(ab)+c");
+  const char *text = "xababcd";
+  const PatternMatch match = pattern.Search(text);
+
+  char buffer[8];
+  assert(match.Replace("<\\1>", buffer, sizeof(buffer)) == 4);
+  assert(strcmp(buffer, "<ab>") == 0);
+  assert(match.Replace("<\\1\\1>", buffer, 4) == 6);
+  assert(strcmp(buffer, "<ab") == 0);
+  assert(match.Replace("<\\1>", nullptr, 0) == 4);
+
+  assert(pattern.Replace(text, "<\\1>", buffer, sizeof(buffer)) == 6);
+  assert(strcmp(buffer, "x<ab>d") == 0);
+  assert(pattern.Replace(text, "<\\1>", buffer, 3) == 6);
+  assert(strcmp(buffer, "x<") == 0);
+  assert(pattern.Replace("xyz", "<\\1>", buffer, sizeof(buffer)) == 3);
+  assert(strcmp(buffer, "xyz") == 0);
+
+  BufferWriter writer;
+  pattern.Replace(writer, text, "<\\1>");
+  match.Replace(writer, "[\\0]");
+  assert(writer.GetCount() == 13);
+  assert(memcmp(writer.GetBuffer(), "x<ab>d[ababc]", 13) == 0);
+}
+TEST_END
+
+TEST_BEGIN("Pattern: FindLiteralTail test") {
+  size_t length;
+  const char *tail = Pattern::FindLiteralTail("^(.*)ing$", length);
+  assert(length == 3 && strncmp(tail, "ing", 3) == 0);
+
+  tail = Pattern::FindLiteralTail("^(.*[aeiou])\\1ies$", length);
+  assert(length == 3 && strncmp(tail, "ies", 3) == 0);
+
+  assert(Pattern::FindLiteralTail("^(.*)ings?$", length) == nullptr);
+  assert(Pattern::FindLiteralTail("^(.*)(?:s|es)$", length) == nullptr);
+  assert(Pattern::FindLiteralTail("^(.*)s", length) == nullptr);
+}
+TEST_END
+
+TEST_BEGIN("Pattern: Quick reject test") {
+  static const struct {
+    const char *pattern;
+    const char *text;
+    bool isPossibleMatch;
+  } CASES[] = {
+      {"^(.*)'s \\^s$", "dog's ^s", true},
+      {"^(.*)'s \\^s$", "dogs ^s", false},
+      {"^(.*)9(.*)$", "19th", true},
+      {"^(.*)9(.*)$", "10th", false},
+      {"^Mc(.*)$", "McDonald", true},
+      {"^Mc(.*)$", "mcdonald", false},
+      {"^(.*) \\^ing$", "walk ^ing", true},
+      {"^(.*) \\^ing$", "walking ^ed", false},
+      {"^(.*) \\^ing$", "ing", false},
+      {"^(.*)e \\^ing$", "make ^ing", true},
+      {"^(.*)e \\^ing$", "mak ^ing", false},
+      {"^(.*) \\^ings?$", "walking ^ed", true},
+  };
+  for (const auto &c : CASES) {
+    const Pattern pattern = Pattern::Compile(c.pattern);
+    assert(pattern.IsPossibleMatch(PatternQuickReject(c.text)) ==
+           c.isPossibleMatch);
+    if (!c.isPossibleMatch) {
+      assert(!pattern.Match(c.text).match);
+    }
+  }
+}
+TEST_END
+
+TEST_BEGIN("Pattern: GetNeighborBytes test") {
+  uint8_t before[16] = {};
+  uint8_t after[16] = {};
+  const Pattern pattern = Pattern::Compile(
+      R"(^(.*(?:[bcdfghjklmnprstvwxyz]|qu)[aeiou])([bcdfgklmnprtvz]) \^([aeiouy].*)$)");
+  assert(pattern.GetNeighborBytes(" ^", before, after));
+  assert(IsInCharacterSet(before, 'g') && !IsInCharacterSet(before, 'h'));
+  assert(IsInCharacterSet(after, 'y') && !IsInCharacterSet(after, 's'));
+
+  memset(before, 0, sizeof(before));
+  memset(after, 0, sizeof(after));
+  const Pattern literalPattern = Pattern::Compile(R"(^(.*)e \^(?:ed|ing)$)");
+  assert(literalPattern.GetNeighborBytes(" ^", before, after));
+  assert(IsInCharacterSet(before, 'e') && !IsInCharacterSet(before, 'd'));
+  assert(IsInCharacterSet(after, 'e') && IsInCharacterSet(after, 'i'));
+  assert(!IsInCharacterSet(after, 'a'));
+
+  const Pattern optionalPattern = Pattern::Compile(R"(^(.*)(?: \^s)?$)");
+  assert(!optionalPattern.GetNeighborBytes(" ^", before, after));
+}
+TEST_END
+
 TEST_BEGIN("Pattern: Orthography example test") {
   const Pattern pattern = Pattern::Compile(
       R"(^(.*(?:[bcdfghjklmnprstvwxyz]|qu)[aeiou])([bcdfgklmnprtvz]) \^ ([aeiouy].*)$)");
@@ -427,3 +1498,101 @@ TEST_END
 // spellchecker: enable
 
 //---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+#include "benchmark.h"
+#include "orthography.h"
+
+// spellchecker: disable
+static const char *const ORTHOGRAPHY_INPUTS[] = {
+    "make ^ed",   "kiss ^s",     "defer ^ed",   "test ^ing",
+    "carry ^s",   "carry ^ed",   "fix ^s",      "make ^ing",
+    "die ^ing",   "basic ^ly",   "run ^ing",    "cat ^s",
+    "wish ^s",    "beauty ^ful", "comfortable ^ly", "hope ^ed",
+    "real ^ly",   "go ^ing",     "dance ^er",   "admit ^ed",
+    "agree ^ed",  "act ^or",     "simple ^ly",  "quit ^ing",
+};
+// spellchecker: enable
+
+// Applies the rules in order to each input, stopping at the first match,
+// as StenoCompiledOrthography does.
+static void BenchmarkOrthographyRules(const StenoOrthography &orthography,
+                                      const Pattern *&patterns) {
+  const size_t ruleCount = orthography.ruleCount;
+  if (patterns == nullptr) {
+    Pattern *compiledPatterns =
+        (Pattern *)malloc(sizeof(Pattern) * ruleCount);
+    for (size_t i = 0; i < ruleCount; ++i) {
+      compiledPatterns[i] = Pattern::Compile(orthography.rules[i].testPattern);
+    }
+    patterns = compiledPatterns;
+  }
+
+  for (const char *input : ORTHOGRAPHY_INPUTS) {
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    for (size_t i = 0; i < ruleCount; ++i) {
+      const PatternMatch match = patterns[i].Match(input);
+      if (match.match) {
+        free(match.Replace(orthography.rules[i].replacement));
+        break;
+      }
+    }
+    Benchmark::AddSample("time (ns)", Benchmark::GetNanoseconds() - startTime);
+  }
+}
+
+BENCHMARK_BEGIN("Pattern: sample-orthography.json rules") {
+  static const Pattern *patterns = nullptr;
+  BenchmarkOrthographyRules(sampleOrthography, patterns);
+}
+BENCHMARK_END
+
+BENCHMARK_BEGIN("Pattern: English orthography rules") {
+  static const Pattern *patterns = nullptr;
+  BenchmarkOrthographyRules(testOrthography, patterns);
+}
+BENCHMARK_END
+
+struct BenchmarkPathologicalCase {
+  const char *pattern;
+  const char *input;
+};
+
+// Patterns and inputs that backtrack exponentially or polynomially without
+// the step budget and failure memoization.
+static const BenchmarkPathologicalCase PATHOLOGICAL_CASES[] = {
+    {R"(^(a|aa)*$)", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"},
+    {R"(^(?:a*)*$)", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"},
+    {R"(^(?:.*a)*$)", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"},
+    {R"(^(.*)(.*)(.*)(?:.*)(?:.*)x(?:.*)y$)",
+     "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaxaaay"},
+    {R"(^(.*)(.*)(.*)\1\2\3$)", "abababababababababababababababababababababb"},
+};
+
+BENCHMARK_BEGIN("Pattern: Pathological rules") {
+  static const Pattern *patterns = nullptr;
+  if (patterns == nullptr) {
+    const size_t count =
+        sizeof(PATHOLOGICAL_CASES) / sizeof(*PATHOLOGICAL_CASES); // NOLINT
+    Pattern *compiledPatterns = (Pattern *)malloc(sizeof(Pattern) * count);
+    for (size_t i = 0; i < count; ++i) {
+      compiledPatterns[i] = Pattern::Compile(PATHOLOGICAL_CASES[i].pattern);
+    }
+    patterns = compiledPatterns;
+  }
+
+  size_t i = 0;
+  for (const BenchmarkPathologicalCase &c : PATHOLOGICAL_CASES) {
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    patterns[i++].Match(c.input);
+    Benchmark::AddSample("time (ns)", Benchmark::GetNanoseconds() - startTime);
+  }
+}
+BENCHMARK_END
+
+#endif
+
+//---------------------------------------------------------------------------
@@ -3,10 +3,27 @@
 #pragma once
 #include "pattern_quick_reject.h"
 #include <stddef.h>
+#include <stdint.h>
 
 //---------------------------------------------------------------------------
 
-class PatternComponent;
+// The maximum number of backtracks and branches in one match attempt.
+// Attempts that exceed it fail, and are counted by
+// Pattern::GetStepBudgetOverrunCount().
+#ifndef JAVELIN_PATTERN_STEP_BUDGET
+#define JAVELIN_PATTERN_STEP_BUDGET 4096
+#endif
+
+// Bytes of stack for the failure memo used by match attempts that take many
+// steps. Each bit is one (instruction, text position) state, and attempts
+// with more states than fit run without the memo.
+#ifndef JAVELIN_PATTERN_MEMO_SIZE
+#define JAVELIN_PATTERN_MEMO_SIZE 256
+#endif
+
+//---------------------------------------------------------------------------
+
+class IWriter;
 
 //---------------------------------------------------------------------------
 
@@ -14,13 +31,21 @@ struct PatternMatch {
   bool match;
   const char *captures[8];
 
+  // Returns a new string.
   char *Replace(const char *format) const;
 
+  // Writes as much of the replacement as fits in buffer, always null
+  // terminating if bufferSize is not 0. Returns the full length of the
+  // replacement, excluding the null, as snprintf does.
+  size_t Replace(const char *format, char *buffer, size_t bufferSize) const;
+
+  // Writes the replacement without a null terminator.
+  void Replace(IWriter &writer, const char *format) const;
+
   friend class Pattern;
 };
 
 // Super simple regex implementation tailored to embedded steno.
-// This whole thing compiles to less than 4kb.
 //
 // Many typical regex library things are missing here, since they're just
 // not needed. And the approaches chosen are NOT appropriate for more
@@ -29,10 +54,19 @@ struct PatternMatch {
 // But it *DOES* support group captures, which is the key thing missing
 // from other tiny regex libraries.
 //
+// Patterns are compiled to a flat bytecode program that is run with an
+// explicit backtrack stack, so matching does not recurse and alternatives
+// are tried in the same order as a recursive backtracking matcher would.
+// Single character repeats such as `[aeiou]*` are a table lookup loop, and
+// patterns ending in literal text and `$` check the end of the text first.
+//
 // Notes:
 //
-// * It relies on tail call optimizations kicking in to avoid excessive
-//   stack usage.
+// * Captures are only valid if the match succeeds.
+//
+// * Matching is bounded by JAVELIN_PATTERN_STEP_BUDGET. Patterns without
+//   back-references also record failed states once a match has backtracked
+//   for a while, so most pathological rules finish well within it.
 //
 // * There isn't even proper cleanup here, because it won't be used.
 class Pattern {
@@ -46,27 +80,53 @@ public:
   // Will free text if there's a replacement and return a new string.
   char *Replace(char *text, const char *format) const;
 
+  // Replaces the first match in text. These follow the conventions of the
+  // PatternMatch::Replace variants.
+  size_t Replace(const char *text, const char *format, char *buffer,
+                 size_t bufferSize) const;
+  void Replace(IWriter &writer, const char *text, const char *format) const;
+
+  // Returns the number of match attempts that have exceeded
+  // JAVELIN_PATTERN_STEP_BUDGET.
+  static size_t GetStepBudgetOverrunCount();
+
   bool IsPossibleMatch(PatternQuickReject inputQuickReject) const {
     return inputQuickReject.IsPossibleMatch(quickReject);
   }
 
+  // Returns the literal text that must occur immediately before a trailing
+  // `$`, e.g. `ing` for `^(.*)ing$`. Returns nullptr with length 0 if
+  // there is no such text, or if the pattern has alternates.
+  static const char *FindLiteralTail(const char *pattern, size_t &length);
+
+  // Finds text that every match contains, and adds the bytes that can occur
+  // immediately before and after it to the 128-bit masks before and after.
+  // Unknown neighbors add every byte. Bytes >= 128 are never added, and
+  // should be assumed to be possible. Returns false if there is no such
+  // text.
+  bool GetNeighborBytes(const char *text, uint8_t *before,
+                        uint8_t *after) const;
+
 private:
-  Pattern(PatternComponent *root, PatternQuickReject quickReject)
-      : root(root), quickReject(quickReject) {}
+  Pattern(const uint8_t *program, PatternQuickReject quickReject)
+      : program(program), quickReject(quickReject) {}
 
-  PatternComponent *root;
+  const uint8_t *program;
   PatternQuickReject quickReject;
 
   struct BuildContext;
-  struct BuildResult;
+  class BacktrackStack;
 
-  static BuildResult ParseAlternate(BuildContext &c);
-  static BuildResult ParseSequence(BuildContext &c);
-  static BuildResult ParseQuantifiedAtom(BuildContext &c);
-  static BuildResult ParseAtom(BuildContext &c);
-  static BuildResult ParseQuantifier(BuildContext &c, BuildResult atom);
+  static void ParseAlternate(BuildContext &c);
+  static void ParseSequence(BuildContext &c);
+  static bool ParseQuantifiedAtom(BuildContext &c);
+  static bool ParseAtom(BuildContext &c);
+  static void ParseQuantifier(BuildContext &c, size_t atomOffset,
+                              PatternQuickReject atomQuickReject);
 
   static const char *FindLiteralEnd(const char *p);
+
+  bool Execute(const char *p, const char *start, const char **captures) const;
 };
 
 //---------------------------------------------------------------------------
@@ -1,50 +1,86 @@
 //---------------------------------------------------------------------------
 
+#include <stddef.h>
 #include <stdint.h>
 
 //---------------------------------------------------------------------------
 
+// Pattern quick rejects hold the characters a pattern requires, and the
+// text it must end with. Input quick rejects hold the characters present in
+// the text, and its last four bytes.
+//
+// Characters are tracked as one bit each for a-z, A-Z and 0-9, one for
+// apostrophes, and one shared by all other punctuation. Spaces and `^` are
+// not tracked, since every orthography rule and input contains them.
+//
+// On arm, each half of the mask is instead set with a single 32-bit shift
+// of c - 'a' and c - 'A'. That tracks letters and some punctuation, but not
+// digits or apostrophes, and avoids 64-bit shifts, which are library calls
+// on Cortex-M0.
 class PatternQuickReject {
 public:
   PatternQuickReject() = default;
-  PatternQuickReject(const char *p) { Update(p); }
+  PatternQuickReject(const char *p) {
+    while (*p) {
+      const int c = (uint8_t)*p++;
+      Update(c);
+      tail = (tail << 8) | c;
+    }
+  }
 
   void Update(int c) {
 #if JAVELIN_CPU_CORTEX_M0 || JAVELIN_CPU_CORTEX_M4
     // On arm, shifting by more than the width results in 0.
-    mask |= 1 << (c - 'a');
+    const uint32_t lowerBit = 1 << (c - 'a');
+    const uint32_t upperBit = 1 << (c - 'A');
+    mask |= (uint64_t(upperBit) << 32) | lowerBit;
 #else
-    // On x86, shifting only uses the lowest bits.
-    if ('a' <= c && c <= 'z') {
-      mask |= 1 << (c - 'a');
-    }
+    mask |= GetBit(c);
 #endif
   }
 
-  void Update(const char *p) {
-    while (*p) {
-      Update(*p++);
+  // Sets the text a pattern must end with. Only the last four bytes are
+  // used.
+  void SetTail(const uint8_t *text, size_t length) {
+    tail = 0;
+    tailMask = 0;
+    const size_t start = length > 4 ? length - 4 : 0;
+    for (size_t i = start; i < length; ++i) {
+      tail = (tail << 8) | text[i];
+      tailMask = (tailMask << 8) | 0xff;
     }
   }
 
   bool IsPossibleMatch(const PatternQuickReject patternQuickReject) const {
-    return (patternQuickReject.mask & ~mask) == 0;
+    return (patternQuickReject.mask & ~mask) == 0 &&
+           (tail & patternQuickReject.tailMask) == patternQuickReject.tail;
   }
 
 private:
-  uint32_t mask = 0;
+  uint64_t mask = 0;
+  uint32_t tail = 0;
+  uint32_t tailMask = 0;
 
-  static void Update(int c, uint32_t &mask) {
-#if JAVELIN_CPU_CORTEX_M0 || JAVELIN_CPU_CORTEX_M4
-    // On arm, shifting by more than the width results in 0.
-    mask |= ~(1 << (c - 'a'));
-#else
-    // On x86, shifting only uses the lowest bits.
+#if !(JAVELIN_CPU_CORTEX_M0 || JAVELIN_CPU_CORTEX_M4)
+  static uint64_t GetBit(int c) {
     if ('a' <= c && c <= 'z') {
-      mask |= ~(1 << (c - 'a'));
+      return 1ull << (c - 'a');
     }
-#endif
+    if ('A' <= c && c <= 'Z') {
+      return 1ull << (c - 'A' + 26);
+    }
+    if ('0' <= c && c <= '9') {
+      return 1ull << (c - '0' + 52);
+    }
+    if (c == '\'') {
+      return 1ull << 62;
+    }
+    if (' ' < c && c < 0x7f && c != '^') {
+      return 1ull << 63;
+    }
+    return 0;
   }
+#endif
 };
 
 //---------------------------------------------------------------------------
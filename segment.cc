@@ -2,6 +2,7 @@
 
 #include "segment.h"
 #include "str.h"
+#include "stroke_arena.h"
 
 //---------------------------------------------------------------------------
 
@@ -17,6 +18,50 @@ StenoSegmentList::~StenoSegmentList() {
   for (size_t i = 0; i < count; ++i) {
     (*this)[i].lookup.Destroy();
   }
+  ReleaseArenaBuffer();
+}
+
+void StenoSegmentList::Add(const StenoSegment &segment) {
+  if (count != GetCapacity(count)) {
+    List::Add(segment);
+    return;
+  }
+
+  const size_t newSize = GetCapacity(count + 1) * sizeof(StenoSegment);
+  uint8_t *newBuffer = (uint8_t *)StrokeArena::Allocate(newSize);
+  if (newBuffer == nullptr) {
+    newBuffer = (uint8_t *)malloc(newSize);
+  }
+  if (count != 0) {
+    memcpy(newBuffer, buffer, count * sizeof(StenoSegment));
+  }
+  memcpy(newBuffer + count * sizeof(StenoSegment), &segment,
+         sizeof(StenoSegment));
+  ++count;
+
+  ReleaseArenaBuffer();
+  free(buffer);
+  buffer = newBuffer;
+}
+
+void StenoSegmentList::Clear() {
+  for (size_t i = 0; i < count; ++i) {
+    (*this)[i].lookup.Destroy();
+  }
+  Reset();
+}
+
+void StenoSegmentList::Reset() {
+  ReleaseArenaBuffer();
+  List::Reset();
+}
+
+// Arena buffers are released with the arena, so are dropped rather than
+// freed.
+void StenoSegmentList::ReleaseArenaBuffer() {
+  if (StrokeArena::Contains(buffer)) {
+    buffer = nullptr;
+  }
 }
 
 size_t StenoSegmentList::GetCommonStartingSegmentsCount(StenoSegmentList &a,
@@ -59,38 +104,28 @@ bool StenoSegmentList::HasManualStateChange() const {
 }
 //---------------------------------------------------------------------------
 
-class StenoSegmentListTokenizer final : public StenoTokenizer {
-public:
-  StenoSegmentListTokenizer(const StenoSegmentList &list, size_t startingOffset)
-      : list(list), elementIndex(startingOffset) {
-    if (list.IsEmpty()) {
-      p = elementText = nullptr;
-    } else {
-      p = "";
-      PrepareNextP();
-    }
-  }
-  virtual ~StenoSegmentListTokenizer() {
-    if (scratch) {
-      free(scratch);
-    }
+StenoSegmentListTokenizer::StenoSegmentListTokenizer(
+    const StenoSegmentList &list, size_t startingOffset)
+    : list(list), elementIndex(startingOffset) {
+  if (list.IsEmpty()) {
+    p = elementText = nullptr;
+  } else {
+    p = "";
+    PrepareNextP();
   }
+}
 
-  bool HasMore() const final { return p != nullptr; }
-
-  StenoToken GetNext() final;
-
-private:
-  const StenoSegmentList &list;
-  size_t elementIndex;
-  const char *elementText;
-  const char *p;
-  const StenoState *nextState = nullptr;
-
-  char *scratch = nullptr;
-
-  void PrepareNextP();
-};
+const char *StenoSegmentListTokenizer::SetScratch(const char *start,
+                                                  size_t length) {
+  if (length < SCRATCH_SIZE) {
+    memcpy(scratch, start, length);
+    scratch[length] = '\0';
+    return scratch;
+  }
+  free(heapScratch);
+  heapScratch = Str::DupN(start, length);
+  return heapScratch;
+}
 
 StenoToken StenoSegmentListTokenizer::GetNext() {
   const StenoState *state = nextState;
@@ -121,11 +156,10 @@ StenoToken StenoSegmentListTokenizer::GetNext() {
 
       case '\\':
         if (p[1] == '\0') {
-          free(scratch);
-          scratch = Str::DupN(start, p - start);
+          const char *result = SetScratch(start, p - start);
           ++p;
           PrepareNextP();
-          return StenoToken(scratch, state);
+          return StenoToken(result, state);
         }
         p += 2;
         break;
@@ -139,8 +173,7 @@ StenoToken StenoSegmentListTokenizer::GetNext() {
 ReturnSpan:
   const char *result = elementText;
   if (start != elementText || *p != '\0') {
-    free(scratch);
-    result = scratch = Str::DupN(start, p - start);
+    result = SetScratch(start, p - start);
   }
 
   PrepareNextP();
@@ -166,10 +199,6 @@ void StenoSegmentListTokenizer::PrepareNextP() {
   }
 }
 
-StenoTokenizer *StenoSegmentList::CreateTokenizer(size_t startingOffset) {
-  return new StenoSegmentListTokenizer(*this, startingOffset);
-}
-
 //---------------------------------------------------------------------------
 //---------------------------------------------------------------------------
 
@@ -196,14 +225,41 @@ TEST_BEGIN("Segment tests") {
 
   history.CreateSegments(context);
 
-  StenoTokenizer *tokenizer = segmentList.CreateTokenizer();
+  StenoSegmentListTokenizer tokenizer(segmentList);
+
+  assert(tokenizer.HasMore());
+  assert(Str::Eq(tokenizer.GetNext().text, "test"));
+  assert(tokenizer.HasMore());
+  assert(Str::Eq(tokenizer.GetNext().text, "{^ing}"));
+  assert(!tokenizer.HasMore());
+}
+TEST_END
+
+//---------------------------------------------------------------------------
+
+TEST_BEGIN("StenoSegmentListTokenizer: Copies long words") {
+  const char *const TEXT = "short "
+                           "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                           "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                           "{^}";
+  StenoState state;
+  state.Reset();
+
+  StenoSegmentList segmentList;
+  segmentList.Add(StenoSegment(
+      1, &state, StenoDictionaryLookupResult::CreateStaticString(TEXT)));
+
+  StenoSegmentListTokenizer tokenizer(segmentList);
+  StenoToken token = tokenizer.GetNext();
+  assert(Str::Eq(token.text, "short"));
+  assert(token.state == &state);
+
+  token = tokenizer.GetNext();
+  assert(Str::Length(token.text) == 80);
+  assert(token.state == nullptr);
 
-  assert(tokenizer->HasMore());
-  assert(Str::Eq(tokenizer->GetNext().text, "test"));
-  assert(tokenizer->HasMore());
-  assert(Str::Eq(tokenizer->GetNext().text, "{^ing}"));
-  assert(!tokenizer->HasMore());
-  delete tokenizer;
+  assert(Str::Eq(tokenizer.GetNext().text, "{^}"));
+  assert(!tokenizer.HasMore());
 }
 TEST_END
 
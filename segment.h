@@ -3,7 +3,6 @@
 #pragma once
 #include "dictionary/dictionary.h"
 #include "list.h"
-#include "malloc_allocate.h"
 #include "state.h"
 
 //---------------------------------------------------------------------------
@@ -45,29 +44,86 @@ struct StenoToken {
   const StenoState *state;
 };
 
-class StenoTokenizer : public JavelinMallocAllocate {
-public:
-  virtual ~StenoTokenizer() {}
-
-  virtual bool HasMore() const = 0;
-  virtual StenoToken GetNext() = 0;
-};
-
-//---------------------------------------------------------------------------
-
-class StenoSegmentList : public List<StenoSegment> {
+// Segment storage grows into the active StrokeArena, so List is a private
+// base: its Add and Reset would free arena memory.
+class StenoSegmentList : private List<StenoSegment> {
 public:
   StenoSegmentList() = default;
   StenoSegmentList(StenoSegmentList &&other)
       : List((List<StenoSegment> &&) other) {}
   ~StenoSegmentList();
 
-  StenoTokenizer *CreateTokenizer(size_t startingOffset = 0);
+  using List::Back;
+  using List::Front;
+  using List::GetCount;
+  using List::IsEmpty;
+  using List::IsNotEmpty;
+  using List::operator[];
+  using List::Pop;
+  using List::RemoveFront;
+
+  void Swap(StenoSegmentList &other) { List::Swap(other); }
+
+  friend const StenoSegment *begin(const StenoSegmentList &list) {
+    return begin((const List &)list);
+  }
+  friend const StenoSegment *end(const StenoSegmentList &list) {
+    return end((const List &)list);
+  }
+  friend StenoSegment *begin(StenoSegmentList &list) {
+    return begin((List &)list);
+  }
+  friend StenoSegment *end(StenoSegmentList &list) { return end((List &)list); }
+
+  // Grows into the active StrokeArena when there is one.
+  void Add(const StenoSegment &segment);
+
+  // Destroys the segments' lookups and empties the list.
+  void Clear();
+
+  // Empties the list without destroying the segments' lookups.
+  void Reset();
 
   static size_t GetCommonStartingSegmentsCount(StenoSegmentList &a,
                                                StenoSegmentList &b);
 
   bool HasManualStateChange() const;
+
+private:
+  void ReleaseArenaBuffer();
+};
+
+//---------------------------------------------------------------------------
+
+// Splits the text of segments into words and commands.
+//
+// Tokens that are the whole text of a segment are returned directly, and
+// others are copied into scratch, so are only valid until the next call to
+// GetNext().
+class StenoSegmentListTokenizer {
+public:
+  StenoSegmentListTokenizer(const StenoSegmentList &list,
+                            size_t startingOffset = 0);
+  ~StenoSegmentListTokenizer() { free(heapScratch); }
+
+  bool HasMore() const { return p != nullptr; }
+  StenoToken GetNext();
+
+private:
+  static const size_t SCRATCH_SIZE = 64;
+
+  const StenoSegmentList &list;
+  size_t elementIndex;
+  const char *elementText;
+  const char *p;
+  const StenoState *nextState = nullptr;
+
+  // Tokens too long for scratch are copied to the heap.
+  char *heapScratch = nullptr;
+  char scratch[SCRATCH_SIZE];
+
+  const char *SetScratch(const char *start, size_t length);
+  void PrepareNextP();
 };
 
 //---------------------------------------------------------------------------
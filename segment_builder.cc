@@ -6,6 +6,7 @@
 #include "orthography.h"
 #include "segment.h"
 #include "str.h"
+#include "stroke_arena.h"
 #include "stroke_history.h"
 #include "unicode.h"
 #include "writer.h"
@@ -21,6 +22,82 @@ BuildSegmentContext::BuildSegmentContext(
 
 //---------------------------------------------------------------------------
 
+StenoSegmentLookupCache::~StenoSegmentLookupCache() { Clear(); }
+
+void StenoSegmentLookupCache::Clear() {
+  for (Entry &entry : entries) {
+    entry.startLength = 0;
+    entry.lookup.Destroy();
+    entry.lookup = StenoDictionaryLookupResult::CreateInvalid();
+  }
+}
+
+void StenoSegmentLookupCache::ClearIfContentChanged() {
+  const uint32_t currentGeneration = StenoDictionary::GetContentGeneration();
+  if (contentGeneration != currentGeneration) {
+    Clear();
+    contentGeneration = currentGeneration;
+  }
+}
+
+uint16_t
+StenoSegmentLookupCache::GetDefinitionStartMask(const StenoState *states,
+                                                size_t length) {
+  uint16_t mask = 0;
+  for (size_t i = 0; i < length; ++i) {
+    if (states[i].isDefinitionStart) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+
+bool StenoSegmentLookupCache::Find(const StenoStroke *strokes,
+                                   const StenoState *states,
+                                   size_t startLength, size_t &resultLength,
+                                   StenoDictionaryLookupResult &lookup) {
+  if (startLength > MAXIMUM_LENGTH) {
+    return false;
+  }
+
+  ClearIfContentChanged();
+  const Entry &entry = GetEntry(strokes, startLength);
+  if (entry.startLength != startLength ||
+      entry.definitionStartMask !=
+          GetDefinitionStartMask(states, startLength) ||
+      memcmp(entry.strokes, strokes, startLength * sizeof(StenoStroke)) != 0) {
+    ++missCount;
+    return false;
+  }
+
+  ++hitCount;
+  resultLength = entry.resultLength;
+  lookup = entry.lookup.Clone();
+  return true;
+}
+
+void StenoSegmentLookupCache::Add(const StenoStroke *strokes,
+                                  const StenoState *states,
+                                  size_t startLength, size_t resultLength,
+                                  const StenoDictionaryLookupResult &lookup) {
+  if (startLength > MAXIMUM_LENGTH) {
+    return;
+  }
+
+  ClearIfContentChanged();
+  Entry &entry = GetEntry(strokes, startLength);
+  entry.lookup.Destroy();
+  entry.lookup = resultLength == 0
+                     ? StenoDictionaryLookupResult::CreateInvalid()
+                     : lookup.CloneToHeap();
+  entry.startLength = startLength;
+  entry.resultLength = resultLength;
+  entry.definitionStartMask = GetDefinitionStartMask(states, startLength);
+  memcpy(entry.strokes, strokes, startLength * sizeof(StenoStroke));
+}
+
+//---------------------------------------------------------------------------
+
 void StenoSegmentBuilder::TransferStartFrom(const StenoSegmentBuilder &source,
                                             size_t count) {
   memcpy(strokes, source.strokes, count * sizeof(StenoStroke));
@@ -28,6 +105,14 @@ void StenoSegmentBuilder::TransferStartFrom(const StenoSegmentBuilder &source,
   hasModifiedStrokeHistory = false;
 }
 
+void StenoSegmentBuilder::TransferEndFrom(const StenoSegmentBuilder &source,
+                                          size_t offset) {
+  count = source.count - offset;
+  memcpy(strokes, source.strokes + offset, count * sizeof(StenoStroke));
+  memcpy(states, source.states + offset, count * sizeof(StenoState));
+  hasModifiedStrokeHistory = false;
+}
+
 void StenoSegmentBuilder::TransferFrom(const StenoStrokeHistory &source,
                                        size_t sourceStrokeCount,
                                        size_t maxCount) {
@@ -80,6 +165,23 @@ bool StenoSegmentBuilder::DirectLookup(BuildSegmentContext &context,
     startLength = context.maximumOutlineLength;
   }
 
+  StenoSegmentLookupCache *const lookupCache = context.lookupCache;
+  if (lookupCache) {
+    size_t cachedLength;
+    StenoDictionaryLookupResult cachedLookup =
+        StenoDictionaryLookupResult::CreateInvalid();
+    if (lookupCache->Find(strokes + offset, states + offset, startLength,
+                          cachedLength, cachedLookup)) {
+      if (cachedLength == 0) {
+        return false;
+      }
+      context.segmentList.Add(
+          StenoSegment(cachedLength, states + offset, cachedLookup));
+      offset += cachedLength;
+      return true;
+    }
+  }
+
   size_t length = startLength;
   while (length > 0) {
     StenoDictionaryLookupResult lookup =
@@ -146,11 +248,19 @@ bool StenoSegmentBuilder::DirectLookup(BuildSegmentContext &context,
       }
     }
 
+    if (lookupCache) {
+      lookupCache->Add(strokes + offset, states + offset, startLength, length,
+                       lookup);
+    }
     context.segmentList.Add(StenoSegment(length, states + offset, lookup));
     offset += length;
     return true;
   }
 
+  if (lookupCache) {
+    lookupCache->Add(strokes + offset, states + offset, startLength, 0,
+                     StenoDictionaryLookupResult::CreateInvalid());
+  }
   return false;
 }
 
@@ -242,11 +352,11 @@ StenoSegment StenoSegmentBuilder::AutoSuffixTest(BuildSegmentContext &context,
 
         if (lookup.IsValid()) {
           const char *text = lookup.GetText();
-          const char *result = Str::Join(text, suffix.text, nullptr);
+          const char *result = StrokeArena::Join(text, suffix.text);
           lookup.Destroy();
           return StenoSegment(
               length, states + offset,
-              StenoDictionaryLookupResult::CreateDynamicString(result));
+              StenoDictionaryLookupResult::CreateStrokeString(result));
         }
       }
     }
@@ -270,7 +380,8 @@ void StenoSegmentBuilder::AddRawStroke(BuildSegmentContext &context,
   strokes[offset].ToString(buffer);
   context.segmentList.Add(StenoSegment(
       1, states + offset,
-      StenoDictionaryLookupResult::CreateDynamicString(Str::Dup(buffer))));
+      StenoDictionaryLookupResult::CreateStrokeString(
+          StrokeArena::Dup(buffer))));
   ++offset;
 }
 
@@ -9,6 +9,18 @@
 
 //---------------------------------------------------------------------------
 
+// Number of cached segment lookups. Each entry is 72 bytes on arm, and 88
+// bytes on 64-bit hosts.
+#ifndef JAVELIN_SEGMENT_LOOKUP_CACHE_SIZE
+#if JAVELIN_CPU_CORTEX_M0 || JAVELIN_CPU_CORTEX_M4
+#define JAVELIN_SEGMENT_LOOKUP_CACHE_SIZE 32
+#else
+#define JAVELIN_SEGMENT_LOOKUP_CACHE_SIZE 64
+#endif
+#endif
+
+//---------------------------------------------------------------------------
+
 struct StenoSegment;
 class IWriter;
 class StenoCompiledOrthography;
@@ -16,6 +28,67 @@ class StenoStrokeHistory;
 
 //---------------------------------------------------------------------------
 
+// Remembers the outcome of DirectLookup, so that segments which cannot be
+// affected by a new stroke are not looked up again on every stroke.
+//
+// Entries are keyed by the strokes and definition boundaries that the lookup
+// examined rather than by builder offset, so they stay valid as the
+// conversion window moves through the stroke history and after history
+// pruning. Segments starting within maximumOutlineLength of the end of the
+// window examine a different number of strokes after each new stroke, so
+// they miss and are re-evaluated, as are auto-suffixes and retro commands,
+// which are never cached.
+class StenoSegmentLookupCache {
+public:
+  ~StenoSegmentLookupCache();
+
+  // Returns true if a previous lookup of strokes/states with the same
+  // startLength is known. resultLength is 0 if no definition was found,
+  // otherwise lookup is a clone of the definition found.
+  bool Find(const StenoStroke *strokes, const StenoState *states,
+            size_t startLength, size_t &resultLength,
+            StenoDictionaryLookupResult &lookup);
+  void Add(const StenoStroke *strokes, const StenoState *states,
+           size_t startLength, size_t resultLength,
+           const StenoDictionaryLookupResult &lookup);
+
+  void Clear();
+
+  size_t GetHitCount() const { return hitCount; }
+  size_t GetMissCount() const { return missCount; }
+
+  static const size_t MAXIMUM_LENGTH = 16;
+  static const size_t ENTRY_COUNT = JAVELIN_SEGMENT_LOOKUP_CACHE_SIZE;
+
+private:
+  struct Entry {
+    Entry() : lookup(StenoDictionaryLookupResult::CreateInvalid()) {}
+
+    uint8_t startLength = 0; // 0 for unused entries.
+    uint8_t resultLength;
+    uint16_t definitionStartMask;
+    StenoStroke strokes[MAXIMUM_LENGTH];
+    StenoDictionaryLookupResult lookup;
+  };
+
+  size_t hitCount = 0;
+  size_t missCount = 0;
+
+  // Entries are all cleared when the dictionary content changes.
+  uint32_t contentGeneration = StenoDictionary::GetContentGeneration();
+  Entry entries[ENTRY_COUNT];
+
+  void ClearIfContentChanged();
+
+  static uint16_t GetDefinitionStartMask(const StenoState *states,
+                                         size_t length);
+  Entry &GetEntry(const StenoStroke *strokes, size_t length) {
+    return entries[StenoStroke::Hash(strokes, length) % ENTRY_COUNT];
+  }
+};
+
+//---------------------------------------------------------------------------
+
 struct BuildSegmentContext {
   BuildSegmentContext(StenoSegmentList &segmentList,
                       const StenoDictionary &dictionary,
@@ -25,6 +98,7 @@ struct BuildSegmentContext {
   const StenoDictionary &dictionary;
   const size_t maximumOutlineLength;
   const StenoCompiledOrthography &orthography;
+  StenoSegmentLookupCache *lookupCache = nullptr;
 };
 
 //---------------------------------------------------------------------------
@@ -32,6 +106,7 @@ struct BuildSegmentContext {
 class StenoSegmentBuilder {
 public:
   bool IsNotEmpty() const { return count != 0; }
+  size_t GetCount() const { return count; }
 
   void Add(StenoStroke stroke, StenoState state) {
     strokes[count] = stroke;
@@ -40,6 +115,10 @@ public:
   }
 
   void TransferStartFrom(const StenoSegmentBuilder &source, size_t count);
+
+  // Copies source's strokes from offset onwards, so that source's segments
+  // can be moved to this builder.
+  void TransferEndFrom(const StenoSegmentBuilder &source, size_t offset);
   void TransferFrom(const StenoStrokeHistory &source, size_t sourceStrokeCount,
                     size_t maxCount);
 
@@ -16,25 +16,155 @@ void StenoKeyCodeBuffer::Reset() {
   addTranslationCount = 0;
   resetStateCount = 0;
   state.Reset();
+  modifiedIndex = NOT_MODIFIED;
+  checkpointStart = 0;
+  checkpointCount = 0;
 }
 
-void StenoKeyCodeBuffer::Populate(StenoTokenizer *tokenizer) {
+// Only the live prefix of buffer is copied.
+void StenoKeyCodeBuffer::operator=(const StenoKeyCodeBuffer &o) {
+  assert(o.count <= capacity);
+  count = o.count;
+  addTranslationCount = o.addTranslationCount;
+  resetStateCount = o.resetStateCount;
+  state = o.state;
+  memcpy(buffer, o.buffer, count * sizeof(StenoKeyCode));
+  modifiedIndex = o.modifiedIndex;
+  checkpointStart = o.checkpointStart;
+  checkpointCount = o.checkpointCount;
+  assert(checkpointCount <= checkpointCapacity);
+  memcpy(checkpoints, o.checkpoints, checkpointCount * sizeof(Checkpoint));
+}
+
+void StenoKeyCodeBuffer::Populate(StenoSegmentList &segmentList,
+                                  size_t startingOffset) {
   Reset();
-  Append(tokenizer);
+  checkpointStart = startingOffset;
+  AppendSegments(segmentList, startingOffset);
+}
+
+size_t StenoKeyCodeBuffer::Resume(const StenoKeyCodeBuffer &source,
+                                  StenoSegmentList &segmentList,
+                                  size_t resumeOffset) {
+  assert(resumeOffset >= source.checkpointStart);
+  checkpointStart = source.checkpointStart;
+  size_t index = resumeOffset - checkpointStart;
+  if (index >= source.checkpointCount) {
+    if (source.checkpointCount == 0) {
+      Populate(segmentList, checkpointStart);
+      return checkpointStart;
+    }
+    index = source.checkpointCount - 1;
+  }
+  while (index != 0 && !source.IsCheckpointReusable(index)) {
+    --index;
+  }
+
+  assert(index <= checkpointCapacity);
+  const Checkpoint &checkpoint = source.checkpoints[index];
+  count = checkpoint.count;
+  addTranslationCount = checkpoint.addTranslationCount;
+  resetStateCount = checkpoint.resetStateCount;
+  state = checkpoint.state;
+  modifiedIndex = NOT_MODIFIED;
+  checkpointCount = index;
+  if (&source != this) {
+    memcpy(buffer, source.buffer, count * sizeof(StenoKeyCode));
+    memcpy(checkpoints, source.checkpoints, index * sizeof(Checkpoint));
+  }
+
+  AppendSegments(segmentList, checkpointStart + index);
+  return checkpointStart + index;
 }
 
-void StenoKeyCodeBuffer::Append(StenoTokenizer *tokenizer) {
-  while (tokenizer->HasMore()) {
-    StenoToken token = tokenizer->GetNext();
+bool StenoKeyCodeBuffer::RemoveFrontSegments(size_t segmentCount) {
+  if (segmentCount <= checkpointStart) {
+    checkpointStart -= segmentCount;
+    return true;
+  }
+
+  const size_t index = segmentCount - checkpointStart;
+  if (index >= checkpointCount || !IsCheckpointReusable(index)) {
+    return false;
+  }
+
+  const size_t removedCount = checkpoints[index].count;
+  count -= removedCount;
+  memmove(buffer, buffer + removedCount, count * sizeof(StenoKeyCode));
+
+  checkpointStart = 0;
+  checkpointCount -= index;
+  memmove(checkpoints, checkpoints + index,
+          checkpointCount * sizeof(Checkpoint));
+  for (size_t i = 0; i < checkpointCount; ++i) {
+    checkpoints[i].count -= removedCount;
+    if (checkpoints[i].modifiedIndex != NOT_MODIFIED) {
+      checkpoints[i].modifiedIndex -= removedCount;
+    }
+  }
+  return true;
+}
+
+// Each segment's first token carries its state, which is where checkpoints
+// are recorded. Segments without text have no tokens, so share the
+// checkpoint of the segment that follows them.
+void StenoKeyCodeBuffer::AppendSegments(StenoSegmentList &segmentList,
+                                        size_t startingOffset) {
+  size_t segmentIndex = startingOffset;
+  StenoSegmentListTokenizer tokenizer(segmentList, startingOffset);
+  while (tokenizer.HasMore()) {
+    StenoToken token = tokenizer.GetNext();
     if (token.state != nullptr) {
+      while (segmentIndex < segmentList.GetCount() &&
+             segmentList[segmentIndex].state <= token.state) {
+        AddCheckpoint();
+        ++segmentIndex;
+      }
       state = *token.state;
     }
-    if (token.text[0] == '{') {
-      ProcessCommand(token.text);
-    } else {
-      ProcessText(token.text);
+    ProcessToken(token.text);
+  }
+
+  // The checkpoint after the last segment allows appending to the list.
+  while (segmentIndex <= segmentList.GetCount()) {
+    AddCheckpoint();
+    ++segmentIndex;
+  }
+}
+
+void StenoKeyCodeBuffer::AddCheckpoint() {
+  if (checkpointCount != 0) {
+    Checkpoint &previous = checkpoints[checkpointCount - 1];
+    if (modifiedIndex < previous.modifiedIndex) {
+      previous.modifiedIndex = modifiedIndex;
     }
   }
+  modifiedIndex = NOT_MODIFIED;
+
+  // Later segments can only be resumed from the last checkpoint, which
+  // accumulates their changes.
+  if (checkpointCount == checkpointCapacity) {
+    return;
+  }
+
+  Checkpoint &checkpoint = checkpoints[checkpointCount++];
+  checkpoint.count = count;
+  checkpoint.addTranslationCount = addTranslationCount;
+  checkpoint.resetStateCount = resetStateCount;
+  checkpoint.modifiedIndex = NOT_MODIFIED;
+  checkpoint.state = state;
+}
+
+// A checkpoint can be reused only if no later segment rewrote the key codes
+// before it, e.g. with an orthographic suffix or retroactive command.
+bool StenoKeyCodeBuffer::IsCheckpointReusable(size_t index) const {
+  const size_t keyCodeCount = checkpoints[index].count;
+  for (size_t i = index; i < checkpointCount; ++i) {
+    if (checkpoints[i].modifiedIndex < keyCodeCount) {
+      return false;
+    }
+  }
+  return true;
 }
 
 //---------------------------------------------------------------------------
@@ -100,7 +230,7 @@ void StenoKeyCodeBuffer::AppendTextNoCaseModeOverride(const char *p, size_t n,
         c = '\t';
         break;
       default:
-        buffer[count++] = StenoKeyCode('\\', StenoCaseMode::NORMAL);
+        AppendKeyCode(StenoKeyCode('\\', StenoCaseMode::NORMAL));
         caseMode = GetNextLetterCaseMode(caseMode);
       }
     }
@@ -108,7 +238,7 @@ void StenoKeyCodeBuffer::AppendTextNoCaseModeOverride(const char *p, size_t n,
     if (c == '\b') {
       Backspace(1);
     } else {
-      buffer[count++] = StenoKeyCode(c, caseMode, StenoCaseMode::NORMAL);
+      AppendKeyCode(StenoKeyCode(c, caseMode, StenoCaseMode::NORMAL));
     }
 
     caseMode = GetNextLetterCaseMode(caseMode);
@@ -346,7 +476,11 @@ const char *StenoKeyCodeBuffer::AddParameter(List<char *> &parameters,
 void StenoKeyCodeBuffer::ProcessOrthographicSuffix(const char *text,
                                                    size_t length) {
   char orthographicScratchPad[32];
-  char *suffix = Str::DupN(text, length);
+  char suffixBuffer[32];
+  char *suffix = length < sizeof(suffixBuffer) ? suffixBuffer
+                                               : (char *)malloc(length + 1);
+  memcpy(suffix, text, length);
+  suffix[length] = '\0';
 
   size_t start = count;
   size_t byteCount = 1; // Need one byte for terminating null.
@@ -366,7 +500,9 @@ void StenoKeyCodeBuffer::ProcessOrthographicSuffix(const char *text,
   }
   utf8p.Set(0);
 
-  char *word = orthography->AddSuffix(orthographicScratchPad, suffix);
+  char wordBuffer[64];
+  char *word = orthography->AddSuffix(orthographicScratchPad, suffix,
+                                      wordBuffer, sizeof(wordBuffer));
 
   count = start;
 
@@ -384,6 +520,7 @@ void StenoKeyCodeBuffer::ProcessOrthographicSuffix(const char *text,
     ++pWord;
     ++pScratchPad;
   }
+  MarkModified(count);
   if (state.caseMode == StenoCaseMode::NORMAL) {
     state.caseMode = GetNextLetterCaseMode(caseMode);
   }
@@ -391,8 +528,12 @@ void StenoKeyCodeBuffer::ProcessOrthographicSuffix(const char *text,
   AppendTextNoCaseModeOverride(pWord, strlen(pWord), state.caseMode);
   state.caseMode = state.GetNextWordCaseMode();
 
-  free(word);
-  free(suffix);
+  if (word != wordBuffer) {
+    free(word);
+  }
+  if (suffix != suffixBuffer) {
+    free(suffix);
+  }
 }
 
 //---------------------------------------------------------------------------
@@ -472,14 +613,14 @@ bool StenoKeyCodeBuffer::ProcessKeyPresses(const char *p, const char *end) {
     case StenoKeyPressToken::Type::KEY: {
       KeyCode keyCode = token.keyCode;
       if (keyCode != 0) {
-        buffer[count++] = StenoKeyCode::CreateRawKeyCodePress(keyCode);
+        AppendKeyCode(StenoKeyCode::CreateRawKeyCodePress(keyCode));
       }
       if (tokenizer.PeekNextTokenType() ==
           StenoKeyPressToken::Type::OPEN_PAREN) {
         keyPressStack.Add(keyCode);
         tokenizer.GetNext();
       } else {
-        buffer[count++] = StenoKeyCode::CreateRawKeyCodeRelease(keyCode);
+        AppendKeyCode(StenoKeyCode::CreateRawKeyCodeRelease(keyCode));
       }
     } break;
 
@@ -494,7 +635,7 @@ bool StenoKeyCodeBuffer::ProcessKeyPresses(const char *p, const char *end) {
       }
       KeyCode keyCode = keyPressStack.Back();
       if (keyCode != 0) {
-        buffer[count++] = StenoKeyCode::CreateRawKeyCodeRelease(keyCode);
+        AppendKeyCode(StenoKeyCode::CreateRawKeyCodeRelease(keyCode));
       }
       keyPressStack.Pop();
     } break;
@@ -511,7 +652,7 @@ void StenoKeyCodeBuffer::ReleaseKeyStack(List<KeyCode> &keyPressStack) {
   while (keyPressStack.IsNotEmpty()) {
     KeyCode keyCode = keyPressStack.Back();
     if (keyCode != 0) {
-      buffer[count++] = StenoKeyCode::CreateRawKeyCodeRelease(keyCode);
+      AppendKeyCode(StenoKeyCode::CreateRawKeyCodeRelease(keyCode));
     }
     keyPressStack.Pop();
   }
@@ -524,7 +665,7 @@ void StenoKeyCodeBuffer::ReleaseKeyStack(List<KeyCode> &keyPressStack) {
 #include "unit_test.h"
 
 TEST_BEGIN("StenoKeyCodeBuffer tests") {
-  StenoKeyCodeBuffer *buffer = new StenoKeyCodeBuffer();
+  StaticStenoKeyCodeBuffer<> *buffer = new StaticStenoKeyCodeBuffer<>();
 
   const char *test = "Shift_L(h a p) p y";
   buffer->ProcessKeyPresses(test, test + strlen(test));
@@ -549,3 +690,96 @@ TEST_BEGIN("StenoKeyCodeBuffer tests") {
 TEST_END
 
 //---------------------------------------------------------------------------
+
+static void VerifyResumedBuffer(const StenoKeyCodeBuffer &resumed,
+                                StenoSegmentList &segmentList) {
+  StaticStenoKeyCodeBuffer<> *expected = new StaticStenoKeyCodeBuffer<>();
+  expected->Populate(segmentList, resumed.GetStartingOffset());
+
+  assert(resumed.count == expected->count);
+  for (size_t i = 0; i < resumed.count; ++i) {
+    assert(resumed.buffer[i] == expected->buffer[i]);
+  }
+  delete expected;
+}
+
+TEST_BEGIN("StenoKeyCodeBuffer: Resume from checkpoints") {
+  StenoState states[4];
+  for (StenoState &state : states) {
+    state.Reset();
+  }
+  const char *const previousTexts[] = {"one", "two", "{*-|}"};
+  const char *const nextTexts[] = {"one", "two", "three", "{*-|}"};
+
+  StenoSegmentList previousList;
+  const StenoState *state = states;
+  for (const char *text : previousTexts) {
+    previousList.Add(StenoSegment(
+        1, state++, StenoDictionaryLookupResult::CreateStaticString(text)));
+  }
+  StenoSegmentList nextList;
+  state = states;
+  for (const char *text : nextTexts) {
+    nextList.Add(StenoSegment(
+        1, state++, StenoDictionaryLookupResult::CreateStaticString(text)));
+  }
+
+  StaticStenoKeyCodeBuffer<> *buffer = new StaticStenoKeyCodeBuffer<>();
+  buffer->Populate(previousList, 0);
+
+  // `{*-|}` rewrote `two`, so its checkpoint cannot be resumed from, and the
+  // front segments cannot be removed past it.
+  assert(!buffer->RemoveFrontSegments(2));
+  assert(buffer->Resume(*buffer, nextList, 2) == 1);
+  VerifyResumedBuffer(*buffer, nextList);
+
+  // `three` has now been rewritten, but the segments after it can still be
+  // resumed.
+  assert(buffer->Resume(*buffer, nextList, 3) == 2);
+  assert(buffer->Resume(*buffer, nextList, 4) == 4);
+  VerifyResumedBuffer(*buffer, nextList);
+
+  // Removing `one` keeps the key codes of the other segments.
+  assert(buffer->RemoveFrontSegments(1));
+  nextList[0].lookup.Destroy();
+  nextList.RemoveFront(1);
+  VerifyResumedBuffer(*buffer, nextList);
+  assert(buffer->GetStartingOffset() == 0);
+
+  delete buffer;
+}
+TEST_END
+
+TEST_BEGIN("StenoKeyCodeBuffer: Resume past the checkpoint capacity") {
+  StenoState states[6];
+  for (StenoState &state : states) {
+    state.Reset();
+  }
+  const char *const texts[] = {"one", "two", "three", "four", "five", "six"};
+
+  StenoSegmentList list;
+  const StenoState *state = states;
+  for (const char *text : texts) {
+    list.Add(StenoSegment(
+        1, state++, StenoDictionaryLookupResult::CreateStaticString(text)));
+  }
+
+  // Segments after the last checkpoint are converted again.
+  StaticStenoKeyCodeBuffer<StenoKeyCodeBuffer::BUFFER_SIZE, 3> *buffer =
+      new StaticStenoKeyCodeBuffer<StenoKeyCodeBuffer::BUFFER_SIZE, 3>();
+  buffer->Populate(list, 0);
+  assert(buffer->Resume(*buffer, list, 5) == 2);
+  VerifyResumedBuffer(*buffer, list);
+
+  assert(buffer->RemoveFrontSegments(2));
+  list[0].lookup.Destroy();
+  list[1].lookup.Destroy();
+  list.RemoveFront(2);
+  VerifyResumedBuffer(*buffer, list);
+  assert(!buffer->RemoveFrontSegments(3));
+
+  delete buffer;
+}
+TEST_END
+
+//---------------------------------------------------------------------------
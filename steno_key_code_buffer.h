@@ -2,6 +2,7 @@
 
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
 #include "dictionary/dictionary.h"
 #include "list.h"
@@ -17,7 +18,8 @@ class StenoCompiledOrthography;
 //---------------------------------------------------------------------------
 
 // Large statically allocated buffers to avoid fragmentation preventing them
-// from being allocated.
+// from being allocated. The key codes are held by StaticStenoKeyCodeBuffer,
+// so that buffers can be sized for their use.
 //
 // StenoTokens are converted directly into these buffers, and functions are
 // applied directly on them.
@@ -29,8 +31,40 @@ public:
     rootDictionary = newRootDictionary;
   }
 
-  void Populate(StenoTokenizer *tokenizer);
-  void Append(StenoTokenizer *tokenizer);
+  template <typename TOKENIZER> void Populate(TOKENIZER &tokenizer) {
+    Reset();
+    Append(tokenizer);
+  }
+
+  template <typename TOKENIZER> void Append(TOKENIZER &tokenizer) {
+    while (tokenizer.HasMore()) {
+      StenoToken token = tokenizer.GetNext();
+      if (token.state != nullptr) {
+        state = *token.state;
+      }
+      ProcessToken(token.text);
+    }
+  }
+
+  // Converts segmentList from startingOffset, recording a checkpoint at the
+  // start of each segment.
+  void Populate(StenoSegmentList &segmentList, size_t startingOffset);
+
+  // Converts segmentList reusing the key codes in source, which must have
+  // been populated from a list with the same segments up to resumeOffset.
+  // Conversion restarts from the latest checkpoint at or before resumeOffset
+  // whose key codes were not changed by later segments, and only the key
+  // codes before it are copied. source can be this buffer.
+  // Returns the segment that conversion restarted from.
+  size_t Resume(const StenoKeyCodeBuffer &source,
+                StenoSegmentList &segmentList, size_t resumeOffset);
+
+  // Drops the key codes of the first segmentCount segments, so that the
+  // buffer matches a segment list with those segments removed. Returns false
+  // if later segments changed their key codes, leaving the buffer unchanged.
+  bool RemoveFrontSegments(size_t segmentCount);
+
+  size_t GetStartingOffset() const { return checkpointStart; }
 
   static const size_t BUFFER_SIZE = 2048;
 
@@ -40,17 +74,40 @@ public:
   size_t count = 0;
   size_t addTranslationCount = 0;
   size_t resetStateCount = 0;
-  StenoState state;
-  StenoKeyCode buffer[BUFFER_SIZE];
+  StenoState state = {};
+  const size_t capacity;
+  StenoKeyCode *const buffer;
 
   void Reset();
 
+  // Records that buffer[index] onwards was rewritten in place, rather than
+  // appended to.
+  void MarkModified(size_t index) {
+    if (index < modifiedIndex) {
+      modifiedIndex = index;
+    }
+  }
+  void MarkModified(const StenoKeyCode *p) { MarkModified(p - buffer); }
+
+  void ProcessToken(const char *text) {
+    if (text[0] == '{') {
+      ProcessCommand(text);
+    } else {
+      ProcessText(text);
+    }
+  }
   void ProcessText(const char *text);
   void ProcessCommand(const char *command);
   void ProcessOrthographicSuffix(const char *text, size_t length);
 
+  // Key codes past capacity are dropped.
+  void AppendKeyCode(StenoKeyCode keyCode) {
+    if (count < capacity) {
+      buffer[count++] = keyCode;
+    }
+  }
   void AppendSpace() {
-    buffer[count++] = StenoKeyCode(' ', StenoCaseMode::NORMAL);
+    AppendKeyCode(StenoKeyCode(' ', StenoCaseMode::NORMAL));
   }
   void AppendText(const char *p, size_t n, StenoCaseMode outputCaseMode);
   void AppendTextNoCaseModeOverride(const char *p, size_t n,
@@ -105,11 +162,66 @@ public:
 
   void operator=(const StenoKeyCodeBuffer &o);
 
+  // Conversions cover the dictionary's maximum outline length plus 4
+  // strokes, which is one segment per stroke for most strokes. Segments
+  // past the last checkpoint are resumed from it. Each checkpoint is 16
+  // bytes on arm, and 24 bytes on 64-bit hosts.
+  static const size_t MAXIMUM_CHECKPOINT_COUNT = 32;
+
+protected:
+  // Counts are 16-bit to keep the checkpoints small.
+  struct Checkpoint {
+    uint16_t count;
+    uint16_t addTranslationCount;
+    uint16_t resetStateCount;
+    uint16_t modifiedIndex; // Lowest index rewritten by this segment.
+    StenoState state;
+  };
+  static const uint16_t NOT_MODIFIED = 0xffff;
+
+  StenoKeyCodeBuffer(StenoKeyCode *buffer, size_t capacity,
+                     Checkpoint *checkpoints, size_t checkpointCapacity)
+      : capacity(capacity), buffer(buffer),
+        checkpointCapacity(checkpointCapacity), checkpoints(checkpoints) {}
+
 private:
+  size_t modifiedIndex = NOT_MODIFIED;
+  size_t checkpointStart = 0; // Segment of checkpoints[0].
+  size_t checkpointCount = 0;
+  const size_t checkpointCapacity;
+  Checkpoint *const checkpoints;
+
+  void AppendSegments(StenoSegmentList &segmentList, size_t startingOffset);
+  void AddCheckpoint();
+  bool IsCheckpointReusable(size_t index) const;
+
   static void Reverse(StenoKeyCode *start, StenoKeyCode *end);
 
   bool RetroWordCountHandler(void (StenoKeyCodeBuffer::*handler)(int),
                              const List<char *> &parameters);
 };
 
+// Conversion buffers keep MAXIMUM_CHECKPOINT_COUNT checkpoints. Buffers that
+// are only populated from tokenizers need none, and can set CHECKPOINT_COUNT
+// to 0.
+template <size_t SIZE = StenoKeyCodeBuffer::BUFFER_SIZE,
+          size_t CHECKPOINT_COUNT =
+              StenoKeyCodeBuffer::MAXIMUM_CHECKPOINT_COUNT>
+class StaticStenoKeyCodeBuffer : public StenoKeyCodeBuffer {
+  static_assert(SIZE < NOT_MODIFIED);
+
+public:
+  StaticStenoKeyCodeBuffer()
+      : StenoKeyCodeBuffer(storage, SIZE, checkpointStorage, CHECKPOINT_COUNT) {
+  }
+
+  void operator=(const StenoKeyCodeBuffer &o) {
+    StenoKeyCodeBuffer::operator=(o);
+  }
+
+private:
+  StenoKeyCode storage[SIZE];
+  Checkpoint checkpointStorage[CHECKPOINT_COUNT == 0 ? 1 : CHECKPOINT_COUNT];
+};
+
 //---------------------------------------------------------------------------
@@ -60,6 +60,7 @@ void StenoKeyCodeBuffer::Backspace(int backspaceCount) {
     }
   }
 
+  MarkModified(d);
   StenoKeyCode *s = d;
   while (s < pEnd) {
     if (s->IsRawKeyCode() || backspaceCount == 0) {
@@ -108,6 +109,7 @@ void StenoKeyCodeBuffer::RetroactiveCapitalize(int wordCount) {
   }
 
 epilog:
+  MarkModified(lastCharacterPointer);
   lastCharacterPointer->SetCase(StenoCaseMode::TITLE_ONCE);
 }
 
@@ -137,6 +139,7 @@ void StenoKeyCodeBuffer::RetroactiveUncapitalize(int wordCount) {
       }
       --p;
     }
+    MarkModified(lastCharacterPointer);
     lastCharacterPointer->SetCase(StenoCaseMode::LOWER_ONCE);
 
     --wordCount;
@@ -169,6 +172,7 @@ void StenoKeyCodeBuffer::RetroactiveTitleCase(int wordCount) {
       }
       --p;
     }
+    MarkModified(lastCharacterPointer);
     lastCharacterPointer->SetCase(StenoCaseMode::TITLE);
 
     --wordCount;
@@ -196,6 +200,7 @@ void StenoKeyCodeBuffer::RetroactiveUpperCase(int wordCount) {
       if (p->IsWhitespace()) {
         break;
       }
+      MarkModified(p);
       p->SetCase(StenoCaseMode::UPPER);
       --p;
     }
@@ -225,6 +230,7 @@ void StenoKeyCodeBuffer::RetroactiveLowerCase(int wordCount) {
       if (p->IsWhitespace()) {
         break;
       }
+      MarkModified(p);
       p->SetCase(StenoCaseMode::LOWER);
       --p;
     }
@@ -253,6 +259,7 @@ void StenoKeyCodeBuffer::RetroactiveReplaceSpace(int wordCount,
     StenoKeyCode *endReplacement = buffer + count;
 
     // Rotate in place.
+    MarkModified(p);
     Reverse(endText, endReplacement);
     Reverse(p, endReplacement);
     Reverse(p + (endReplacement - endText), endReplacement - 1);
@@ -304,6 +311,7 @@ void StenoKeyCodeBuffer::RetroactiveQuotes(int wordCount,
   }
 
   // Rotate in place.
+  MarkModified(p);
   Reverse(p, startQuoteBufferPointer);
   Reverse(startQuoteBufferPointer, buffer + count);
   Reverse(p, buffer + count);
@@ -323,6 +331,7 @@ void StenoKeyCodeBuffer::RetroactiveDeleteSpace() {
   StenoKeyCode *p = end - 1;
   while (p >= buffer) {
     if (p->IsWhitespace()) {
+      MarkModified(p);
       count--;
       memmove(p, p + 1, sizeof(StenoKeyCode) * (end - p - 1));
       return;
@@ -364,6 +373,8 @@ void StenoKeyCodeBuffer::RetroactiveFormatCurrency(const char *pStart,
     }
   }
   ++p;
+  MarkModified(p);
+  count = p - buffer;
 
   if (integralDigits == 0) {
     numberBuffer[numberBufferLength++] = '0';
@@ -373,7 +384,7 @@ void StenoKeyCodeBuffer::RetroactiveFormatCurrency(const char *pStart,
   // Replace the buffer with the template.
   for (Utf8Pointer t = pStart; t < pEnd; ++t) {
     if (uint32_t unicode = *t; unicode != 'c') {
-      *p++ = StenoKeyCode(unicode, StenoCaseMode::NORMAL);
+      AppendKeyCode(StenoKeyCode(unicode, StenoCaseMode::NORMAL));
       continue;
     }
 
@@ -381,27 +392,27 @@ void StenoKeyCodeBuffer::RetroactiveFormatCurrency(const char *pStart,
     int remainingIntegralDigits = integralDigits;
     while (i != 0) {
       char c = numberBuffer[--i];
-      *p++ = StenoKeyCode(c, StenoCaseMode::NORMAL);
+      AppendKeyCode(StenoKeyCode(c, StenoCaseMode::NORMAL));
       --remainingIntegralDigits;
       if (remainingIntegralDigits == 0) {
         // Do decimal part.
         if (hasDecimal) {
-          *p++ = StenoKeyCode('.', StenoCaseMode::NORMAL);
+          AppendKeyCode(StenoKeyCode('.', StenoCaseMode::NORMAL));
           while (i != 0) {
-            *p++ = StenoKeyCode(numberBuffer[--i], StenoCaseMode::NORMAL);
+            AppendKeyCode(
+                StenoKeyCode(numberBuffer[--i], StenoCaseMode::NORMAL));
           }
           for (size_t d = decimalDigits; d < 2; ++d) {
-            *p++ = StenoKeyCode('0', StenoCaseMode::NORMAL);
+            AppendKeyCode(StenoKeyCode('0', StenoCaseMode::NORMAL));
           }
           break;
         }
       } else if (remainingIntegralDigits % 3 == 0) {
-        *p++ = StenoKeyCode(',', StenoCaseMode::NORMAL);
+        AppendKeyCode(StenoKeyCode(',', StenoCaseMode::NORMAL));
       }
     }
   }
   state.isGlue = false;
-  count = p - buffer;
 }
 
 //---------------------------------------------------------------------------
@@ -649,7 +660,7 @@ bool StenoKeyCodeBuffer::ConsoleFunction(const List<char *> &parameters) {
 #include "unit_test.h"
 
 TEST_BEGIN("StenoKeyCodeBuffer: Backspace() should give expected results") {
-  StenoKeyCodeBuffer buffer;
+  StaticStenoKeyCodeBuffer<> buffer;
   buffer.buffer[0] = StenoKeyCode('a', StenoCaseMode::NORMAL);
   buffer.buffer[1] = StenoKeyCode('b', StenoCaseMode::NORMAL);
   buffer.buffer[2] = StenoKeyCode::CreateRawKeyCodePress(KeyCode::F1);
@@ -668,7 +679,7 @@ TEST_BEGIN("StenoKeyCodeBuffer: Backspace() should give expected results") {
 TEST_END
 
 TEST_BEGIN("StenoKeyCodeBuffer: RetroReplaceSpace") {
-  StenoKeyCodeBuffer buffer;
+  StaticStenoKeyCodeBuffer<> buffer;
   buffer.buffer[0] = StenoKeyCode('a', StenoCaseMode::NORMAL);
   buffer.buffer[1] = StenoKeyCode('b', StenoCaseMode::NORMAL);
   buffer.buffer[2] = StenoKeyCode(' ', StenoCaseMode::NORMAL);
@@ -685,7 +696,7 @@ TEST_BEGIN("StenoKeyCodeBuffer: RetroReplaceSpace") {
 TEST_END
 
 TEST_BEGIN("StenoKeyCodeBuffer: RetroReplaceSpace _") {
-  StenoKeyCodeBuffer buffer;
+  StaticStenoKeyCodeBuffer<> buffer;
   buffer.buffer[0] = StenoKeyCode('a', StenoCaseMode::NORMAL);
   buffer.buffer[1] = StenoKeyCode('b', StenoCaseMode::NORMAL);
   buffer.buffer[2] = StenoKeyCode(' ', StenoCaseMode::NORMAL);
@@ -703,7 +714,7 @@ TEST_BEGIN("StenoKeyCodeBuffer: RetroReplaceSpace _") {
 TEST_END
 
 TEST_BEGIN("StenoKeyCodeBuffer: RetroReplaceSpace <>") {
-  StenoKeyCodeBuffer buffer;
+  StaticStenoKeyCodeBuffer<> buffer;
   buffer.buffer[0] = StenoKeyCode('a', StenoCaseMode::NORMAL);
   buffer.buffer[1] = StenoKeyCode('b', StenoCaseMode::NORMAL);
   buffer.buffer[2] = StenoKeyCode(' ', StenoCaseMode::NORMAL);
@@ -169,7 +169,7 @@ const uint16_t StenoKeyCodeEmitter::EmitterContext::ASCII_KEY_CODES[] = {
 bool StenoKeyCodeEmitter::Process(const StenoKeyCode *previous,
                                   size_t previousLength,
                                   const StenoKeyCode *value,
-                                  size_t valueLength) const {
+                                  size_t valueLength) {
   // Skip common prefixes.
   while (previousLength > 0 && valueLength > 0 &&
          previous->HasSameOutput(*value)) {
@@ -183,6 +183,10 @@ bool StenoKeyCodeEmitter::Process(const StenoKeyCode *previous,
     return true;
   }
 
+  if (isBatching) {
+    return AddToBatch(previous, previousLength, value, valueLength);
+  }
+
   EmitterContext context;
 
   // Now the length of previous represents how much needs to be backspaced.
@@ -202,6 +206,68 @@ bool StenoKeyCodeEmitter::Process(const StenoKeyCode *previous,
   return context.shouldCombineUndo;
 }
 
+// The batch is the output that Process() would have emitted: backspaces
+// against the text before the batch, followed by batchKeyCodes.
+bool StenoKeyCodeEmitter::AddToBatch(const StenoKeyCode *previous,
+                                     size_t previousLength,
+                                     const StenoKeyCode *value,
+                                     size_t valueLength) {
+  bool shouldCombineUndo = true;
+  for (size_t i = 0; i < previousLength; ++i) {
+    if (!previous[i].IsRawKeyCode()) {
+      shouldCombineUndo = false;
+      AddBatchBackspace();
+    }
+  }
+
+  for (size_t i = 0; i < valueLength; ++i) {
+    if (!value[i].IsRawKeyCode()) {
+      shouldCombineUndo = false;
+    }
+    batchKeyCodes.Add(value[i]);
+  }
+
+  if (batchKeyCodes.GetCount() >= MAXIMUM_BATCH_KEY_CODE_COUNT) {
+    FlushBatch();
+  }
+
+  return shouldCombineUndo;
+}
+
+void StenoKeyCodeEmitter::AddBatchBackspace() {
+  if (batchKeyCodes.IsEmpty()) {
+    ++batchBackspaceCount;
+    return;
+  }
+
+  if (!batchKeyCodes.Back().IsRawKeyCode()) {
+    batchKeyCodes.Pop();
+    return;
+  }
+
+  // Raw key codes have side effects, so text before them can't be erased
+  // without emitting them first.
+  FlushBatch();
+  ++batchBackspaceCount;
+}
+
+void StenoKeyCodeEmitter::FlushBatch() {
+  EmitterContext context;
+
+  for (size_t i = 0; i < batchBackspaceCount; ++i) {
+    context.TapKey(KeyCode::BACKSPACE);
+  }
+
+  for (const StenoKeyCode &keyCode : batchKeyCodes) {
+    context.ProcessStenoKeyCode(keyCode);
+  }
+
+  context.ReleaseModifiers(context.modifiers);
+
+  batchBackspaceCount = 0;
+  batchKeyCodes.Reset();
+}
+
 //---------------------------------------------------------------------------
 
 void StenoKeyCodeEmitter::EmitterContext::ProcessStenoKeyCode(
@@ -485,6 +551,58 @@ TEST_BEGIN("StenoKeyCodeEmitter: Backspace tests") {
 }
 TEST_END
 
+TEST_BEGIN("StenoKeyCodeEmitter: Batch tests") {
+  StenoKeyCodeEmitter emitter;
+
+  const StenoKeyCode previous[] = {
+      StenoKeyCode('c', StenoCaseMode::TITLE),
+      StenoKeyCode('o', StenoCaseMode::NORMAL),
+      StenoKeyCode('g', StenoCaseMode::NORMAL),
+  };
+  const StenoKeyCode codes[] = {
+      StenoKeyCode('c', StenoCaseMode::TITLE),
+      StenoKeyCode('a', StenoCaseMode::NORMAL),
+      StenoKeyCode('t', StenoCaseMode::NORMAL),
+  };
+
+  emitter.BeginBatch();
+  assert(!emitter.Process(previous, 1, previous, 3));
+  assert(!emitter.Process(previous, 3, codes, 3));
+  assert(!emitter.Process(codes, 3, codes, 2));
+  assert(Key::history.empty());
+  emitter.EndBatch();
+
+  // "og" and "t" are erased before they are typed.
+  assert_begin();
+  assert_tap(KeyCode::A);
+  assert_end();
+}
+TEST_END
+
+TEST_BEGIN("StenoKeyCodeEmitter: Batch raw key code tests") {
+  StenoKeyCodeEmitter emitter;
+
+  const StenoKeyCode previous[] = {
+      StenoKeyCode('a', StenoCaseMode::NORMAL),
+  };
+  const StenoKeyCode raw[] = {
+      StenoKeyCode::CreateRawKeyCodePress(KeyCode::ENTER),
+      StenoKeyCode::CreateRawKeyCodeRelease(KeyCode::ENTER),
+  };
+
+  // Raw key codes are emitted before anything they follow is erased.
+  emitter.BeginBatch();
+  assert(emitter.Process(nullptr, 0, raw, 2));
+  assert(!emitter.Process(previous, 1, nullptr, 0));
+  emitter.EndBatch();
+
+  assert_begin();
+  assert_tap(KeyCode::ENTER);
+  assert_tap(KeyCode::BACKSPACE);
+  assert_end();
+}
+TEST_END
+
 TEST_BEGIN("StenoKeyCodeEmitter: Shared modifier tests") {
   StenoKeyCodeEmitter emitter;
 
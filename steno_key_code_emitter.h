@@ -3,6 +3,7 @@
 #pragma once
 #include <stddef.h>
 
+#include "list.h"
 #include "steno_key_code.h"
 #include "steno_key_code_buffer.h"
 
@@ -25,13 +26,21 @@ const char *UnicodeModeName(UnicodeMode mode);
 class StenoKeyCodeEmitter {
 public:
   bool Process(const StenoKeyCode *previous, size_t previousLength,
-               const StenoKeyCode *value, size_t valueLength) const;
+               const StenoKeyCode *value, size_t valueLength);
 
   bool Process(const StenoKeyCodeBuffer &previous,
-               const StenoKeyCodeBuffer &next) const {
+               const StenoKeyCodeBuffer &next) {
     return Process(previous.buffer, previous.count, next.buffer, next.count);
   }
 
+  // Between BeginBatch() and EndBatch(), Process() only records its output,
+  // and text that is typed then erased within the batch is never emitted.
+  void BeginBatch() { isBatching = true; }
+  void EndBatch() {
+    FlushBatch();
+    isBatching = false;
+  }
+
   static const char *GetUnicodeModeName() {
     return UnicodeModeName(emitterMode);
   }
@@ -43,9 +52,21 @@ public:
   static const char *const UNICODE_EMITTER_NAMES[];
 
 private:
+  // Pending output is flushed once it reaches this many key codes.
+  static const size_t MAXIMUM_BATCH_KEY_CODE_COUNT = 1024;
+
   static UnicodeMode emitterMode;
 
+  bool isBatching = false;
+  size_t batchBackspaceCount = 0;
+  List<StenoKeyCode> batchKeyCodes;
+
   struct EmitterContext;
+
+  bool AddToBatch(const StenoKeyCode *previous, size_t previousLength,
+                  const StenoKeyCode *value, size_t valueLength);
+  void AddBatchBackspace();
+  void FlushBatch();
 };
 
 //---------------------------------------------------------------------------
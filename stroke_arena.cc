@@ -0,0 +1,158 @@
+//---------------------------------------------------------------------------
+
+#include "stroke_arena.h"
+#include "console.h"
+#include "str.h"
+#include <assert.h>
+#include <stdlib.h>
+
+//---------------------------------------------------------------------------
+
+StrokeArena *StrokeArena::activeArena = nullptr;
+StrokeArena *StrokeArena::firstArena = nullptr;
+
+//---------------------------------------------------------------------------
+
+StrokeArena::StrokeArena() {
+  nextArena = firstArena;
+  firstArena = this;
+}
+
+StrokeArena::~StrokeArena() {
+  if (activeArena == this) {
+    activeArena = nullptr;
+  }
+  StrokeArena **p = &firstArena;
+  while (*p != this) {
+    p = &(*p)->nextArena;
+  }
+  *p = nextArena;
+}
+
+void StrokeArena::Begin() {
+  if (depth++ != 0) {
+    return;
+  }
+  assert(activeArena == nullptr);
+  activeArena = this;
+}
+
+void StrokeArena::End() {
+  if (--depth != 0) {
+    return;
+  }
+  activeArena = nullptr;
+
+  // The half just used must survive the next stroke, so the next stroke
+  // uses the other half.
+  currentHalf ^= 1;
+  used = 0;
+
+#ifdef RUN_TESTS
+  // Make use of expired allocations visible.
+  memset(data[currentHalf], 0xa5, HALF_SIZE);
+#endif
+}
+
+void *StrokeArena::AllocateInternal(size_t size) {
+  size = (size + 7) & ~size_t(7);
+  if (used + size > HALF_SIZE) {
+    ++overflowCount;
+    return nullptr;
+  }
+
+  void *result = data[currentHalf] + used;
+  used += size;
+  ++allocationCount;
+  if (used > peakUsed) {
+    peakUsed = used;
+  }
+  return result;
+}
+
+void *StrokeArena::Allocate(size_t size) {
+  return activeArena ? activeArena->AllocateInternal(size) : nullptr;
+}
+
+char *StrokeArena::DupN(const char *p, size_t length) {
+  char *result = (char *)Allocate(length + 1);
+  if (result == nullptr) {
+    return Str::DupN(p, length);
+  }
+  memcpy(result, p, length);
+  result[length] = '\0';
+  return result;
+}
+
+char *StrokeArena::Join(const char *a, const char *b) {
+  const size_t aLength = strlen(a);
+  const size_t bLength = strlen(b);
+  char *result = (char *)Allocate(aLength + bLength + 1);
+  if (result == nullptr) {
+    return Str::Join(a, b, nullptr);
+  }
+  memcpy(result, a, aLength);
+  memcpy(result + aLength, b, bLength + 1);
+  return result;
+}
+
+bool StrokeArena::Contains(const void *p) {
+  for (const StrokeArena *arena = firstArena; arena;
+       arena = arena->nextArena) {
+    const uint8_t *data = arena->data[0];
+    if (data <= p && p < data + sizeof(arena->data)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StrokeArena::PrintInfo() const {
+  Console::Printf("    Stroke arena: %zu allocations, %zu overflows, %zu/%zu "
+                  "peak bytes\n",
+                  allocationCount, overflowCount, peakUsed, HALF_SIZE);
+}
+
+//---------------------------------------------------------------------------
+
+#include "unit_test.h"
+
+TEST_BEGIN("StrokeArena: Allocations last until the end of the next stroke") {
+  StrokeArena arena;
+
+  // Without an active arena, allocations come from the heap.
+  assert(StrokeArena::Allocate(8) == nullptr);
+  char *heap = StrokeArena::Dup("heap");
+  assert(!StrokeArena::Contains(heap));
+  free(heap);
+
+  arena.Begin();
+  char *first = StrokeArena::Join("first", " stroke");
+  assert(StrokeArena::Contains(first));
+  assert(Str::Eq(first, "first stroke"));
+  arena.End();
+
+  arena.Begin();
+  char *second = StrokeArena::Dup("second");
+  assert(StrokeArena::Contains(second));
+  assert(Str::Eq(first, "first stroke"));
+  arena.End();
+
+  arena.Begin();
+  char *third = StrokeArena::Dup("third");
+  assert(third == first);
+  assert(Str::Eq(second, "second"));
+  arena.End();
+
+  // Once full, allocations fall back to the heap.
+  arena.Begin();
+  assert(StrokeArena::Allocate(StrokeArena::HALF_SIZE) != nullptr);
+  assert(StrokeArena::Allocate(1) == nullptr);
+  char *overflow = StrokeArena::Dup("overflow");
+  assert(!StrokeArena::Contains(overflow));
+  free(overflow);
+  arena.End();
+}
+TEST_END
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+//---------------------------------------------------------------------------
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bytes in each half of the arena, so the engine's arena uses twice this.
+// A stroke rarely needs more than 1kb. The randomized engine tests peak at
+// 4kb, and anything that doesn't fit falls back to the heap.
+#ifndef JAVELIN_STROKE_ARENA_HALF_SIZE
+#define JAVELIN_STROKE_ARENA_HALF_SIZE 2048
+#endif
+
+//---------------------------------------------------------------------------
+
+// Bump allocator for memory that is only needed while processing a stroke.
+//
+// Allocations remain valid until the end of the following stroke, so that a
+// stroke's segments can be carried into the next one. The arena is split
+// into two halves used by alternate strokes, and each half is reset as it is
+// reused.
+//
+// Only one arena is active at a time, and only one thread allocates from it.
+// The static allocation methods fall back to the heap when no arena is
+// active, or the active arena is full, and Contains() distinguishes the two.
+class StrokeArena {
+public:
+  StrokeArena();
+  ~StrokeArena();
+
+  void Begin();
+  void End();
+
+  // Returns nullptr if no arena is active or it is full.
+  static void *Allocate(size_t size);
+
+  // Copies into the active arena, or onto the heap if that fails.
+  static char *DupN(const char *p, size_t length);
+  static char *Dup(const char *p) { return DupN(p, strlen(p)); }
+  static char *Join(const char *a, const char *b);
+
+  // Returns true if p is in any arena, rather than on the heap.
+  static bool Contains(const void *p);
+
+  void PrintInfo() const;
+
+  static const size_t HALF_SIZE = JAVELIN_STROKE_ARENA_HALF_SIZE;
+
+private:
+  size_t depth = 0;
+  size_t currentHalf = 0;
+  size_t used = 0;
+
+  size_t allocationCount = 0;
+  size_t overflowCount = 0;
+  size_t peakUsed = 0;
+
+  StrokeArena *nextArena;
+
+  alignas(8) uint8_t data[2][HALF_SIZE];
+
+  void *AllocateInternal(size_t size);
+
+  static StrokeArena *activeArena;
+  static StrokeArena *firstArena;
+};
+
+//---------------------------------------------------------------------------
+
+// Makes arena active for the lifetime of the sentry.
+class StrokeArenaSentry {
+public:
+  StrokeArenaSentry(StrokeArena &arena) : arena(arena) { arena.Begin(); }
+  ~StrokeArenaSentry() { arena.End(); }
+
+private:
+  StrokeArena &arena;
+};
+
+//---------------------------------------------------------------------------
@@ -1,14 +1,200 @@
 //---------------------------------------------------------------------------
 
+#include "thread.h"
+#include <atomic>
 #include <pthread.h>
+#include <unistd.h>
 
 //---------------------------------------------------------------------------
 
 #ifdef JAVELIN_THREADS
 
+// A single persistent worker thread, started on first use.
+//
+// Handoffs spin briefly before blocking, as tasks are queued in bursts
+// during a stroke, and waking a blocked thread costs more than the spin.
+// Spinning only delays the other thread when there is a single processor,
+// so it is skipped there.
+class Worker {
+public:
+  Worker();
+
+  void QueueTask(void (*func)(void *context), void *context);
+  void WaitForQueuedTasks();
+
+  static Worker &GetInstance();
+
+private:
+  struct Task {
+    void (*func)(void *context);
+    void *context;
+  };
+
+  static const size_t QUEUE_SIZE = 8;
+  static const size_t MAXIMUM_SPIN_COUNT = 100;
+
+  size_t spinCount;
+
+  // Both counts only increase. Task i is in tasks[i % QUEUE_SIZE].
+  std::atomic<size_t> queuedCount = 0;
+  std::atomic<size_t> completedCount = 0;
+  Task tasks[QUEUE_SIZE];
+
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t queuedCondition = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t completedCondition = PTHREAD_COND_INITIALIZER;
+
+  void Run();
+  void WaitForCompletedCount(size_t count);
+
+  static void Pause();
+  static void *EntryPoint(void *worker);
+};
+
+Worker::Worker() {
+  spinCount = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? MAXIMUM_SPIN_COUNT : 0;
+
+  pthread_t thread;
+  pthread_create(&thread, nullptr, &EntryPoint, this);
+  pthread_detach(thread);
+}
+
+Worker &Worker::GetInstance() {
+  static Worker *instance = new Worker;
+  return *instance;
+}
+
+void Worker::Pause() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+void *Worker::EntryPoint(void *worker) {
+  ((Worker *)worker)->Run();
+  return nullptr;
+}
+
+void Worker::Run() {
+  size_t count = 0;
+  for (;;) {
+    for (size_t i = 0; i < spinCount; ++i) {
+      if (queuedCount.load(std::memory_order_acquire) != count) {
+        break;
+      }
+      Pause();
+    }
+
+    if (queuedCount.load(std::memory_order_acquire) == count) {
+      pthread_mutex_lock(&mutex);
+      while (queuedCount.load(std::memory_order_acquire) == count) {
+        pthread_cond_wait(&queuedCondition, &mutex);
+      }
+      pthread_mutex_unlock(&mutex);
+    }
+
+    const Task &task = tasks[count % QUEUE_SIZE];
+    (*task.func)(task.context);
+    completedCount.store(++count, std::memory_order_release);
+
+    pthread_mutex_lock(&mutex);
+    pthread_cond_signal(&completedCondition);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+void Worker::QueueTask(void (*func)(void *context), void *context) {
+  const size_t count = queuedCount.load(std::memory_order_relaxed);
+  if (count >= QUEUE_SIZE) {
+    WaitForCompletedCount(count - QUEUE_SIZE + 1);
+  }
+
+  tasks[count % QUEUE_SIZE] = {.func = func, .context = context};
+  queuedCount.store(count + 1, std::memory_order_release);
+
+  pthread_mutex_lock(&mutex);
+  pthread_cond_signal(&queuedCondition);
+  pthread_mutex_unlock(&mutex);
+}
+
+void Worker::WaitForQueuedTasks() {
+  WaitForCompletedCount(queuedCount.load(std::memory_order_relaxed));
+}
+
+void Worker::WaitForCompletedCount(size_t count) {
+  for (size_t i = 0; i < spinCount; ++i) {
+    if (completedCount.load(std::memory_order_acquire) >= count) {
+      return;
+    }
+    Pause();
+  }
+
+  pthread_mutex_lock(&mutex);
+  while (completedCount.load(std::memory_order_acquire) < count) {
+    pthread_cond_wait(&completedCondition, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+//---------------------------------------------------------------------------
+
 void RunParallel(void (*func1)(void *context), void *context1,
                  void (*func2)(void *context), void *context2) {
+  Worker &worker = Worker::GetInstance();
+  worker.QueueTask(func1, context1);
+  (*func2)(context2);
+  worker.WaitForQueuedTasks();
+}
+
+void QueueTask(void (*func)(void *context), void *context) {
+  Worker::GetInstance().QueueTask(func, context);
+}
+
+void WaitForQueuedTasks() { Worker::GetInstance().WaitForQueuedTasks(); }
+
+#endif
+
+//---------------------------------------------------------------------------
+
+#include "unit_test.h"
+
+#if defined(RUN_TESTS) && defined(JAVELIN_THREADS)
+
+static void AppendTaskIndex(void *context) {
+  std::vector<size_t> &order = *(std::vector<size_t> *)context;
+  order.push_back(order.size());
+}
 
+TEST_BEGIN("Thread: Queued tasks run in order") {
+  std::vector<size_t> order;
+  for (size_t i = 0; i < 100; ++i) {
+    QueueTask(&AppendTaskIndex, &order);
+  }
+  WaitForQueuedTasks();
+
+  assert(order.size() == 100);
+  for (size_t i = 0; i < order.size(); ++i) {
+    assert(order[i] == i);
+  }
+}
+TEST_END
+
+#endif
+
+//---------------------------------------------------------------------------
+
+#if defined(RUN_BENCHMARKS) && defined(JAVELIN_THREADS)
+
+#include "benchmark.h"
+#include "crc.h"
+
+// The previous implementation, which created a thread for every call.
+static void RunParallelWithNewThread(void (*func1)(void *context),
+                                     void *context1,
+                                     void (*func2)(void *context),
+                                     void *context2) {
   pthread_t thread;
   pthread_create(&thread, nullptr, (void *(*)(void *))func1, context1);
   (*func2)(context2);
@@ -17,6 +203,39 @@ void RunParallel(void (*func1)(void *context), void *context1,
   pthread_join(thread, &result);
 }
 
+// Roughly the cost of converting one stroke's text buffer.
+static void ConvertTextWorkload(void *context) {
+  static uint8_t data[1024];
+  *(uint32_t *)context = Crc32(data, sizeof(data));
+}
+
+static void BenchmarkRunParallel(
+    void (*runParallel)(void (*)(void *), void *, void (*)(void *), void *),
+    const char *series, bool isIdle) {
+  for (size_t i = 0; i < 50; ++i) {
+    // Strokes arrive far apart, so the worker has usually gone to sleep.
+    if (isIdle) {
+      usleep(1000);
+    }
+
+    uint32_t result1, result2;
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    (*runParallel)(&ConvertTextWorkload, &result1, &ConvertTextWorkload,
+                   &result2);
+    Benchmark::AddSample(series, Benchmark::GetNanoseconds() - startTime);
+  }
+}
+
+BENCHMARK_BEGIN("Thread: RunParallel per-stroke latency") {
+  BenchmarkRunParallel(&RunParallel, "worker, busy (ns)", false);
+  BenchmarkRunParallel(&RunParallelWithNewThread, "new thread, busy (ns)",
+                       false);
+  BenchmarkRunParallel(&RunParallel, "worker, idle (ns)", true);
+  BenchmarkRunParallel(&RunParallelWithNewThread, "new thread, idle (ns)",
+                       true);
+}
+BENCHMARK_END
+
 #endif
 
 //---------------------------------------------------------------------------
@@ -9,9 +9,21 @@
 
 #ifdef JAVELIN_THREADS
 
+// Runs func1 on the worker thread and func2 on the calling thread, returning
+// once both have completed.
 void RunParallel(void (*func1)(void *context), void *context1,
                  void (*func2)(void *context), void *context2);
 
+// Queues func to run on the worker thread. Tasks run in the order that they
+// are queued, so each task may depend on the results of earlier tasks.
+// context must remain valid until WaitForQueuedTasks() returns.
+//
+// Tasks are only queued from the engine's thread.
+void QueueTask(void (*func)(void *context), void *context);
+
+// Returns once every queued task has completed.
+void WaitForQueuedTasks();
+
 #endif
 
 //---------------------------------------------------------------------------
@@ -1,6 +1,10 @@
 //---------------------------------------------------------------------------
 
 #include "word_list.h"
+#include "crc.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 //---------------------------------------------------------------------------
 
@@ -23,6 +27,124 @@ int WordList::GetWordRank(const uint8_t *word) {
     return -1;
   }
 
+  if (instance.index) {
+    const size_t length = strlen((const char *)word);
+    return GetWordRankFromIndex(word, length, Crc32(word, length));
+  }
+  return GetWordRankBinarySearch(word);
+}
+
+// Hashes every word before probing, so that the bucket reads are
+// independent of each other.
+void WordList::GetWordRanks(const char *const *words, int *ranks,
+                            size_t count) {
+  if (!instance.index) {
+    for (size_t i = 0; i < count; ++i) {
+      ranks[i] = GetWordRank(words[i]);
+    }
+    return;
+  }
+
+  const size_t BATCH_SIZE = 16;
+  uint32_t hashes[BATCH_SIZE];
+  size_t lengths[BATCH_SIZE];
+
+  while (count) {
+    const size_t batchCount = count < BATCH_SIZE ? count : BATCH_SIZE;
+    for (size_t i = 0; i < batchCount; ++i) {
+      const uint8_t *word = (const uint8_t *)words[i];
+      if (ContainsEmoji(word)) {
+        lengths[i] = 0;
+        continue;
+      }
+      lengths[i] = strlen(words[i]);
+      hashes[i] = Crc32(word, lengths[i]);
+    }
+    for (size_t i = 0; i < batchCount; ++i) {
+      ranks[i] = lengths[i] == 0
+                     ? -1
+                     : GetWordRankFromIndex((const uint8_t *)words[i],
+                                            lengths[i], hashes[i]);
+    }
+    words += batchCount;
+    ranks += batchCount;
+    count -= batchCount;
+  }
+}
+
+int WordList::GetWordRankFromIndex(const uint8_t *word, size_t length,
+                                   uint32_t hash) {
+  const uint32_t *index = instance.index;
+  const uint32_t bucketCount = index[0];
+  const uint32_t *buckets = index + 1;
+  const uint32_t *entries = buckets + bucketCount + 1;
+
+  const uint32_t bucket = hash & (bucketCount - 1);
+  const uint32_t fingerprint = hash >> 24;
+  for (uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; ++i) {
+    const uint32_t entry = entries[i];
+    if (entry >> 24 != fingerprint) {
+      continue;
+    }
+    const uint8_t *wordStart = instance.data + (entry & 0xffffff);
+    if (Compare(word, wordStart) == 0) {
+      return wordStart[length] & 0xf;
+    }
+  }
+  return -1;
+}
+
+uint32_t *WordList::CreateIndex(const uint8_t *data, size_t length,
+                                size_t &indexSize) {
+  const uint8_t *start = data + 1;
+  const uint8_t *end = data + length;
+
+  // Word offsets are stored in 24 bits.
+  if (end - start > 0x1000000) {
+    indexSize = 0;
+    return nullptr;
+  }
+
+  size_t wordCount = 0;
+  for (const uint8_t *p = start; p < end; ++p) {
+    if (IsValueByte(*p)) {
+      ++wordCount;
+    }
+  }
+
+  uint32_t bucketCount = 1;
+  while (2 * bucketCount < wordCount) {
+    bucketCount *= 2;
+  }
+
+  indexSize = 2 + bucketCount + wordCount;
+  uint32_t *index = (uint32_t *)malloc(indexSize * sizeof(uint32_t));
+  uint32_t *buckets = index + 1;
+  uint32_t *entries = buckets + bucketCount + 1;
+  index[0] = bucketCount;
+  memset(buckets, 0, (bucketCount + 1) * sizeof(uint32_t));
+
+  // Count the words in each bucket, then convert the counts to bucket ends,
+  // and fill each bucket from its end.
+  for (const uint8_t *wordStart = start; wordStart < end;) {
+    const uint8_t *wordEnd = FindValueByteForward(wordStart);
+    buckets[Crc32(wordStart, wordEnd - wordStart) & (bucketCount - 1)]++;
+    wordStart = wordEnd + 1;
+  }
+  for (size_t i = 1; i <= bucketCount; ++i) {
+    buckets[i] += buckets[i - 1];
+  }
+  for (const uint8_t *wordStart = start; wordStart < end;) {
+    const uint8_t *wordEnd = FindValueByteForward(wordStart);
+    const uint32_t hash = Crc32(wordStart, wordEnd - wordStart);
+    const uint32_t entryIndex = --buckets[hash & (bucketCount - 1)];
+    entries[entryIndex] = (hash >> 24 << 24) | uint32_t(wordStart - start);
+    wordStart = wordEnd + 1;
+  }
+  return index;
+}
+
+int WordList::GetWordRankBinarySearch(const uint8_t *word) {
   const uint8_t *left = instance.data;
   const uint8_t *right = instance.dataEnd;
 
@@ -80,3 +202,163 @@ int WordList::Compare(const uint8_t *word, const uint8_t *data) {
 }
 
 //---------------------------------------------------------------------------
+
+#include "unit_test.h"
+
+// spellchecker: disable
+TEST_BEGIN("WordList: Index test") {
+  static const uint8_t DATA[] = {
+      0xf0, 'a',  0xf1, 'a', 'p', 'p', 'l', 'e', 0xf3, 'b', 'a',
+      'n',  'a',  'n',  'a', 0xf2, 'c', 'a', 't',  0xf5, 'c', 'a',
+      't',  's',  0xf6, 'd', 'o',  'g', 0xf4,
+  };
+  static const struct {
+    const char *word;
+    int rank;
+  } CASES[] = {
+      {"a", 1},   {"apple", 3}, {"banana", 2}, {"cat", 5},
+      {"cats", 6}, {"dog", 4},  {"app", -1},   {"ca", -1},
+      {"dogs", -1}, {"", -1},   {"\xf0\x9f\x98\x80", -1},
+  };
+  const size_t CASE_COUNT = sizeof(CASES) / sizeof(*CASES); // NOLINT
+
+  const WordList savedInstance = WordList::instance;
+
+  size_t indexSize;
+  uint32_t *index = WordList::CreateIndex(DATA, sizeof(DATA), indexSize);
+  assert(indexSize == 2 + index[0] + 6);
+
+  for (const uint32_t *currentIndex : {(const uint32_t *)nullptr,
+                                       (const uint32_t *)index}) {
+    WordList::SetData(DATA, sizeof(DATA), currentIndex);
+
+    const char *words[CASE_COUNT];
+    int ranks[CASE_COUNT];
+    for (size_t i = 0; i < CASE_COUNT; ++i) {
+      assert(WordList::GetWordRank(CASES[i].word) == CASES[i].rank);
+      words[i] = CASES[i].word;
+    }
+    WordList::GetWordRanks(words, ranks, CASE_COUNT);
+    for (size_t i = 0; i < CASE_COUNT; ++i) {
+      assert(ranks[i] == CASES[i].rank);
+    }
+  }
+
+  free(index);
+  WordList::instance = savedInstance;
+
+  // Data too large for 24 bit offsets is not indexed. The length is only
+  // checked, so DATA is not read past its end.
+  assert(WordList::CreateIndex(DATA, 0x1000002, indexSize) == nullptr);
+}
+TEST_END
+// spellchecker: enable
+
+//---------------------------------------------------------------------------
+
+#ifdef RUN_BENCHMARKS
+
+#include "benchmark.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The built-in list may be empty, so the benchmark uses a generated list of
+// about the size of a full English word list.
+struct BenchmarkWordList {
+  std::vector<uint8_t> data;
+  uint32_t *index;
+  std::vector<std::string> lookups;
+
+  BenchmarkWordList() {
+    const size_t WORD_COUNT = 80000;
+    uint32_t seed = 1;
+    std::vector<std::string> words;
+    for (size_t i = 0; i < WORD_COUNT; ++i) {
+      std::string word;
+      seed = seed * 1103515245 + 12345;
+      const size_t length = 2 + (seed >> 16) % 10;
+      for (size_t j = 0; j < length; ++j) {
+        seed = seed * 1103515245 + 12345;
+        word += char('a' + (seed >> 16) % 26);
+      }
+      words.push_back(word);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    data.push_back(0xf0);
+    for (const std::string &word : words) {
+      data.insert(data.end(), word.begin(), word.end());
+      data.push_back(0xf0 + word.size() % 16);
+    }
+
+    size_t indexSize;
+    index = WordList::CreateIndex(data.data(), data.size(), indexSize);
+
+    // Half of the lookups are present, half are not, as with orthography
+    // candidates.
+    for (size_t i = 0; i < 1024; ++i) {
+      seed = seed * 1103515245 + 12345;
+      std::string word = words[(seed >> 8) % words.size()];
+      if (i & 1) {
+        word += 'q';
+      }
+      lookups.push_back(word);
+    }
+  }
+};
+
+static const BenchmarkWordList &GetBenchmarkWordList() {
+  static const BenchmarkWordList *wordList = new BenchmarkWordList;
+  return *wordList;
+}
+
+static void BenchmarkGetWordRank(bool useIndex) {
+  const BenchmarkWordList &wordList = GetBenchmarkWordList();
+  const WordList savedInstance = WordList::instance;
+  WordList::SetData(wordList.data.data(), wordList.data.size(),
+                    useIndex ? wordList.index : nullptr);
+
+  for (const std::string &word : wordList.lookups) {
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    WordList::GetWordRank(word.c_str());
+    Benchmark::AddSample("time (ns)", Benchmark::GetNanoseconds() - startTime);
+  }
+
+  WordList::instance = savedInstance;
+}
+
+BENCHMARK_BEGIN("WordList: Binary search") { BenchmarkGetWordRank(false); }
+BENCHMARK_END
+
+BENCHMARK_BEGIN("WordList: Index") { BenchmarkGetWordRank(true); }
+BENCHMARK_END
+
+BENCHMARK_BEGIN("WordList: Index batch of 8") {
+  const BenchmarkWordList &wordList = GetBenchmarkWordList();
+  const WordList savedInstance = WordList::instance;
+  WordList::SetData(wordList.data.data(), wordList.data.size(),
+                    wordList.index);
+
+  const size_t BATCH_SIZE = 8;
+  for (size_t i = 0; i < wordList.lookups.size(); i += BATCH_SIZE) {
+    const char *words[BATCH_SIZE];
+    int ranks[BATCH_SIZE];
+    for (size_t j = 0; j < BATCH_SIZE; ++j) {
+      words[j] = wordList.lookups[i + j].c_str();
+    }
+    const uint64_t startTime = Benchmark::GetNanoseconds();
+    WordList::GetWordRanks(words, ranks, BATCH_SIZE);
+    Benchmark::AddSample("time per word (ns)",
+                         (Benchmark::GetNanoseconds() - startTime) /
+                             BATCH_SIZE);
+  }
+
+  WordList::instance = savedInstance;
+}
+BENCHMARK_END
+
+#endif
+
+//---------------------------------------------------------------------------
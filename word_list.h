@@ -7,24 +7,51 @@
 
 class WordList {
 public:
+  // Ranks are 0 to 15, with lower ranks for more common words.
+  static const int BEST_RANK = 0;
+
   // Returns -1 if not found,
   static int GetWordRank(const uint8_t *word);
   static int GetWordRank(const char *word) {
     return GetWordRank((const uint8_t *)word);
   }
 
-  static void SetData(const uint8_t *newData, size_t length) {
+  // Sets ranks[i] to the rank of words[i], or -1 if not found.
+  static void GetWordRanks(const char *const *words, int *ranks,
+                           size_t count);
+
+  // newIndex is optional, and must be built from the same data.
+  static void SetData(const uint8_t *newData, size_t length,
+                      const uint32_t *newIndex = nullptr) {
     instance.data = newData + 1;
     instance.dataEnd = newData + length;
+    instance.index = newIndex;
   }
 
+  // Builds an index for word list data, so that lookups are a hash probe
+  // instead of a binary search. The index can be generated offline and
+  // passed to SetData. The result is malloc'd, and indexSize is set to its
+  // length in uint32_t values. Returns nullptr if the data is over 16MB, in
+  // which case lookups use the binary search.
+  //
+  // Layout:
+  //   [0]: bucketCount, a power of 2.
+  //   [1 .. bucketCount + 1]: Start of each bucket's entries.
+  //   entries: (fingerprint << 24) | word offset, grouped by bucket.
+  //
+  // Words are placed in buckets by the low bits of their Crc32, and the top
+  // 8 bits are the fingerprint, checked before comparing words.
+  static uint32_t *CreateIndex(const uint8_t *data, size_t length,
+                               size_t &indexSize);
+
   static WordList instance;
 
 private:
-  WordList() : data(DATA + 1), dataEnd(DATA + 1) {}
+  WordList() : data(DATA + 1), dataEnd(DATA + 1), index(nullptr) {}
 
   const uint8_t *data;
   const uint8_t *dataEnd;
+  const uint32_t *index;
 
   static const uint8_t DATA[];
 
@@ -33,6 +60,10 @@ private:
   static bool ContainsEmoji(const uint8_t *word);
   static const uint8_t *FindValueByteForward(const uint8_t *p);
   static const uint8_t *FindWordStart(const uint8_t *p);
+
+  static int GetWordRankBinarySearch(const uint8_t *word);
+  static int GetWordRankFromIndex(const uint8_t *word, size_t length,
+                                  uint32_t hash);
 };
 
 //---------------------------------------------------------------------------